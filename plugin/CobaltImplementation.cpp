@@ -648,7 +648,7 @@ public:
   IIterator* Get(const string& nameSpace) const override { return nullptr; }
   bool Get(const string& nameSpace, const string& key, string& value /* @out */) const override {
     if (nameSpace == "settings") {
-      if (key == "accessibility") {
+      if (key == "accessibility" || key == "mediastats") {
         char* json = nullptr;
         if (SbRdkGetSetting(key.c_str(), &json) == 0) {
           value.assign(json);
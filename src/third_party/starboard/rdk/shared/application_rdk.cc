@@ -35,6 +35,9 @@
 #include "starboard/speech_synthesis.h"
 #include "starboard/shared/starboard/audio_sink/audio_sink_internal.h"
 
+#include "third_party/starboard/rdk/shared/media/gst_media_utils.h"
+#include "third_party/starboard/rdk/shared/media/gst_sample_pool.h"
+#include "third_party/starboard/rdk/shared/media/media_buffer_budget.h"
 #include "third_party/starboard/rdk/shared/window/window_internal.h"
 #include "third_party/starboard/rdk/shared/log_override.h"
 
@@ -57,6 +60,8 @@ void Teardown();
 
 namespace player {
 void ForceStop();
+void PreparePipelinePool();
+void ReleasePipelinePool();
 }  // namespace player
 
 EssTerminateListener Application::terminateListener = {
@@ -126,11 +131,20 @@ void Application::Initialize() {
     setTimerInterval(monitor_timer_fd_, hang_monitor_->GetResetInterval());
   }
 
+  if ( !getenv("COBALT_DISABLE_MEMORY_PRESSURE_MONITOR") ) {
+    memory_pressure_monitor_.reset(new MemoryPressureMonitor(
+      [this](bool under_pressure) { OnMemoryPressure(under_pressure); }));
+  }
+
+  media::PrewarmCodecCapabilities();
   SbAudioSinkPrivate::Initialize();
   libcobalt_api::Initialize();
+  player::PreparePipelinePool();
 }
 
 void Application::Teardown() {
+  media::StopCodecCapabilitiesPrewarm();
+  player::ReleasePipelinePool();
   SbAudioSinkPrivate::TearDown();
   libcobalt_api::Teardown();
   TeardownJSONRPCLink();
@@ -139,6 +153,7 @@ void Application::Teardown() {
   close(wakeup_fd_);
   close(monitor_timer_fd_);
   ess_timer_fd_ = wakeup_fd_ = monitor_timer_fd_ = -1;
+  memory_pressure_monitor_.reset();
 }
 
 bool Application::MayHaveSystemEvents() {
@@ -158,7 +173,7 @@ Application::PollNextSystemEvent() {
 ::starboard::shared::starboard::Application::Event*
 Application::WaitForSystemEventWithTimeout(SbTime time) {
   struct timespec timeout;
-  struct pollfd fds[3];
+  struct pollfd fds[5];
   int fds_sz = 0;
   int rc = 0;
 
@@ -183,6 +198,23 @@ Application::WaitForSystemEventWithTimeout(SbTime time) {
     ++fds_sz;
   }
 
+  if ( memory_pressure_monitor_ ) {
+    // Pressure is signalled with POLLPRI. PSI triggers and cgroup files are
+    // always readable, so POLLIN is not asked for.
+    if ( !(memory_pressure_monitor_->GetEventFd() < 0) ) {
+      fds[fds_sz].fd = memory_pressure_monitor_->GetEventFd();
+      fds[fds_sz].events = POLLPRI;
+      fds[fds_sz].revents = 0;
+      ++fds_sz;
+    }
+    if ( !(memory_pressure_monitor_->GetTimerFd() < 0) ) {
+      fds[fds_sz].fd = memory_pressure_monitor_->GetTimerFd();
+      fds[fds_sz].events = POLLIN;
+      fds[fds_sz].revents = 0;
+      ++fds_sz;
+    }
+  }
+
   if ( fds_sz != 0 ) {
     timeout.tv_sec = time / kSbTimeSecond;
     timeout.tv_nsec = (time % kSbTimeSecond) * kSbTimeNanosecondsPerMicrosecond;
@@ -191,6 +223,13 @@ Application::WaitForSystemEventWithTimeout(SbTime time) {
 
   if ( rc > 0 ) {
     for (int i = 0; i < fds_sz; ++i) {
+      if ( memory_pressure_monitor_ &&
+           fds[i].fd == memory_pressure_monitor_->GetEventFd() ) {
+        if ( fds[i].revents & POLLPRI )
+          memory_pressure_monitor_->OnEvent();
+        continue;
+      }
+
       if ( (fds[i].revents & POLLIN) != POLLIN )
         continue;
       // Ack timer or wakeup event
@@ -200,6 +239,10 @@ Application::WaitForSystemEventWithTimeout(SbTime time) {
       if ( fds[i].fd == monitor_timer_fd_ ) {
         hang_monitor_->Reset();
       }
+      else if ( memory_pressure_monitor_ &&
+                fds[i].fd == memory_pressure_monitor_->GetTimerFd() ) {
+        memory_pressure_monitor_->OnTimer();
+      }
     }
   }
 
@@ -382,6 +425,18 @@ void Application::FatalError() {
   }, nullptr, 0);
 }
 
+void Application::OnMemoryPressure(bool under_pressure) {
+  media::SetBufferBudgetUnderPressure(under_pressure);
+  if ( !under_pressure )
+    return;
+
+  // Drop idle pooled samples and let Cobalt collect its caches and the
+  // source buffers above the now reduced budgets.
+  media::SamplePool::Get(kSbMediaTypeAudio)->Trim();
+  media::SamplePool::Get(kSbMediaTypeVideo)->Trim();
+  Inject(new Event(kSbEventTypeLowMemory, NULL, NULL));
+}
+
 }  // namespace shared
 }  // namespace rdk
 }  // namespace starboard
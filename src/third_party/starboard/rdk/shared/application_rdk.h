@@ -42,6 +42,7 @@
 #include "third_party/starboard/rdk/shared/ess_input.h"
 #include "third_party/starboard/rdk/shared/rdkservices.h"
 #include "third_party/starboard/rdk/shared/hang_detector.h"
+#include "third_party/starboard/rdk/shared/memory_pressure_monitor.h"
 
 #include <memory>
 #include <essos-app.h>
@@ -99,6 +100,7 @@ class Application : public ::starboard::shared::starboard::QueueApplication {
   void DestroyNativeWindow();
   void BuildEssosContext();
   void FatalError();
+  void OnMemoryPressure(bool under_pressure);
 
   static EssTerminateListener terminateListener;
   static EssKeyListener keyListener;
@@ -119,6 +121,7 @@ class Application : public ::starboard::shared::starboard::QueueApplication {
   int monitor_timer_fd_ { -1 };
 
   std::unique_ptr<HangMonitor> hang_monitor_ { nullptr };
+  std::unique_ptr<MemoryPressureMonitor> memory_pressure_monitor_ { nullptr };
 };
 
 }  // namespace shared
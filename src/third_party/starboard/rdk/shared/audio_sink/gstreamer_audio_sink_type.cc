@@ -32,25 +32,34 @@
 #include "third_party/starboard/rdk/shared/audio_sink/gstreamer_audio_sink_type.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstdlib>
 #include <memory>
 #include <string>
 
+#include <time.h>
+
 #include <glib.h>
 #include <gst/app/gstappsrc.h>
 #include <gst/audio/gstaudiobasesink.h>
 #include <gst/audio/streamvolume.h>
 #include <gst/gst.h>
 
+#include "starboard/common/condition_variable.h"
 #include "starboard/common/mutex.h"
 #include "starboard/configuration.h"
 #include "starboard/file.h"
 #include "starboard/media.h"
+#include "starboard/once.h"
 #include "starboard/shared/starboard/media/media_util.h"
 #include "starboard/thread.h"
 #include "starboard/time.h"
 
+#include "third_party/starboard/rdk/shared/audio_sink/pcm_converter.h"
 #include "third_party/starboard/rdk/shared/hang_detector.h"
+#include "third_party/starboard/rdk/shared/media/gst_sample_pool.h"
+#include "third_party/starboard/rdk/shared/media/media_stats.h"
 
 namespace third_party {
 namespace starboard {
@@ -63,8 +72,494 @@ GST_DEBUG_CATEGORY(cobalt_gst_audio_sink_debug);
 #define GST_CAT_DEFAULT cobalt_gst_audio_sink_debug
 
 constexpr int kFramesPerRequest = 1024;
+constexpr SbTime kBufferTime = 50 * kSbTimeMillisecond;
+
+// Low latency profile (COBALT_AUDIO_SINK_LOW_LATENCY): smaller periods, a
+// shorter device buffer and no convert/resample stage when the device takes
+// the stream caps as they are.
+constexpr int kLowLatencyFramesPerRequest = 256;
+constexpr SbTime kLowLatencyBufferTime = 20 * kSbTimeMillisecond;
+constexpr SbTime kLowLatencyPeriodTime = 5 * kSbTimeMillisecond;
+
+constexpr SbTime kLatencyUpdateInterval = 500 * kSbTimeMillisecond;
+
+// Shared output (COBALT_AUDIO_SINK_SHARED_OUTPUT): time the mixer waits for
+// late inputs before mixing silence for them.
+constexpr SbTime kMixerLatency = 20 * kSbTimeMillisecond;
+constexpr SbTime kLowLatencyMixerLatency = kLowLatencyPeriodTime;
+
+// The audio renderer does not tell the sink when new frames are written, so
+// an empty poll backs off from |kMinFeedWait| up to the cap below. While
+// playing the cap stays at the 5 ms the feeder used to sleep between polls,
+// so new frames are never picked up later than before; while paused the
+// feeder is woken explicitly by rate changes and destruction.
+constexpr SbTime kMinFeedWait = kSbTimeMillisecond;
+constexpr SbTime kMaxStarvedFeedWait = 5 * kSbTimeMillisecond;
+constexpr SbTime kLowLatencyMaxStarvedFeedWait = 2 * kSbTimeMillisecond;
+constexpr SbTime kMaxPausedFeedWait = 40 * kSbTimeMillisecond;
 
 using ::starboard::shared::starboard::media::GetBytesPerSample;
+using third_party::starboard::rdk::shared::media::SamplePool;
+
+GstCaps* CreateAudioCaps(SbMediaAudioSampleType sample_type,
+                         int sampling_frequency_hz,
+                         int channels) {
+  const char* format =
+      sample_type == kSbMediaAudioSampleTypeFloat32 ? "F32LE" : "S16LE";
+  return gst_caps_new_simple(
+      "audio/x-raw", "format", G_TYPE_STRING, format, "rate", G_TYPE_INT,
+      sampling_frequency_hz, "channels", G_TYPE_INT, channels, "layout",
+      G_TYPE_STRING, "interleaved", "channel-mask", GST_TYPE_BITMASK,
+      gst_audio_channel_get_fallback_mask(channels), nullptr);
+}
+
+// Process wide feeder counters, so that idle wake ups and push jitter can be
+// compared between builds via mediastats.
+class FeedStats {
+ public:
+  void OnSinkCreated() {
+    ::starboard::ScopedLock lock(mutex_);
+    ++sinks_;
+  }
+
+  void OnSinkDestroyed() {
+    ::starboard::ScopedLock lock(mutex_);
+    --sinks_;
+  }
+
+  void OnPipeline(int delta) {
+    ::starboard::ScopedLock lock(mutex_);
+    pipelines_ += delta;
+  }
+
+  void OnLoopThread(int delta) {
+    ::starboard::ScopedLock lock(mutex_);
+    loop_threads_ += delta;
+  }
+
+  void OnStreamingThread(int delta) {
+    ::starboard::ScopedLock lock(mutex_);
+    streaming_threads_ += delta;
+  }
+
+  void RecordFeedCpu(SbTime cpu) {
+    ::starboard::ScopedLock lock(mutex_);
+    feed_cpu_ += cpu;
+  }
+
+  void RecordLoopCpu(SbTime cpu) {
+    ::starboard::ScopedLock lock(mutex_);
+    loop_cpu_ += cpu;
+  }
+
+  void RecordWait(SbTime waited, bool signalled) {
+    ::starboard::ScopedLock lock(mutex_);
+    ++wakeups_;
+    if (signalled)
+      ++signalled_wakeups_;
+    idle_time_ += waited;
+  }
+
+  void RecordIdlePoll() {
+    ::starboard::ScopedLock lock(mutex_);
+    ++idle_polls_;
+  }
+
+  void RecordLatency(SbTime latency) {
+    ::starboard::ScopedLock lock(mutex_);
+    latency_ = latency;
+    if (latency > latency_max_)
+      latency_max_ = latency;
+  }
+
+  void RecordConversion(int frames, SbTime elapsed) {
+    ::starboard::ScopedLock lock(mutex_);
+    converted_frames_ += frames;
+    conversion_time_ += elapsed;
+  }
+
+  void RecordPush(SbTime detect_delay, double jitter, bool wrapped,
+                  size_t bytes) {
+    ::starboard::ScopedLock lock(mutex_);
+    ++pushes_;
+    if (wrapped)
+      bytes_wrapped_ += bytes;
+    else
+      bytes_copied_ += bytes;
+    if (detect_delay > 0) {
+      ++detected_;
+      detect_delay_total_ += detect_delay;
+      if (detect_delay > detect_delay_max_)
+        detect_delay_max_ = detect_delay;
+    }
+    jitter_ = jitter;
+    if (jitter > jitter_max_)
+      jitter_max_ = jitter;
+  }
+
+  void WriteStats(media::StatsWriter& writer) {
+    ::starboard::ScopedLock lock(mutex_);
+    writer.BeginObject("audiosink");
+    writer.Add("sinks", sinks_);
+    writer.Add("pipelines", pipelines_);
+    writer.BeginObject("threads");
+    writer.Add("loops", loop_threads_);
+    writer.Add("streaming", streaming_threads_);
+    writer.EndObject();
+    writer.BeginObject("cpu");
+    writer.Add("feedus", feed_cpu_);
+    writer.Add("loopus", loop_cpu_);
+    writer.EndObject();
+    writer.Add("pushes", pushes_);
+    writer.Add("byteswrapped", bytes_wrapped_);
+    writer.Add("bytescopied", bytes_copied_);
+    writer.Add("wakeups", wakeups_);
+    writer.Add("signalled", signalled_wakeups_);
+    writer.Add("idlepolls", idle_polls_);
+    writer.Add("idletimeus", idle_time_);
+    writer.BeginObject("detectdelay");
+    writer.Add("count", detected_);
+    writer.Add("avgus", detected_
+        ? detect_delay_total_ / static_cast<int64_t>(detected_) : 0);
+    writer.Add("maxus", detect_delay_max_);
+    writer.EndObject();
+    writer.BeginObject("jitter");
+    writer.Add("us", jitter_);
+    writer.Add("maxus", jitter_max_);
+    writer.EndObject();
+    writer.BeginObject("convert");
+    writer.Add("frames", converted_frames_);
+    writer.Add("timeus", conversion_time_);
+    writer.EndObject();
+    writer.BeginObject("latency");
+    writer.Add("us", latency_);
+    writer.Add("maxus", latency_max_);
+    writer.EndObject();
+    writer.EndObject();
+  }
+
+ private:
+  ::starboard::Mutex mutex_;
+  int sinks_ { 0 };
+  int pipelines_ { 0 };
+  int loop_threads_ { 0 };
+  int streaming_threads_ { 0 };
+  int64_t feed_cpu_ { 0 };
+  int64_t loop_cpu_ { 0 };
+  uint64_t pushes_ { 0 };
+  uint64_t bytes_wrapped_ { 0 };
+  uint64_t bytes_copied_ { 0 };
+  uint64_t wakeups_ { 0 };
+  uint64_t signalled_wakeups_ { 0 };
+  uint64_t idle_polls_ { 0 };
+  int64_t idle_time_ { 0 };
+  uint64_t detected_ { 0 };
+  int64_t detect_delay_total_ { 0 };
+  int64_t detect_delay_max_ { 0 };
+  double jitter_ { 0. };
+  double jitter_max_ { 0. };
+  int64_t latency_ { 0 };
+  uint64_t converted_frames_ { 0 };
+  int64_t conversion_time_ { 0 };
+  int64_t latency_max_ { 0 };
+};
+SB_ONCE_INITIALIZE_FUNCTION(FeedStats, GetFeedStats);
+
+SbTime GetThreadCpuTime() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    return 0;
+  return ts.tv_sec * kSbTimeSecond + ts.tv_nsec / kSbTimeNanosecondsPerMicrosecond;
+}
+
+// Adds the CPU time of the calling loop thread since its previous call.
+void RecordLoopCpu() {
+  static thread_local SbTime last_cpu_time = 0;
+  SbTime cpu_time = GetThreadCpuTime();
+  GetFeedStats()->RecordLoopCpu(cpu_time - last_cpu_time);
+  last_cpu_time = cpu_time;
+}
+
+GstBusSyncReply CountStreamingThreads(GstBus* bus,
+                                      GstMessage* message,
+                                      gpointer user_data) {
+  SB_UNREFERENCED_PARAMETER(bus);
+  SB_UNREFERENCED_PARAMETER(user_data);
+  if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_STREAM_STATUS) {
+    GstStreamStatusType type;
+    gst_message_parse_stream_status(message, &type, nullptr);
+    if (type == GST_STREAM_STATUS_TYPE_ENTER)
+      GetFeedStats()->OnStreamingThread(1);
+    else if (type == GST_STREAM_STATUS_TYPE_LEAVE)
+      GetFeedStats()->OnStreamingThread(-1);
+  }
+  return GST_BUS_PASS;
+}
+
+void ConfigureDeviceSink(GstElement* device_sink,
+                         GstElement* queue,
+                         bool low_latency) {
+  if (low_latency) {
+    // No queue threshold, the device buffer is the only one that counts.
+    g_object_set(GST_AUDIO_BASE_SINK(device_sink), "buffer-time",
+                 static_cast<gint64>(kLowLatencyBufferTime), "latency-time",
+                 static_cast<gint64>(kLowLatencyPeriodTime), nullptr);
+    return;
+  }
+  g_object_set(GST_AUDIO_BASE_SINK(device_sink), "buffer-time",
+               static_cast<gint64>(kBufferTime), nullptr);
+  g_object_set(queue, "min-threshold-time",
+               static_cast<guint64>(kBufferTime *
+                                    kSbTimeNanosecondsPerMicrosecond),
+               nullptr);
+}
+
+// One output pipeline shared by all sinks: each sink adds its own
+// appsrc ! audioconvert ! audioresample branch to a pad of an audiomixer,
+// which feeds a single device sink and runs its bus on one loop thread. A
+// silent live source keeps the mixer clocked when no sink is playing, so a
+// paused or starved input only leaves a gap of silence in the mix.
+class SharedAudioMixer {
+ public:
+  static SharedAudioMixer* Acquire();
+  static void Release(SharedAudioMixer* mixer);
+
+  GMainContext* context() const { return context_; }
+  GstElement* pipeline() const { return pipeline_; }
+  GstElement* queue() const { return queue_; }
+  GstElement* device_sink() const { return device_sink_; }
+  bool low_latency() const { return low_latency_; }
+
+  // Returns the mixer pad |input| is linked to, owned by the caller.
+  GstPad* AddInput(GstElement* input);
+  void RemoveInput(GstElement* input, GstPad* mixer_pad);
+
+  GstClockTime GetRunningTime() const;
+
+ private:
+  SharedAudioMixer();
+  ~SharedAudioMixer();
+
+  static void* LoopThreadEntryPoint(void* context);
+  static gboolean BusMessageCallback(GstBus* bus,
+                                     GstMessage* message,
+                                     gpointer user_data);
+  static void ChildAddedCallback(GstChildProxy* proxy,
+                                 GObject* object,
+                                 gchar* name,
+                                 gpointer user_data);
+
+  ::starboard::Mutex mutex_;
+  GMainContext* context_ { nullptr };
+  GMainLoop* loop_ { nullptr };
+  SbThread thread_ { kSbThreadInvalid };
+  GstElement* pipeline_ { nullptr };
+  GstElement* mixer_ { nullptr };
+  GstElement* queue_ { nullptr };
+  GstElement* device_sink_ { nullptr };
+  guint bus_source_id_ { 0 };
+  bool low_latency_ { false };
+};
+
+struct SharedAudioMixerRegistry {
+  ::starboard::Mutex mutex;
+  SharedAudioMixer* mixer { nullptr };
+  int users { 0 };
+};
+SB_ONCE_INITIALIZE_FUNCTION(SharedAudioMixerRegistry,
+                            GetSharedAudioMixerRegistry);
+
+// static
+SharedAudioMixer* SharedAudioMixer::Acquire() {
+  SharedAudioMixerRegistry* registry = GetSharedAudioMixerRegistry();
+  ::starboard::ScopedLock lock(registry->mutex);
+  if (!registry->mixer)
+    registry->mixer = new SharedAudioMixer();
+  ++registry->users;
+  return registry->mixer;
+}
+
+// static
+void SharedAudioMixer::Release(SharedAudioMixer* mixer) {
+  SharedAudioMixerRegistry* registry = GetSharedAudioMixerRegistry();
+  ::starboard::ScopedLock lock(registry->mutex);
+  SB_DCHECK(registry->mixer == mixer && registry->users > 0);
+  if (--registry->users == 0) {
+    delete registry->mixer;
+    registry->mixer = nullptr;
+  }
+}
+
+SharedAudioMixer::SharedAudioMixer() {
+  static const bool kLowLatency = !!getenv("COBALT_AUDIO_SINK_LOW_LATENCY");
+  low_latency_ = kLowLatency;
+
+  context_ = g_main_context_new();
+  loop_ = g_main_loop_new(context_, FALSE);
+  g_main_context_push_thread_default(context_);
+
+  pipeline_ = gst_pipeline_new("audio_mixer");
+  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+  gst_bus_set_sync_handler(bus, &CountStreamingThreads, nullptr, nullptr);
+  bus_source_id_ =
+      gst_bus_add_watch(bus, &SharedAudioMixer::BusMessageCallback, this);
+  gst_object_unref(bus);
+
+  GstElement* silence = gst_element_factory_make("audiotestsrc", nullptr);
+  gst_util_set_object_arg(G_OBJECT(silence), "wave", "silence");
+  g_object_set(silence, "is-live", TRUE, "samplesperbuffer",
+               low_latency_ ? kLowLatencyFramesPerRequest : kFramesPerRequest,
+               nullptr);
+
+  mixer_ = gst_element_factory_make("audiomixer", nullptr);
+  SbTime latency = low_latency_ ? kLowLatencyMixerLatency : kMixerLatency;
+  g_object_set(mixer_, "latency",
+               static_cast<guint64>(latency * kSbTimeNanosecondsPerMicrosecond),
+               nullptr);
+
+  GstElement* convert = gst_element_factory_make("audioconvert", nullptr);
+  GstElement* resample = gst_element_factory_make("audioresample", nullptr);
+  queue_ = gst_element_factory_make("queue", nullptr);
+  GstElement* audiosink = gst_element_factory_make("autoaudiosink", nullptr);
+  g_signal_connect(audiosink, "child-added",
+                   G_CALLBACK(&SharedAudioMixer::ChildAddedCallback), this);
+
+  gst_bin_add_many(GST_BIN(pipeline_), silence, mixer_, convert, resample,
+                   queue_, audiosink, nullptr);
+  gst_element_link_many(silence, mixer_, convert, resample, queue_, audiosink,
+                        nullptr);
+  gst_element_set_state(pipeline_, GST_STATE_PLAYING);
+
+  g_main_context_pop_thread_default(context_);
+
+  GetFeedStats()->OnPipeline(1);
+  GetFeedStats()->OnLoopThread(1);
+  thread_ = SbThreadCreate(0, kSbThreadPriorityRealTime, kSbThreadNoAffinity,
+                           true, "audio_mixer",
+                           &SharedAudioMixer::LoopThreadEntryPoint, this);
+  SB_DCHECK(SbThreadIsValid(thread_));
+}
+
+SharedAudioMixer::~SharedAudioMixer() {
+  g_main_loop_quit(loop_);
+  SbThreadJoin(thread_, nullptr);
+  GetFeedStats()->OnLoopThread(-1);
+
+  gst_element_set_state(pipeline_, GST_STATE_NULL);
+  GSource* src = g_main_context_find_source_by_id(context_, bus_source_id_);
+  if (src)
+    g_source_destroy(src);
+  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+  gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
+  gst_object_unref(bus);
+  gst_object_unref(pipeline_);
+  g_main_loop_unref(loop_);
+  g_main_context_unref(context_);
+  GetFeedStats()->OnPipeline(-1);
+}
+
+GstPad* SharedAudioMixer::AddInput(GstElement* input) {
+  ::starboard::ScopedLock lock(mutex_);
+  gst_bin_add(GST_BIN(pipeline_), input);
+  GstPad* mixer_pad = gst_element_get_request_pad(mixer_, "sink_%u");
+  GstPad* src_pad = gst_element_get_static_pad(input, "src");
+  if (gst_pad_link(src_pad, mixer_pad) != GST_PAD_LINK_OK)
+    GST_ERROR_OBJECT(pipeline_, "Failed to link %" GST_PTR_FORMAT, input);
+  gst_object_unref(src_pad);
+  gst_element_sync_state_with_parent(input);
+  GST_DEBUG_OBJECT(pipeline_, "Added %" GST_PTR_FORMAT " on %" GST_PTR_FORMAT,
+                   input, mixer_pad);
+  return mixer_pad;
+}
+
+void SharedAudioMixer::RemoveInput(GstElement* input, GstPad* mixer_pad) {
+  ::starboard::ScopedLock lock(mutex_);
+  GST_DEBUG_OBJECT(pipeline_, "Removing %" GST_PTR_FORMAT, input);
+  gst_element_set_state(input, GST_STATE_NULL);
+  GstPad* src_pad = gst_element_get_static_pad(input, "src");
+  gst_pad_unlink(src_pad, mixer_pad);
+  gst_object_unref(src_pad);
+  gst_element_release_request_pad(mixer_, mixer_pad);
+  gst_object_unref(mixer_pad);
+  gst_bin_remove(GST_BIN(pipeline_), input);
+}
+
+GstClockTime SharedAudioMixer::GetRunningTime() const {
+  GstClock* clock = gst_pipeline_get_clock(GST_PIPELINE(pipeline_));
+  if (!clock)
+    return GST_CLOCK_TIME_NONE;
+  GstClockTime now = gst_clock_get_time(clock);
+  GstClockTime base_time = gst_element_get_base_time(pipeline_);
+  gst_object_unref(clock);
+  return now > base_time ? now - base_time : 0;
+}
+
+// static
+void* SharedAudioMixer::LoopThreadEntryPoint(void* context) {
+  SharedAudioMixer* mixer = static_cast<SharedAudioMixer*>(context);
+  g_main_context_push_thread_default(mixer->context_);
+  g_main_loop_run(mixer->loop_);
+  g_main_context_pop_thread_default(mixer->context_);
+  return nullptr;
+}
+
+// static
+gboolean SharedAudioMixer::BusMessageCallback(GstBus* bus,
+                                              GstMessage* message,
+                                              gpointer user_data) {
+  SB_UNREFERENCED_PARAMETER(bus);
+  SharedAudioMixer* mixer = static_cast<SharedAudioMixer*>(user_data);
+
+  switch (GST_MESSAGE_TYPE(message)) {
+    case GST_MESSAGE_LATENCY:
+      gst_bin_recalculate_latency(GST_BIN(mixer->pipeline_));
+      break;
+
+    case GST_MESSAGE_ERROR: {
+      GError* err = nullptr;
+      gchar* debug = nullptr;
+      gst_message_parse_error(message, &err, &debug);
+      GST_ERROR_OBJECT(mixer->pipeline_, "Error %d: %s (%s)", err->code,
+                       err->message, debug);
+      g_free(debug);
+      g_error_free(err);
+      break;
+    }
+
+    case GST_MESSAGE_STATE_CHANGED:
+      if (GST_MESSAGE_SRC(message) == GST_OBJECT(mixer->pipeline_)) {
+        GstState old_state, new_state;
+        gst_message_parse_state_changed(message, &old_state, &new_state,
+                                        nullptr);
+        GST_INFO_OBJECT(mixer->pipeline_, "State changed (old: %s, new: %s)",
+                        gst_element_state_get_name(old_state),
+                        gst_element_state_get_name(new_state));
+      }
+      break;
+
+    default:
+      GST_LOG("Got GST message %s from %s", GST_MESSAGE_TYPE_NAME(message),
+              GST_MESSAGE_SRC_NAME(message));
+      break;
+  }
+
+  return TRUE;
+}
+
+// static
+void SharedAudioMixer::ChildAddedCallback(GstChildProxy* proxy,
+                                          GObject* object,
+                                          gchar* name,
+                                          gpointer user_data) {
+  SB_UNREFERENCED_PARAMETER(proxy);
+  SB_UNREFERENCED_PARAMETER(name);
+  SharedAudioMixer* mixer = static_cast<SharedAudioMixer*>(user_data);
+  if (GST_IS_AUDIO_BASE_SINK(object)) {
+    mixer->device_sink_ = GST_ELEMENT(object);
+    ConfigureDeviceSink(mixer->device_sink_, mixer->queue_,
+                        mixer->low_latency_);
+  }
+}
 
 class GStreamerAudioSink : public SbAudioSinkPrivate {
  public:
@@ -85,11 +580,20 @@ class GStreamerAudioSink : public SbAudioSinkPrivate {
   bool IsType(Type* type) override { return type_ == type; }
 
   void SetPlaybackRate(double playback_rate) override {
-    SB_NOTIMPLEMENTED();
+    GST_LOG_OBJECT(pipeline_, "rate %lf", playback_rate);
+    if (playback_rate != 0. && playback_rate != 1.)
+      GST_FIXME_OBJECT(pipeline_, "rate %lf is not supported", playback_rate);
+    ::starboard::ScopedLock lock(mutex_);
+    playback_rate_ = playback_rate;
+    feed_condition_.Signal();
   }
 
   void SetVolume(double volume) override {
     GST_LOG_OBJECT(pipeline_, "volume %lf", volume);
+    if (mixer_pad_) {
+      g_object_set(mixer_pad_, "volume", volume, nullptr);
+      return;
+    }
     gst_stream_volume_set_volume(GST_STREAM_VOLUME(pipeline_),
                                  GST_STREAM_VOLUME_FORMAT_LINEAR, volume);
   }
@@ -106,10 +610,25 @@ class GStreamerAudioSink : public SbAudioSinkPrivate {
                                               gchar* name,
                                               gpointer user_data);
 
+  bool WaitForFrames(bool is_playing);
+  bool PushFrames(int offset_in_frames, int frames_to_write);
+  GstBuffer* WrapFrames(uint8_t* frames, int frame_count);
+  GstCaps* QueryDeviceCaps();
+  bool SelectConverter(GstCaps* device_caps, GstCaps** caps);
+  void CreateOwnPipeline(GstCaps* caps);
+  void AddMixerInput(GstCaps* caps);
+  void UpdateOutputLatency();
+  void RemoveSources();
+
   size_t GetBytesPerFrame() const {
     return channels_ * GetBytesPerSample(audio_sample_type_);
   }
 
+  size_t GetOutputBytesPerFrame() const {
+    return converter_ ? converter_->GetOutputBytesPerFrame()
+                      : GetBytesPerFrame();
+  }
+
   Type* type_{nullptr};
   int channels_{0};
   int sampling_frequency_hz_{0};
@@ -122,19 +641,52 @@ class GStreamerAudioSink : public SbAudioSinkPrivate {
   SbThread audio_loop_thread_{kSbThreadInvalid};
   void* context_{nullptr};
   ::starboard::Mutex mutex_;
+  ::starboard::ConditionVariable feed_condition_{mutex_};
+  // Serializes the renderer's status and consume callbacks against
+  // |frames_in_flight_| when frames are wrapped instead of copied.
+  ::starboard::Mutex ring_mutex_;
+  bool zero_copy_{false};
+  bool detached_{false};
+  int frames_in_flight_{0};
   GstElement* pipeline_{nullptr};
   GstElement* appsrc_{nullptr};
   GstElement* queue_{nullptr};
   GstElement* audiosink_{nullptr};
+  GstElement* device_sink_{nullptr};
+  std::unique_ptr<PcmConverter> converter_;
+  // Shared output mode: this sink's branch and pad in the mixer pipeline.
+  SharedAudioMixer* mixer_{nullptr};
+  GstElement* input_{nullptr};
+  GstPad* mixer_pad_{nullptr};
+  bool live_base_valid_{false};
+  gint64 live_base_{0};
   GMainLoop* mainloop_{nullptr};
   GMainContext* main_loop_context_{nullptr};
   guint source_id_{0};
   bool destroying_{false};
   bool enough_data_{false};
+  bool low_latency_{false};
+  int frames_per_request_{kFramesPerRequest};
+  SbTime max_starved_wait_{kMaxStarvedFeedWait};
+  // Time until frames handed to appsrc, resp. taken by the device sink, are
+  // heard. Used to date consumed frames in the low latency profile.
+  std::atomic<int64_t> output_latency_{0};
+  std::atomic<int64_t> device_latency_{0};
   std::string file_name_;
   int total_frames_{0};
+  double playback_rate_{1.};
+  SbTime feed_wait_{kMinFeedWait};
+  SbTime last_feed_wait_{0};
+  SbTime last_push_at_{0};
+  SbTime last_push_duration_{0};
+  double push_jitter_{0.};
 
   int hang_monitor_source_id_ { -1 };
+  int latency_source_id_ { -1 };
+  // Shared output mode: set by the mixer thread once the sources above are
+  // gone, guarded by |mutex_|.
+  bool sources_removed_ { false };
+  ::starboard::ConditionVariable sources_removed_condition_ { mutex_ };
   HangMonitor hang_monitor_ { "AudioSink" };
 };
 
@@ -165,40 +717,76 @@ GStreamerAudioSink::GStreamerAudioSink(
 
   GST_TRACE("TID: %d", SbThreadGetId());
 
+  GetFeedStats()->OnSinkCreated();
+
+  static const bool kLowLatency = !!getenv("COBALT_AUDIO_SINK_LOW_LATENCY");
+  low_latency_ = kLowLatency;
+  if (low_latency_) {
+    frames_per_request_ = kLowLatencyFramesPerRequest;
+    max_starved_wait_ = kLowLatencyMaxStarvedFeedWait;
+  }
+
   SB_DCHECK(audio_frame_storage_type == kSbMediaAudioFrameStorageTypeInterleaved)
       << "It seems SbAudioSinkIsAudioFrameStorageTypeSupported() was changed "
       << "without adjustng here.";
 
-  main_loop_context_ = g_main_context_new();
-  mainloop_ = g_main_loop_new(main_loop_context_, FALSE);
+  static const bool kSharedOutput =
+      !!getenv("COBALT_AUDIO_SINK_SHARED_OUTPUT");
+  if (kSharedOutput) {
+    mixer_ = SharedAudioMixer::Acquire();
+    main_loop_context_ = g_main_context_ref(mixer_->context());
+  } else {
+    main_loop_context_ = g_main_context_new();
+    mainloop_ = g_main_loop_new(main_loop_context_, FALSE);
+  }
   g_main_context_push_thread_default(main_loop_context_);
 
   GSource* src = g_timeout_source_new(hang_monitor_.GetResetInterval() / kSbTimeMillisecond);
   g_source_set_callback(src, [] (gpointer data) ->gboolean {
     auto& sink = *static_cast<GStreamerAudioSink*>(data);
     sink.hang_monitor_.Reset();
+    RecordLoopCpu();
     return G_SOURCE_CONTINUE;
   }, this, nullptr);
   hang_monitor_source_id_ = g_source_attach(src, main_loop_context_);
   g_source_unref(src);
 
-  const char* format =
-      audio_sample_type == kSbMediaAudioSampleTypeFloat32 ? "F32LE" : "S16LE";
-  GstCaps* audio_caps = gst_caps_new_simple(
-      "audio/x-raw", "format", G_TYPE_STRING, format, "rate", G_TYPE_INT,
-      sampling_frequency_hz, "channels", G_TYPE_INT, channels, "layout",
-      G_TYPE_STRING, "interleaved", "channel-mask", GST_TYPE_BITMASK,
-      gst_audio_channel_get_fallback_mask(channels), nullptr);
+  // Bus messages update the latency on changes, polling is only needed where
+  // consumed frames are dated with it or inputs share one output.
+  if (low_latency_ || mixer_) {
+    src = g_timeout_source_new(kLatencyUpdateInterval / kSbTimeMillisecond);
+    g_source_set_callback(src, [] (gpointer data) ->gboolean {
+      static_cast<GStreamerAudioSink*>(data)->UpdateOutputLatency();
+      return G_SOURCE_CONTINUE;
+    }, this, nullptr);
+    latency_source_id_ = g_source_attach(src, main_loop_context_);
+    g_source_unref(src);
+  }
 
-  appsrc_ = gst_element_factory_make("appsrc", "source");
-  GstAppSrcCallbacks callbacks = {&GStreamerAudioSink::AppSrcNeedData,
-                                  &GStreamerAudioSink::AppSrcEnoughData,
-                                  nullptr};
-  gst_app_src_set_callbacks(GST_APP_SRC(appsrc_), &callbacks, this, nullptr);
-  gst_app_src_set_max_bytes(GST_APP_SRC(appsrc_),
-                            kFramesPerRequest * GetBytesPerFrame());
-  g_object_set(appsrc_, "format", GST_FORMAT_TIME, nullptr);
-  gst_app_src_set_caps(GST_APP_SRC(appsrc_), audio_caps);
+  GstCaps* audio_caps = CreateAudioCaps(audio_sample_type,
+                                        sampling_frequency_hz, channels);
+  if (mixer_)
+    AddMixerInput(audio_caps);
+  else
+    CreateOwnPipeline(audio_caps);
+  gst_caps_unref(audio_caps);
+
+  g_main_context_pop_thread_default(main_loop_context_);
+
+  if (mixer_)
+    return;
+
+  GetFeedStats()->OnLoopThread(1);
+  audio_loop_thread_ = SbThreadCreate(
+      0, kSbThreadPriorityRealTime, kSbThreadNoAffinity, true, "audio_loop",
+      &GStreamerAudioSink::AudioThreadEntryPoint, this);
+  SB_DCHECK(SbThreadIsValid(audio_loop_thread_));
+}
+
+void GStreamerAudioSink::CreateOwnPipeline(GstCaps* caps) {
+  GstCaps* audio_caps = gst_caps_ref(caps);
+
+  queue_ = gst_element_factory_make("queue", nullptr);
 
   audiosink_ = gst_element_factory_make("autoaudiosink", "sink");
   g_signal_connect(
@@ -207,38 +795,138 @@ GStreamerAudioSink::GStreamerAudioSink(
 
   pipeline_ = gst_pipeline_new("audio");
   GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+  gst_bus_set_sync_handler(bus, &CountStreamingThreads, nullptr, nullptr);
   source_id_ =
       gst_bus_add_watch(bus, &GStreamerAudioSink::BusMessageCallback, this);
   gst_object_unref(bus);
+  GetFeedStats()->OnPipeline(1);
+
+  // Feed the device directly when it takes the stream as is, or after an
+  // in-sink conversion (COBALT_AUDIO_SINK_NATIVE_CONVERT), instead of going
+  // through audioconvert/audioresample.
+  static const bool kNativeConvert =
+      !!getenv("COBALT_AUDIO_SINK_NATIVE_CONVERT");
+  bool native = false;
+  if (low_latency_ || kNativeConvert) {
+    GstCaps* device_caps = QueryDeviceCaps();
+    if (device_caps) {
+      native = gst_caps_can_intersect(audio_caps, device_caps);
+      if (!native && kNativeConvert)
+        native = SelectConverter(device_caps, &audio_caps);
+      gst_caps_unref(device_caps);
+    }
+  }
 
-  GstElement* convert = gst_element_factory_make("audioconvert", nullptr);
-  GstElement* resample = gst_element_factory_make("audioresample", nullptr);
-  queue_ = gst_element_factory_make("queue", nullptr);
-  g_object_set(queue_, "max-size-bytes", kFramesPerRequest * GetBytesPerFrame(),
-               nullptr);
-  gst_bin_add_many(GST_BIN(pipeline_), appsrc_, convert, resample, queue_,
-                   audiosink_, nullptr);
-  gst_element_link_many(appsrc_, convert, resample, queue_, audiosink_,
-                        nullptr);
+  // Converted frames no longer live in the renderer's ring.
+  static const bool kEnableZeroCopy = !!getenv("COBALT_AUDIO_SINK_ZERO_COPY");
+  zero_copy_ = kEnableZeroCopy && !converter_;
+
+  appsrc_ = gst_element_factory_make("appsrc", "source");
+  GstAppSrcCallbacks callbacks = {&GStreamerAudioSink::AppSrcNeedData,
+                                  &GStreamerAudioSink::AppSrcEnoughData,
+                                  nullptr};
+  gst_app_src_set_callbacks(GST_APP_SRC(appsrc_), &callbacks, this, nullptr);
+  gst_app_src_set_max_bytes(GST_APP_SRC(appsrc_),
+                            frames_per_request_ * GetOutputBytesPerFrame());
+  g_object_set(appsrc_, "format", GST_FORMAT_TIME, nullptr);
+  gst_app_src_set_caps(GST_APP_SRC(appsrc_), audio_caps);
+
+  g_object_set(queue_, "max-size-bytes",
+               frames_per_request_ * GetOutputBytesPerFrame(), nullptr);
+
+  if (native) {
+    GST_INFO_OBJECT(pipeline_, "Device takes %" GST_PTR_FORMAT
+                    " as is, no conversion elements", audio_caps);
+    gst_bin_add_many(GST_BIN(pipeline_), appsrc_, queue_, audiosink_, nullptr);
+    gst_element_link_many(appsrc_, queue_, audiosink_, nullptr);
+  } else {
+    GstElement* convert = gst_element_factory_make("audioconvert", nullptr);
+    GstElement* resample = gst_element_factory_make("audioresample", nullptr);
+    gst_bin_add_many(GST_BIN(pipeline_), appsrc_, convert, resample, queue_,
+                     audiosink_, nullptr);
+    gst_element_link_many(appsrc_, convert, resample, queue_, audiosink_,
+                          nullptr);
+  }
   gst_caps_unref(audio_caps);
 
   gst_element_set_state(pipeline_, GST_STATE_PLAYING);
+}
 
-  g_main_context_pop_thread_default(main_loop_context_);
+void GStreamerAudioSink::AddMixerInput(GstCaps* caps) {
+  // The mixer converts every input to its output format, the device format
+  // is negotiated once for all sinks.
+  pipeline_ = GST_ELEMENT(gst_object_ref(mixer_->pipeline()));
+  queue_ = mixer_->queue();
+  device_sink_ = mixer_->device_sink();
 
-  audio_loop_thread_ = SbThreadCreate(
-      0, kSbThreadPriorityRealTime, kSbThreadNoAffinity, true, "audio_loop",
-      &GStreamerAudioSink::AudioThreadEntryPoint, this);
-  SB_DCHECK(SbThreadIsValid(audio_loop_thread_));
+  static const bool kEnableZeroCopy = !!getenv("COBALT_AUDIO_SINK_ZERO_COPY");
+  zero_copy_ = kEnableZeroCopy;
+
+  appsrc_ = gst_element_factory_make("appsrc", nullptr);
+  GstAppSrcCallbacks callbacks = {&GStreamerAudioSink::AppSrcNeedData,
+                                  &GStreamerAudioSink::AppSrcEnoughData,
+                                  nullptr};
+  gst_app_src_set_callbacks(GST_APP_SRC(appsrc_), &callbacks, this, nullptr);
+  gst_app_src_set_max_bytes(GST_APP_SRC(appsrc_),
+                            frames_per_request_ * GetBytesPerFrame());
+  // Live, so that the mixer does not wait for an input that is paused.
+  g_object_set(appsrc_, "format", GST_FORMAT_TIME, "is-live", TRUE, nullptr);
+  gst_app_src_set_caps(GST_APP_SRC(appsrc_), caps);
+
+  GstElement* convert = gst_element_factory_make("audioconvert", nullptr);
+  GstElement* resample = gst_element_factory_make("audioresample", nullptr);
+  input_ = gst_bin_new(nullptr);
+  gst_bin_add_many(GST_BIN(input_), appsrc_, convert, resample, nullptr);
+  gst_element_link_many(appsrc_, convert, resample, nullptr);
+  GstPad* pad = gst_element_get_static_pad(resample, "src");
+  gst_element_add_pad(input_, gst_ghost_pad_new("src", pad));
+  gst_object_unref(pad);
+
+  mixer_pad_ = mixer_->AddInput(input_);
 }
 
 GStreamerAudioSink::~GStreamerAudioSink() {
   GST_TRACE_OBJECT(pipeline_, "TID: %d", SbThreadGetId());
 
-  if (hang_monitor_source_id_ > -1) {
-    GSource* src = g_main_context_find_source_by_id(main_loop_context_, hang_monitor_source_id_);
-    g_source_destroy(src);
-    hang_monitor_.Reset();
+  if (mixer_) {
+    // The mixer loop keeps running, a source destroyed from here could still
+    // be dispatching. Remove them on the mixer thread and wait for it.
+    g_main_context_invoke(main_loop_context_, [](gpointer data) -> gboolean {
+      auto* sink = static_cast<GStreamerAudioSink*>(data);
+      sink->RemoveSources();
+      ::starboard::ScopedLock lock(sink->mutex_);
+      sink->sources_removed_ = true;
+      sink->sources_removed_condition_.Broadcast();
+      return G_SOURCE_REMOVE;
+    }, this);
+    {
+      ::starboard::ScopedLock lock(mutex_);
+      while (!sources_removed_)
+        sources_removed_condition_.Wait();
+    }
+  } else {
+    // The loop thread is joined below before anything gets freed.
+    RemoveSources();
+  }
+
+  if (mixer_) {
+    mutex_.Acquire();
+    destroying_ = true;
+    feed_condition_.Broadcast();
+    mutex_.Release();
+
+    {
+      ::starboard::ScopedLock lock(ring_mutex_);
+      detached_ = true;
+    }
+
+    mixer_->RemoveInput(input_, mixer_pad_);
+    gst_object_unref(pipeline_);
+    g_main_context_unref(main_loop_context_);
+    SharedAudioMixer::Release(mixer_);
+
+    GetFeedStats()->OnSinkDestroyed();
+    return;
   }
 
   GSource* timeout_src = g_timeout_source_new_seconds(1);
@@ -251,6 +939,7 @@ GStreamerAudioSink::~GStreamerAudioSink() {
 
   mutex_.Acquire();
   destroying_ = true;
+  feed_condition_.Broadcast();
   mutex_.Release();
 
   // this will wake up apprsc if it is waiting for data
@@ -258,6 +947,14 @@ GStreamerAudioSink::~GStreamerAudioSink() {
 
   bool rc = SbThreadJoin(audio_loop_thread_, nullptr);
   SB_DCHECK(rc);
+  GetFeedStats()->OnLoopThread(-1);
+
+  // Buffers still wrapping the ring are dropped below, the renderer is
+  // tearing the sink down and must not be called back for them.
+  {
+    ::starboard::ScopedLock lock(ring_mutex_);
+    detached_ = true;
+  }
 
   gst_element_set_state(pipeline_, GST_STATE_NULL);
   if (source_id_ > -1) {
@@ -270,6 +967,24 @@ GStreamerAudioSink::~GStreamerAudioSink() {
   g_main_loop_unref(mainloop_);
   gst_object_unref(pipeline_);
   g_main_context_unref(main_loop_context_);
+  GetFeedStats()->OnPipeline(-1);
+
+  GetFeedStats()->OnSinkDestroyed();
+}
+
+void GStreamerAudioSink::RemoveSources() {
+  if (hang_monitor_source_id_ > -1) {
+    GSource* src = g_main_context_find_source_by_id(main_loop_context_, hang_monitor_source_id_);
+    g_source_destroy(src);
+    hang_monitor_source_id_ = -1;
+    hang_monitor_.Reset();
+  }
+
+  if (latency_source_id_ > -1) {
+    GSource* src = g_main_context_find_source_by_id(main_loop_context_, latency_source_id_);
+    g_source_destroy(src);
+    latency_source_id_ = -1;
+  }
 }
 
 // static
@@ -304,6 +1019,11 @@ gboolean GStreamerAudioSink::BusMessageCallback(GstBus* bus,
       }
       break;
 
+    case GST_MESSAGE_LATENCY:
+      gst_bin_recalculate_latency(GST_BIN(sink->pipeline_));
+      sink->UpdateOutputLatency();
+      break;
+
     case GST_MESSAGE_ERROR: {
       GError* err = nullptr;
       gchar* debug = nullptr;
@@ -335,6 +1055,9 @@ gboolean GStreamerAudioSink::BusMessageCallback(GstBus* bus,
         GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS(GST_BIN(sink->pipeline_),
                                           GST_DEBUG_GRAPH_SHOW_ALL,
                                           file_name.c_str());
+
+        if (newState == GST_STATE_PLAYING)
+          sink->UpdateOutputLatency();
       }
       break;
 
@@ -357,6 +1080,7 @@ void GStreamerAudioSink::AppSrcNeedData(GstAppSrc* src,
 
   GST_TRACE_OBJECT(sink->pipeline_, "TID: %d", SbThreadGetId());
 
+  SbTime cpu_time = GetThreadCpuTime();
   sink->enough_data_ = false;
   int frames_in_buffer = 0;
   int offset_in_frames = 0;
@@ -374,85 +1098,329 @@ void GStreamerAudioSink::AppSrcNeedData(GstAppSrc* src,
                        "GStreamerAudioSink::AppSrcNeedData "
                        "bailing out");
       gst_app_src_end_of_stream(GST_APP_SRC(sink->appsrc_));
-      return;
-    } else {
+      break;
+    }
+
+    int frames_in_flight = 0;
+    {
+      ::starboard::ScopedLock lock(sink->ring_mutex_);
       sink->update_source_status_func_(&frames_in_buffer, &offset_in_frames,
                                        &is_playing, &is_eos_reached,
                                        sink->context_);
-      GST_DEBUG_OBJECT(sink->pipeline_,
-                       "Updated: frames in buff: %d, offset: %d"
-                       " is_playing: %d, eos %d",
-                       frames_in_buffer, offset_in_frames, is_playing,
-                       is_eos_reached);
-
-      int frames_to_write = ((frames_in_buffer + offset_in_frames) < sink->frame_buffers_size_in_frames_)
-          ? frames_in_buffer
-          : sink->frame_buffers_size_in_frames_ - offset_in_frames;
-
-      frames_to_write = std::min(kFramesPerRequest, frames_to_write);
-
-      if (is_playing && frames_to_write > 0) {
-          GstBuffer* buffer = gst_buffer_new_allocate(
-              nullptr, frames_to_write * sink->GetBytesPerFrame(), nullptr);
-          uint8_t* beginning = static_cast<uint8_t*>(sink->frame_buffers_[0]) +
-                               offset_in_frames * sink->GetBytesPerFrame();
-          gst_buffer_fill(buffer, 0, beginning,
-                          frames_to_write * sink->GetBytesPerFrame());
-          GST_DEBUG_OBJECT(sink->pipeline_, "Pushing %d frames (%zd bytes)",
-                           frames_to_write,
-                           frames_to_write * sink->GetBytesPerFrame());
-          auto timestamp = gst_util_uint64_scale(
-              sink->total_frames_, GST_SECOND, sink->sampling_frequency_hz_);
-          GST_BUFFER_TIMESTAMP(buffer) = timestamp;
-          sink->total_frames_ += frames_to_write;
-          GST_BUFFER_DURATION(buffer) =
-              gst_util_uint64_scale(sink->total_frames_, GST_SECOND,
-                                    sink->sampling_frequency_hz_) -
-              timestamp;
-          GST_DEBUG_OBJECT(sink->pipeline_,
-                           "Buffer to be pushed has %" GST_TIME_FORMAT
-                           " ts and %" GST_TIME_FORMAT " dur",
-                           GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buffer)),
-                           GST_TIME_ARGS(GST_BUFFER_DURATION(buffer)));
-          gst_app_src_push_buffer(GST_APP_SRC(sink->appsrc_), buffer);
-
-          GST_DEBUG_OBJECT(sink->pipeline_,
-                           "Update consumed by %d. Total %d"
-                           "(%zd b)",
-                           frames_to_write, sink->total_frames_,
-                           sink->total_frames_ * sink->GetBytesPerFrame());
-          sink->consume_frame_func_(frames_to_write,
-                                    SbTimeGetMonotonicNow(),
-                                    sink->context_);
+      frames_in_flight = sink->frames_in_flight_;
+    }
+    GST_DEBUG_OBJECT(sink->pipeline_,
+                     "Updated: frames in buff: %d, offset: %d"
+                     " is_playing: %d, eos %d, in flight: %d",
+                     frames_in_buffer, offset_in_frames, is_playing,
+                     is_eos_reached, frames_in_flight);
+
+    // Wrapped frames stay in the ring until GStreamer releases them, skip
+    // the ones that were already pushed.
+    if (frames_in_flight > 0) {
+      frames_in_buffer -= frames_in_flight;
+      offset_in_frames = (offset_in_frames + frames_in_flight) %
+          sink->frame_buffers_size_in_frames_;
+    }
+
+    int frames_to_write = ((frames_in_buffer + offset_in_frames) < sink->frame_buffers_size_in_frames_)
+        ? frames_in_buffer
+        : sink->frame_buffers_size_in_frames_ - offset_in_frames;
+
+    frames_to_write = std::min(sink->frames_per_request_, frames_to_write);
+
+    // A failed push leaves the frames in the ring, wait before retrying.
+    if (is_playing && frames_to_write > 0 &&
+        sink->PushFrames(offset_in_frames, frames_to_write)) {
+      continue;
+    }
+
+    GetFeedStats()->RecordIdlePoll();
+    if (!is_playing) {
+      sink->last_push_at_ = 0;
+      sink->live_base_valid_ = false;
+    }
+    sink->WaitForFrames(is_playing);
+  }
+
+  GetFeedStats()->RecordFeedCpu(GetThreadCpuTime() - cpu_time);
+}
+
+bool GStreamerAudioSink::WaitForFrames(bool is_playing) {
+  ::starboard::ScopedLock lock(mutex_);
+  if (destroying_)
+    return true;
+
+  bool paused = !is_playing || playback_rate_ == 0.;
+  SbTime cap = paused ? kMaxPausedFeedWait : max_starved_wait_;
+  SbTime wait = feed_wait_ < cap ? feed_wait_ : cap;
+  SbTime started_at = SbTimeGetMonotonicNow();
+  bool signalled = feed_condition_.WaitTimed(wait);
+  SbTime waited = SbTimeGetMonotonicNow() - started_at;
+
+  // A signal means the state changed, so poll eagerly again afterwards.
+  feed_wait_ = signalled ? kMinFeedWait : wait * 2;
+  last_feed_wait_ = waited;
+  GetFeedStats()->RecordWait(waited, signalled);
+  return signalled;
+}
+
+bool GStreamerAudioSink::PushFrames(int offset_in_frames, int frames_to_write) {
+  uint8_t* beginning = static_cast<uint8_t*>(frame_buffers_[0]) +
+                       offset_in_frames * GetBytesPerFrame();
+  GstBuffer* buffer = nullptr;
+  if (zero_copy_) {
+    buffer = WrapFrames(beginning, frames_to_write);
+  } else if (converter_) {
+    buffer = SamplePool::Get(kSbMediaTypeAudio)->Allocate(
+        frames_to_write * converter_->GetOutputBytesPerFrame());
+    GstMapInfo map;
+    if (!gst_buffer_map(buffer, &map, GST_MAP_WRITE)) {
+      GST_ERROR_OBJECT(pipeline_, "Failed to map %" G_GSIZE_FORMAT " byte buffer",
+                       gst_buffer_get_size(buffer));
+      gst_buffer_unref(buffer);
+      return false;
+    }
+    SbTime started_at = SbTimeGetMonotonicNow();
+    converter_->Convert(beginning, frames_to_write, map.data);
+    GetFeedStats()->RecordConversion(frames_to_write,
+                                     SbTimeGetMonotonicNow() - started_at);
+    gst_buffer_unmap(buffer, &map);
+  } else {
+    buffer = SamplePool::Get(kSbMediaTypeAudio)->AllocateAndFill(
+        beginning, frames_to_write * GetBytesPerFrame());
+  }
+  GST_DEBUG_OBJECT(pipeline_, "Pushing %d frames (%zd bytes)",
+                   frames_to_write,
+                   frames_to_write * GetBytesPerFrame());
+  auto timestamp = gst_util_uint64_scale(
+      total_frames_, GST_SECOND, sampling_frequency_hz_);
+  GST_BUFFER_TIMESTAMP(buffer) = timestamp;
+  if (mixer_) {
+    // Inputs of the live mixer are timed on its clock, anchored on the first
+    // push, again after every pause and whenever a starved input fell behind
+    // the mixer, which would drop everything that follows as late.
+    GstClockTime now = mixer_->GetRunningTime();
+    if (GST_CLOCK_TIME_IS_VALID(now) &&
+        (!live_base_valid_ ||
+         live_base_ + static_cast<gint64>(timestamp) < static_cast<gint64>(now))) {
+      live_base_ = static_cast<gint64>(now) - static_cast<gint64>(timestamp);
+      live_base_valid_ = true;
+      GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DISCONT);
+    }
+    GST_BUFFER_TIMESTAMP(buffer) =
+        live_base_valid_ ? static_cast<GstClockTime>(live_base_ + timestamp)
+                         : GST_CLOCK_TIME_NONE;
+  }
+  total_frames_ += frames_to_write;
+  GST_BUFFER_DURATION(buffer) =
+      gst_util_uint64_scale(total_frames_, GST_SECOND,
+                            sampling_frequency_hz_) -
+      timestamp;
+  GST_DEBUG_OBJECT(pipeline_,
+                   "Buffer to be pushed has %" GST_TIME_FORMAT
+                   " ts and %" GST_TIME_FORMAT " dur",
+                   GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buffer)),
+                   GST_TIME_ARGS(GST_BUFFER_DURATION(buffer)));
+  SbTime duration = GST_BUFFER_DURATION(buffer) / GST_USECOND;
+  gst_app_src_push_buffer(GST_APP_SRC(appsrc_), buffer);
+
+  GST_DEBUG_OBJECT(pipeline_,
+                   "Update consumed by %d. Total %d"
+                   "(%zd b)",
+                   frames_to_write, total_frames_,
+                   total_frames_ * GetBytesPerFrame());
+  SbTime now = SbTimeGetMonotonicNow();
+  if (!zero_copy_) {
+    // Pushed frames are heard only after the pipeline latency, report them
+    // as consumed then so that the media time does not run ahead.
+    SbTime consumed_at = now;
+    if (low_latency_)
+      consumed_at += output_latency_.load(std::memory_order_relaxed);
+    consume_frame_func_(frames_to_write, consumed_at, context_);
+  }
+
+  // Interarrival jitter as in RFC 3550: deviation of the push interval from
+  // the duration of the previous push, smoothed over 16 pushes.
+  if (last_push_at_ > 0) {
+    SbTime deviation = (now - last_push_at_) - last_push_duration_;
+    if (deviation < 0)
+      deviation = -deviation;
+    push_jitter_ += (deviation - push_jitter_) / 16.;
+  }
+  last_push_at_ = now;
+  last_push_duration_ = duration;
+
+  // The frames showed up at some point during the last wait, which bounds
+  // how long they were left sitting in the renderer's buffer.
+  GetFeedStats()->RecordPush(last_feed_wait_, push_jitter_, zero_copy_,
+                             frames_to_write * GetBytesPerFrame());
+  last_feed_wait_ = 0;
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    feed_wait_ = kMinFeedWait;
+  }
 
 #if defined(DUMP_PCM_TO_FILE)
-          if (sink->file_name_.empty()) {
-            sink->file_name_ = "/tmp/sound" +
-                               std::to_string(SbTimeToPosix(SbTimeGetNow())) +
-                               ".pcm";
-          }
-          SbFileError error;
-          bool created;
-          SbFile file = SbFileOpen(
-              sink->file_name_.c_str(),
-              SbFileFlags::kSbFileOpenAlways | SbFileFlags::kSbFileWrite,
-              &created, &error);
-          if (SbFileIsValid(file)) {
-            SbFileSeek(file, SbFileWhence::kSbFileFromEnd, 0);
-            SbFileWrite(file,
-                        static_cast<const char*>(sink->frame_buffers_[0]) +
-                            offset_in_frames * sink->GetBytesPerFrame(),
-                        frames_to_write * sink->GetBytesPerFrame());
-            SbFileClose(file);
-          }
+  if (file_name_.empty()) {
+    file_name_ = "/tmp/sound" +
+                 std::to_string(SbTimeToPosix(SbTimeGetNow())) +
+                 ".pcm";
+  }
+  SbFileError error;
+  bool created;
+  SbFile file = SbFileOpen(
+      file_name_.c_str(),
+      SbFileFlags::kSbFileOpenAlways | SbFileFlags::kSbFileWrite,
+      &created, &error);
+  if (SbFileIsValid(file)) {
+    SbFileSeek(file, SbFileWhence::kSbFileFromEnd, 0);
+    SbFileWrite(file,
+                static_cast<const char*>(frame_buffers_[0]) +
+                    offset_in_frames * GetBytesPerFrame(),
+                frames_to_write * GetBytesPerFrame());
+    SbFileClose(file);
+  }
 #endif
-      }
+  return true;
+}
 
-      if (!is_playing || frames_in_buffer <= 0) {
-          SbThreadSleep(5 * kSbTimeMillisecond);
-      }
+GstBuffer* GStreamerAudioSink::WrapFrames(uint8_t* frames, int frame_count) {
+  // The renderer does not overwrite frames before they are reported as
+  // consumed, so the ring slice is handed to GStreamer as is and consumed
+  // once the last reference is dropped, i.e. when the audio sink has taken
+  // the samples. The consumed frames clock then follows what was actually
+  // queued for output instead of what was pushed into appsrc.
+  struct RingSlice {
+    GStreamerAudioSink* sink;
+    int frames;
+  };
+
+  {
+    ::starboard::ScopedLock lock(ring_mutex_);
+    frames_in_flight_ += frame_count;
+  }
+
+  size_t size = frame_count * GetBytesPerFrame();
+  RingSlice* slice = new RingSlice{this, frame_count};
+  return gst_buffer_new_wrapped_full(
+      GST_MEMORY_FLAG_READONLY, frames, size, 0, size, slice,
+      [](gpointer user_data) {
+        RingSlice* slice = static_cast<RingSlice*>(user_data);
+        GStreamerAudioSink* sink = slice->sink;
+        ::starboard::ScopedLock lock(sink->ring_mutex_);
+        if (!sink->detached_) {
+          sink->frames_in_flight_ -= slice->frames;
+          SbTime consumed_at = SbTimeGetMonotonicNow();
+          if (sink->low_latency_)
+            consumed_at +=
+                sink->device_latency_.load(std::memory_order_relaxed);
+          sink->consume_frame_func_(slice->frames, consumed_at,
+                                    sink->context_);
+        }
+        delete slice;
+      });
+}
+
+GstCaps* GStreamerAudioSink::QueryDeviceCaps() {
+  // autoaudiosink only picks and opens the device when going to READY.
+  if (gst_element_set_state(audiosink_, GST_STATE_READY) ==
+      GST_STATE_CHANGE_FAILURE) {
+    return nullptr;
+  }
+
+  GstCaps* device_caps = nullptr;
+  GstPad* pad = gst_element_get_static_pad(audiosink_, "sink");
+  if (pad) {
+    device_caps = gst_pad_query_caps(pad, nullptr);
+    GST_DEBUG_OBJECT(pipeline_, "Device caps %" GST_PTR_FORMAT, device_caps);
+    if (device_caps && gst_caps_is_any(device_caps)) {
+      gst_caps_unref(device_caps);
+      device_caps = nullptr;
+    }
+    gst_object_unref(pad);
+  }
+  return device_caps;
+}
+
+bool GStreamerAudioSink::SelectConverter(GstCaps* device_caps,
+                                         GstCaps** caps) {
+  // Keep as much of the stream as possible: the other sample type first,
+  // then a stereo downmix. Resampling is left to audioresample.
+  const SbMediaAudioSampleType other_type =
+      audio_sample_type_ == kSbMediaAudioSampleTypeFloat32
+          ? kSbMediaAudioSampleTypeInt16
+          : kSbMediaAudioSampleTypeFloat32;
+  const struct {
+    SbMediaAudioSampleType type;
+    int channels;
+  } candidates[] = {
+      {other_type, channels_},
+      {audio_sample_type_, 2},
+      {other_type, 2},
+  };
+
+  for (const auto& candidate : candidates) {
+    if (!PcmConverter::IsSupported(audio_sample_type_, channels_,
+                                   candidate.type, candidate.channels)) {
+      continue;
+    }
+    GstCaps* converted = CreateAudioCaps(candidate.type,
+                                         sampling_frequency_hz_,
+                                         candidate.channels);
+    if (gst_caps_can_intersect(converted, device_caps)) {
+      GST_INFO_OBJECT(pipeline_, "Converting in sink to %" GST_PTR_FORMAT,
+                      converted);
+      converter_.reset(new PcmConverter(audio_sample_type_, channels_,
+                                        candidate.type, candidate.channels));
+      gst_caps_unref(*caps);
+      *caps = converted;
+      return true;
     }
+    gst_caps_unref(converted);
   }
+  return false;
+}
+
+void GStreamerAudioSink::UpdateOutputLatency() {
+  // Latency as reported by the pipeline, which already covers the device
+  // ring buffer, plus what is waiting in the queue.
+  GstClockTime latency = 0;
+  GstQuery* query = gst_query_new_latency();
+  if (gst_element_query(pipeline_, query)) {
+    gboolean live = FALSE;
+    GstClockTime min_latency = 0, max_latency = 0;
+    gst_query_parse_latency(query, &live, &min_latency, &max_latency);
+    if (GST_CLOCK_TIME_IS_VALID(min_latency))
+      latency = min_latency;
+  }
+  gst_query_unref(query);
+
+  guint64 queued = 0;
+  g_object_get(queue_, "current-level-time", &queued, nullptr);
+  latency += queued;
+
+  GstClockTime device_latency = 0;
+  if (device_sink_) {
+    GstAudioRingBuffer* ring_buffer =
+        GST_AUDIO_BASE_SINK(device_sink_)->ringbuffer;
+    if (ring_buffer && gst_audio_ring_buffer_is_acquired(ring_buffer)) {
+      device_latency = gst_util_uint64_scale_int(
+          gst_audio_ring_buffer_delay(ring_buffer), GST_SECOND,
+          sampling_frequency_hz_);
+    }
+  }
+
+  SbTime output_latency = latency / GST_USECOND;
+  device_latency_.store(device_latency / GST_USECOND,
+                        std::memory_order_relaxed);
+  if (output_latency_.exchange(output_latency, std::memory_order_relaxed) !=
+      output_latency) {
+    GST_DEBUG_OBJECT(pipeline_, "Output latency %" GST_TIME_FORMAT
+                     " (device %" GST_TIME_FORMAT ")",
+                     GST_TIME_ARGS(latency), GST_TIME_ARGS(device_latency));
+  }
+  GetFeedStats()->RecordLatency(output_latency);
 }
 
 // static
@@ -473,19 +1441,17 @@ void GStreamerAudioSink::AutoAudioSinkChildAddedCallback(GstChildProxy* obj,
   SB_UNREFERENCED_PARAMETER(name);
   GStreamerAudioSink* sink = static_cast<GStreamerAudioSink*>(user_data);
   if (GST_IS_AUDIO_BASE_SINK(object)) {
-    static constexpr int kLatencyTimeValue = 50;
-    g_object_set(GST_AUDIO_BASE_SINK(object), "buffer-time",
-                 static_cast<gint64>(kLatencyTimeValue * kSbTimeMillisecond),
-                 nullptr);
-    g_object_set(sink->queue_, "min-threshold-time",
-                 kLatencyTimeValue * kSbTimeMillisecond *
-                     kSbTimeNanosecondsPerMicrosecond,
-                 nullptr);
+    sink->device_sink_ = GST_ELEMENT(object);
+    ConfigureDeviceSink(sink->device_sink_, sink->queue_, sink->low_latency_);
   }
 }
 
 }  // namespace
 
+void WriteStats(media::StatsWriter& writer) {
+  GetFeedStats()->WriteStats(writer);
+}
+
 SbAudioSink GStreamerAudioSinkType::Create(
     int channels,
     int sampling_frequency_hz,
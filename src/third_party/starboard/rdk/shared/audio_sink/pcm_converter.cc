@@ -0,0 +1,250 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/audio_sink/pcm_converter.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PCM_CONVERTER_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PCM_CONVERTER_SSE2 1
+#endif
+
+#include "starboard/common/log.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace audio_sink {
+namespace {
+
+constexpr float kS16Max = 32767.f;
+constexpr float kS16Scale = 1.f / 32768.f;
+
+// ITU-R BS.775 coefficients, scaled so that full scale inputs on every
+// channel cannot clip.
+constexpr float kMinus3dB = 0.70710678f;
+constexpr float kFrontGain = 1.f / (1.f + 2.f * kMinus3dB);
+constexpr float kSideGain = kMinus3dB / (1.f + 2.f * kMinus3dB);
+
+inline int16_t FloatToS16(float value) {
+  if (value >= 1.f)
+    return 32767;
+  if (value <= -1.f)
+    return -32768;
+  return static_cast<int16_t>(lrintf(value * kS16Max));
+}
+
+#if defined(PCM_CONVERTER_NEON) && !defined(__aarch64__)
+// ARMv7 NEON converts by truncation only, add 0.5 away from zero first to
+// round like lrintf() does (ties aside).
+inline int32x4_t RoundToS32(float32x4_t value) {
+  const uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(value),
+                                    vdupq_n_u32(0x80000000u));
+  const float32x4_t half = vreinterpretq_f32_u32(
+      vorrq_u32(sign, vreinterpretq_u32_f32(vdupq_n_f32(.5f))));
+  return vcvtq_s32_f32(vaddq_f32(value, half));
+}
+#endif
+
+size_t BytesPerSample(SbMediaAudioSampleType type) {
+  return type == kSbMediaAudioSampleTypeFloat32 ? sizeof(float)
+                                                : sizeof(int16_t);
+}
+
+}  // namespace
+
+void ConvertFloatToS16(const float* in, int16_t* out, size_t samples) {
+  size_t i = 0;
+#if defined(PCM_CONVERTER_NEON)
+  const float32x4_t min = vdupq_n_f32(-1.f);
+  const float32x4_t max = vdupq_n_f32(1.f);
+  for (; i + 8 <= samples; i += 8) {
+    float32x4_t a = vminq_f32(vmaxq_f32(vld1q_f32(in + i), min), max);
+    float32x4_t b = vminq_f32(vmaxq_f32(vld1q_f32(in + i + 4), min), max);
+#if defined(__aarch64__)
+    int32x4_t ia = vcvtnq_s32_f32(vmulq_n_f32(a, kS16Max));
+    int32x4_t ib = vcvtnq_s32_f32(vmulq_n_f32(b, kS16Max));
+#else
+    int32x4_t ia = RoundToS32(vmulq_n_f32(a, kS16Max));
+    int32x4_t ib = RoundToS32(vmulq_n_f32(b, kS16Max));
+#endif
+    vst1q_s16(out + i, vcombine_s16(vqmovn_s32(ia), vqmovn_s32(ib)));
+  }
+#elif defined(PCM_CONVERTER_SSE2)
+  const __m128 min = _mm_set1_ps(-1.f);
+  const __m128 max = _mm_set1_ps(1.f);
+  const __m128 scale = _mm_set1_ps(kS16Max);
+  for (; i + 8 <= samples; i += 8) {
+    __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), min), max);
+    __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), min), max);
+    __m128i ia = _mm_cvtps_epi32(_mm_mul_ps(a, scale));
+    __m128i ib = _mm_cvtps_epi32(_mm_mul_ps(b, scale));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_packs_epi32(ia, ib));
+  }
+#endif
+  for (; i < samples; ++i)
+    out[i] = FloatToS16(in[i]);
+}
+
+void ConvertS16ToFloat(const int16_t* in, float* out, size_t samples) {
+  size_t i = 0;
+#if defined(PCM_CONVERTER_NEON)
+  for (; i + 8 <= samples; i += 8) {
+    int16x8_t v = vld1q_s16(in + i);
+    vst1q_f32(out + i,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))),
+                          kS16Scale));
+    vst1q_f32(out + i + 4,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))),
+                          kS16Scale));
+  }
+#elif defined(PCM_CONVERTER_SSE2)
+  const __m128 scale = _mm_set1_ps(kS16Scale);
+  for (; i + 8 <= samples; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+#endif
+  for (; i < samples; ++i)
+    out[i] = in[i] * kS16Scale;
+}
+
+void DownmixFloat51ToStereo(const float* in, float* out, size_t frames) {
+  // Two frames per step: three vectors hold
+  //   FL0 FR0 FC0 LFE0 | RL0 RR0 FL1 FR1 | FC1 LFE1 RL1 RR1
+  // and are regrouped into front, center and rear pairs.
+  size_t f = 0;
+#if defined(PCM_CONVERTER_NEON)
+  for (; f + 2 <= frames; f += 2) {
+    const float* src = in + f * 6;
+    float32x4_t r0 = vld1q_f32(src);
+    float32x4_t r1 = vld1q_f32(src + 4);
+    float32x4_t r2 = vld1q_f32(src + 8);
+    float32x4_t front = vcombine_f32(vget_low_f32(r0), vget_high_f32(r1));
+    float32x4_t rear = vcombine_f32(vget_low_f32(r1), vget_high_f32(r2));
+    float32x4_t center = vcombine_f32(vdup_lane_f32(vget_high_f32(r0), 0),
+                                      vdup_lane_f32(vget_low_f32(r2), 0));
+    float32x4_t mix = vmulq_n_f32(front, kFrontGain);
+    mix = vmlaq_n_f32(mix, vaddq_f32(center, rear), kSideGain);
+    vst1q_f32(out + f * 2, mix);
+  }
+#elif defined(PCM_CONVERTER_SSE2)
+  const __m128 front_gain = _mm_set1_ps(kFrontGain);
+  const __m128 side_gain = _mm_set1_ps(kSideGain);
+  for (; f + 2 <= frames; f += 2) {
+    const float* src = in + f * 6;
+    __m128 r0 = _mm_loadu_ps(src);
+    __m128 r1 = _mm_loadu_ps(src + 4);
+    __m128 r2 = _mm_loadu_ps(src + 8);
+    __m128 front = _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(3, 2, 1, 0));
+    __m128 rear = _mm_shuffle_ps(r1, r2, _MM_SHUFFLE(3, 2, 1, 0));
+    __m128 center = _mm_shuffle_ps(r0, r2, _MM_SHUFFLE(0, 0, 2, 2));
+    __m128 mix = _mm_add_ps(_mm_mul_ps(front, front_gain),
+                            _mm_mul_ps(_mm_add_ps(center, rear), side_gain));
+    _mm_storeu_ps(out + f * 2, mix);
+  }
+#endif
+  for (; f < frames; ++f) {
+    const float* src = in + f * 6;
+    out[f * 2] = src[0] * kFrontGain + (src[2] + src[4]) * kSideGain;
+    out[f * 2 + 1] = src[1] * kFrontGain + (src[2] + src[5]) * kSideGain;
+  }
+}
+
+// static
+bool PcmConverter::IsSupported(SbMediaAudioSampleType in_type,
+                               int in_channels,
+                               SbMediaAudioSampleType out_type,
+                               int out_channels) {
+  if (in_channels == out_channels)
+    return in_type != out_type;
+  return in_channels == 6 && out_channels == 2;
+}
+
+PcmConverter::PcmConverter(SbMediaAudioSampleType in_type,
+                           int in_channels,
+                           SbMediaAudioSampleType out_type,
+                           int out_channels)
+    : in_type_(in_type),
+      in_channels_(in_channels),
+      out_type_(out_type),
+      out_channels_(out_channels) {
+  SB_DCHECK(IsSupported(in_type, in_channels, out_type, out_channels));
+}
+
+size_t PcmConverter::GetOutputBytesPerFrame() const {
+  return out_channels_ * BytesPerSample(out_type_);
+}
+
+void PcmConverter::Convert(const void* in, int frames, void* out) {
+  size_t in_samples = static_cast<size_t>(frames) * in_channels_;
+  size_t out_samples = static_cast<size_t>(frames) * out_channels_;
+
+  if (in_channels_ == out_channels_) {
+    if (in_type_ == out_type_) {
+      memcpy(out, in, in_samples * BytesPerSample(in_type_));
+    } else if (in_type_ == kSbMediaAudioSampleTypeFloat32) {
+      ConvertFloatToS16(static_cast<const float*>(in),
+                        static_cast<int16_t*>(out), in_samples);
+    } else {
+      ConvertS16ToFloat(static_cast<const int16_t*>(in),
+                        static_cast<float*>(out), in_samples);
+    }
+    return;
+  }
+
+  // The downmix runs on floats, integer input and output go through the
+  // scratch buffer.
+  size_t scratch_size = 0;
+  if (in_type_ != kSbMediaAudioSampleTypeFloat32)
+    scratch_size += in_samples;
+  if (out_type_ != kSbMediaAudioSampleTypeFloat32)
+    scratch_size += out_samples;
+  if (scratch_.size() < scratch_size)
+    scratch_.resize(scratch_size);
+
+  float* scratch = scratch_.data();
+  const float* src = static_cast<const float*>(in);
+  if (in_type_ != kSbMediaAudioSampleTypeFloat32) {
+    ConvertS16ToFloat(static_cast<const int16_t*>(in), scratch, in_samples);
+    src = scratch;
+    scratch += in_samples;
+  }
+
+  if (out_type_ == kSbMediaAudioSampleTypeFloat32) {
+    DownmixFloat51ToStereo(src, static_cast<float*>(out), frames);
+  } else {
+    DownmixFloat51ToStereo(src, scratch, frames);
+    ConvertFloatToS16(scratch, static_cast<int16_t*>(out), out_samples);
+  }
+}
+
+}  // namespace audio_sink
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,74 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_AUDIO_SINK_PCM_CONVERTER_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_AUDIO_SINK_PCM_CONVERTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "starboard/media.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace audio_sink {
+
+// Interleaved PCM kernels, NEON on ARM and SSE2 on x86 with a scalar tail
+// (and a scalar fallback everywhere else).
+void ConvertFloatToS16(const float* in, int16_t* out, size_t samples);
+void ConvertS16ToFloat(const int16_t* in, float* out, size_t samples);
+// 5.1 (FL FR FC LFE RL RR) to stereo, LFE dropped, normalized not to clip.
+void DownmixFloat51ToStereo(const float* in, float* out, size_t frames);
+
+// Converts the renderer's interleaved frames into a format the device sink
+// takes directly, so that no audioconvert element is needed. Supports sample
+// type changes between S16 and F32, optionally combined with a 5.1 to stereo
+// downmix.
+class PcmConverter {
+ public:
+  static bool IsSupported(SbMediaAudioSampleType in_type,
+                          int in_channels,
+                          SbMediaAudioSampleType out_type,
+                          int out_channels);
+
+  PcmConverter(SbMediaAudioSampleType in_type,
+               int in_channels,
+               SbMediaAudioSampleType out_type,
+               int out_channels);
+
+  size_t GetOutputBytesPerFrame() const;
+  void Convert(const void* in, int frames, void* out);
+
+ private:
+  SbMediaAudioSampleType in_type_;
+  int in_channels_;
+  SbMediaAudioSampleType out_type_;
+  int out_channels_;
+  std::vector<float> scratch_;
+};
+
+}  // namespace audio_sink
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_AUDIO_SINK_PCM_CONVERTER_H_
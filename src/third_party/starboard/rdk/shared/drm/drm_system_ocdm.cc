@@ -18,17 +18,21 @@
 #include "third_party/starboard/rdk/shared/drm/drm_system_ocdm.h"
 
 #include <dlfcn.h>
+#include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <cstring>
 #include <gst/gst.h>
 
 #include "starboard/memory.h"
+#include "starboard/once.h"
 #include "starboard/common/mutex.h"
 #include "starboard/shared/starboard/thread_checker.h"
 
 #include <opencdm/open_cdm.h>
 #include <opencdm/open_cdm_adapter.h>
 
+#include "third_party/starboard/rdk/shared/media/media_stats.h"
 #include "third_party/starboard/rdk/shared/log_override.h"
 
 namespace third_party {
@@ -36,6 +40,10 @@ namespace starboard {
 namespace rdk {
 namespace shared {
 namespace drm {
+
+// Implemented by the decryptor, which records the per stream metrics.
+void WriteDecryptorStats(media::StatsWriter& writer);
+
 namespace {
 
 static SbMutex g_session_dtor_mutex_ = SB_MUTEX_INITIALIZER;
@@ -57,6 +65,27 @@ using OcdmGstSessionDecryptExFn =
 
 static OcdmGstSessionDecryptExFn g_ocdmGstSessionDecryptEx { nullptr };
 
+void ResolveDecryptEx() {
+  static std::once_flag flag;
+  std::call_once(flag, [](){
+    g_ocdmGstSessionDecryptEx = (OcdmGstSessionDecryptExFn)dlsym(RTLD_DEFAULT, "opencdm_gstreamer_session_decrypt_ex");
+    if (g_ocdmGstSessionDecryptEx) {
+      SB_LOG(INFO) << "Has opencdm_gstreamer_session_decrypt_ex";
+    } else {
+      SB_LOG(INFO) << "No opencdm_gstreamer_session_decrypt_ex. Fallback to opencdm_gstreamer_session_decrypt.";
+    }
+  });
+}
+
+// Shared by all DRM systems, reported through mediastats.
+struct KeySessionCacheStats {
+  std::atomic<uint64_t> hits { 0 };
+  std::atomic<uint64_t> misses { 0 };
+  std::atomic<uint64_t> invalidations { 0 };
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(KeySessionCacheStats, GetKeySessionCacheStats);
+
 }  // namespace
 
 namespace session {
@@ -105,7 +134,11 @@ class Session {
 
   int Decrypt( _GstBuffer* buffer,
     _GstBuffer* sub_sample, uint32_t sub_sample_count,
-    _GstBuffer* iv, _GstBuffer* key, _GstCaps* caps);
+    _GstBuffer* iv, _GstBuffer* key,
+    SbDrmEncryptionScheme scheme, const SbDrmEncryptionPattern& pattern,
+    _GstCaps* caps);
+
+  DrmSystemOcdm::DecryptMetrics& Metrics() { return metrics_; }
 
   void DispatchPendingKeyUpdates();
  private:
@@ -158,6 +191,8 @@ class Session {
 
   std::vector<SbDrmKeyId> pending_key_updates_;
   bool all_keys_updated_ { false };
+
+  DrmSystemOcdm::DecryptMetrics metrics_;
 };
 
 Session::Session(
@@ -177,7 +212,8 @@ Session::Session(
       session_closed_callback_(session_closed_callback) {}
 
 Session::~Session() {
-  Close();
+  if (session_ || !id_.empty())
+    Close();
 }
 
 void Session::Close() {
@@ -194,10 +230,12 @@ void Session::Close() {
   }
 
   auto id = Id();
-  if (!id.empty())
+  if (!id.empty()) {
+    drm_system_->OnSessionClosed(id);
     session_closed_callback_(drm_system_, context_, id.c_str(), id.size());
-  else
+  } else {
     SB_LOG(WARNING) << "Closing ivalid session ?";
+  }
 
   {
     ::starboard::ScopedLock lock(mutex_);
@@ -297,6 +335,8 @@ int Session::Decrypt(
   uint32_t sub_sample_count,
   _GstBuffer* iv,
   _GstBuffer* key,
+  SbDrmEncryptionScheme scheme,
+  const SbDrmEncryptionPattern& pattern,
   _GstCaps* caps) {
 
   ::starboard::ScopedLock lock(close_mutex_);
@@ -304,6 +344,29 @@ int Session::Decrypt(
   if (!session)
     return ERROR_INVALID_SESSION;
 
+  if (scheme == kSbDrmEncryptionSchemeAesCbc) {
+    if (g_ocdmGstSessionDecryptEx == nullptr)
+      return ERROR_INTERFACE_NOT_IMPLEMENTED;
+
+    // The OpenCDM adapter takes the cipher mode and the pattern from the
+    // protection meta, the same fields qtdemux sets for cbcs samples.
+    GstProtectionMeta* meta = nullptr;
+    if (!gst_buffer_get_protection_meta(buffer)) {
+      meta = gst_buffer_add_protection_meta(buffer,
+        gst_structure_new("application/x-cbcs",
+                          "cipher-mode", G_TYPE_STRING, "cbcs",
+                          "crypt_byte_block", G_TYPE_UINT, pattern.crypt_byte_block,
+                          "skip_byte_block", G_TYPE_UINT, pattern.skip_byte_block,
+                          nullptr));
+    }
+    int rc = g_ocdmGstSessionDecryptEx(session, buffer,
+                                       sub_sample, sub_sample_count, iv,
+                                       key, 0, caps);
+    if (meta)
+      gst_buffer_remove_meta(buffer, reinterpret_cast<GstMeta*>(meta));
+    return rc;
+  }
+
   if (g_ocdmGstSessionDecryptEx != nullptr) {
     return g_ocdmGstSessionDecryptEx(session, buffer,
                                      sub_sample, sub_sample_count, iv,
@@ -497,6 +560,56 @@ void Session::OnError(struct OpenCDMSession* /*ocdm_session*/,
 
 using session::Session;
 
+constexpr int64_t DrmSystemOcdm::DecryptMetrics::kTimeBucketsUs[];
+
+// static
+void DrmSystemOcdm::DecryptMetrics::WriteTimeBuckets(
+    media::StatsWriter& writer) {
+  writer.BeginArray("timebucketsus");
+  for (int64_t bound : kTimeBucketsUs)
+    writer.Add(nullptr, bound);
+  writer.EndArray();
+}
+
+void DrmSystemOcdm::DecryptMetrics::AddDecrypt(SbTime duration,
+                                               size_t size,
+                                               bool failed) {
+  const auto relaxed = std::memory_order_relaxed;
+  int bucket = 0;
+  while (bucket < kTimeBucketCount - 1 && duration > kTimeBucketsUs[bucket])
+    ++bucket;
+  buffers.fetch_add(1, relaxed);
+  bytes.fetch_add(size, relaxed);
+  if (failed)
+    errors.fetch_add(1, relaxed);
+  total_us.fetch_add(duration, relaxed);
+  uint64_t max = max_us.load(relaxed);
+  while (static_cast<uint64_t>(duration) > max &&
+         !max_us.compare_exchange_weak(max, duration, relaxed)) {
+  }
+  time_hist[bucket].fetch_add(1, relaxed);
+}
+
+void DrmSystemOcdm::DecryptMetrics::AddKeyWait(SbTime duration) {
+  const auto relaxed = std::memory_order_relaxed;
+  key_waits.fetch_add(1, relaxed);
+  key_wait_us.fetch_add(duration, relaxed);
+}
+
+void DrmSystemOcdm::DecryptMetrics::Write(media::StatsWriter& writer) const {
+  writer.Add("buffers", buffers.load());
+  writer.Add("bytes", bytes.load());
+  writer.Add("errors", errors.load());
+  writer.Add("totalus", total_us.load());
+  writer.Add("maxus", max_us.load());
+  writer.BeginArray("timehist");
+  for (const auto& count : time_hist)
+    writer.Add(nullptr, count.load());
+  writer.EndArray();
+  writer.Add("keywaits", key_waits.load());
+  writer.Add("keywaitus", key_wait_us.load());
+}
+
 DrmSystemOcdm::DrmSystemOcdm(
     const char* key_system,
     void* context,
@@ -514,16 +627,7 @@ DrmSystemOcdm::DrmSystemOcdm(
       session_closed_callback_(session_closed_callback) {
   SB_LOG(INFO) << "Create DRM system ";
   ocdm_system_ = opencdm_create_system(key_system_.c_str());
-
-  static std::once_flag flag;
-  std::call_once(flag, [](){
-    g_ocdmGstSessionDecryptEx = (OcdmGstSessionDecryptExFn)dlsym(RTLD_DEFAULT, "opencdm_gstreamer_session_decrypt_ex");
-    if (g_ocdmGstSessionDecryptEx) {
-      SB_LOG(INFO) << "Has opencdm_gstreamer_session_decrypt_ex";
-    } else {
-      SB_LOG(INFO) << "No opencdm_gstreamer_session_decrypt_ex. Fallback to opencdm_gstreamer_session_decrypt.";
-    }
-  });
+  ResolveDecryptEx();
 }
 
 DrmSystemOcdm::~DrmSystemOcdm() {
@@ -532,6 +636,20 @@ DrmSystemOcdm::~DrmSystemOcdm() {
     if (event_id_ != kSbEventIdInvalid)
       SbEventCancel(event_id_);
   }
+
+  // Decryptors may still hold handles, close the sessions here so that none
+  // of them outlives the OpenCDM system or calls back into this object.
+  std::vector<SessionHandle> sessions;
+  {
+    ::starboard::ScopedLock lock(sessions_mutex_);
+    sessions.swap(sessions_);
+  }
+  for (auto& session : sessions) {
+    if (!session->Id().empty())
+      session->Close();
+  }
+  sessions.clear();
+
   opencdm_destruct_system(ocdm_system_);
 }
 
@@ -541,23 +659,38 @@ bool DrmSystemOcdm::IsKeySystemSupported(const char* key_system,
   return opencdm_is_type_supported(key_system, mime_type) == ERROR_NONE;
 }
 
+// static
+bool DrmSystemOcdm::IsEncryptionSchemeSupported(SbDrmEncryptionScheme scheme) {
+  switch (scheme) {
+    case kSbDrmEncryptionSchemeAesCtr:
+      return true;
+    case kSbDrmEncryptionSchemeAesCbc:
+      ResolveDecryptEx();
+      return g_ocdmGstSessionDecryptEx != nullptr;
+  }
+  return false;
+}
+
 void DrmSystemOcdm::GenerateSessionUpdateRequest(
     int ticket,
     const char* type,
     const void* initialization_data,
     int initialization_data_size) {
   SB_LOG(INFO) << "Generate challenge type: " << type;
-  std::unique_ptr<Session> session(
-      new Session(this, ocdm_system_, context_,
-                  session_update_request_callback_, session_updated_callback_,
-                  key_statuses_changed_callback_, session_closed_callback_));
+  SessionHandle session = std::make_shared<Session>(
+      this, ocdm_system_, context_, session_update_request_callback_,
+      session_updated_callback_, key_statuses_changed_callback_,
+      session_closed_callback_);
   session->GenerateChallenge(type, initialization_data,
                              initialization_data_size, ticket);
-  Session *session_ptr = session.get();
-  mutex_.Acquire();
-  sessions_.push_back(std::move(session));
-  mutex_.Release();
-  session_ptr->DispatchPendingKeyUpdates();
+  std::string id = session->Id();
+  {
+    ::starboard::ScopedLock lock(sessions_mutex_);
+    sessions_.push_back(session);
+    if (!id.empty())
+      sessions_by_id_[id] = session;
+  }
+  session->DispatchPendingKeyUpdates();
 }
 
 void DrmSystemOcdm::UpdateSession(int ticket,
@@ -567,7 +700,7 @@ void DrmSystemOcdm::UpdateSession(int ticket,
                                   int session_id_size) {
   std::string id = {static_cast<const char*>(session_id), session_id_size};
   SB_LOG(INFO) << "Update: " << id;
-  auto* session = GetSessionById(id);
+  SessionHandle session = GetSessionById(id);
   if (session)
     session->Update(key, key_size, ticket);
 }
@@ -575,7 +708,7 @@ void DrmSystemOcdm::UpdateSession(int ticket,
 void DrmSystemOcdm::CloseSession(const void* session_id, int session_id_size) {
   std::string id = {static_cast<const char*>(session_id), session_id_size};
   SB_LOG(INFO) << "Close: " << id;
-  auto* session = GetSessionById(id);
+  SessionHandle session = GetSessionById(id);
   if (session)
     session->Close();
 }
@@ -597,16 +730,11 @@ SbDrmSystemPrivate::DecryptStatus DrmSystemOcdm::Decrypt(InputBuffer* buffer) {
   return kFailure;
 }
 
-Session* DrmSystemOcdm::GetSessionById(const std::string& id) const {
-  ::starboard::ScopedLock lock(mutex_);
-  auto iter = std::find_if(
-      sessions_.begin(), sessions_.end(),
-      [&id](const std::unique_ptr<Session>& s) { return id == s->Id(); });
-
-  if (iter != sessions_.end())
-    return iter->get();
-
-  return nullptr;
+DrmSystemOcdm::SessionHandle DrmSystemOcdm::GetSessionById(
+    const std::string& id) const {
+  ::starboard::ScopedLock lock(sessions_mutex_);
+  auto iter = sessions_by_id_.find(id);
+  return iter != sessions_by_id_.end() ? iter->second : nullptr;
 }
 
 void DrmSystemOcdm::AddObserver(DrmSystemOcdm::Observer* obs) {
@@ -624,6 +752,21 @@ void DrmSystemOcdm::RemoveObserver(DrmSystemOcdm::Observer* obs) {
 void DrmSystemOcdm::OnKeyUpdated(const std::string& session_id,
                                  SbDrmKeyId&& key_id,
                                  SbDrmKeyStatus status) {
+  {
+    std::string key = {reinterpret_cast<const char*>(key_id.identifier),
+                       static_cast<size_t>(key_id.identifier_size)};
+    ::starboard::ScopedLock lock(key_session_mutex_);
+    if (status == kSbDrmKeyStatusUsable) {
+      key_session_ids_[key] = session_id;
+    } else {
+      auto entry = key_session_ids_.find(key);
+      if (entry != key_session_ids_.end() && entry->second == session_id) {
+        key_session_ids_.erase(entry);
+        ++GetKeySessionCacheStats()->invalidations;
+      }
+    }
+  }
+
   ::starboard::ScopedLock lock(mutex_);
   auto session_key = session_keys_.find(session_id);
   KeyWithStatus key_with_status;
@@ -698,8 +841,36 @@ void DrmSystemOcdm::AnnounceKeys() {
   event_id_ = kSbEventIdInvalid;
 }
 
+void DrmSystemOcdm::OnSessionClosed(const std::string& session_id) {
+  {
+    ::starboard::ScopedLock lock(sessions_mutex_);
+    sessions_by_id_.erase(session_id);
+  }
+
+  ::starboard::ScopedLock lock(key_session_mutex_);
+  for (auto it = key_session_ids_.begin(); it != key_session_ids_.end();) {
+    if (it->second == session_id) {
+      it = key_session_ids_.erase(it);
+      ++GetKeySessionCacheStats()->invalidations;
+    } else {
+      ++it;
+    }
+  }
+}
+
 std::string DrmSystemOcdm::SessionIdByKeyId(const uint8_t* key,
                                             uint8_t key_len) {
+  {
+    ::starboard::ScopedLock lock(key_session_mutex_);
+    auto entry = key_session_ids_.find(
+        std::string{reinterpret_cast<const char*>(key), key_len});
+    if (entry != key_session_ids_.end()) {
+      ++GetKeySessionCacheStats()->hits;
+      return entry->second;
+    }
+  }
+  ++GetKeySessionCacheStats()->misses;
+
   SbMutexAcquire(&g_session_dtor_mutex_);
   ScopedOcdmSession session{
       opencdm_get_system_session(ocdm_system_, key, key_len, 0)};
@@ -707,21 +878,76 @@ std::string DrmSystemOcdm::SessionIdByKeyId(const uint8_t* key,
   return session ? opencdm_session_id(session.get()) : std::string{};
 }
 
-int DrmSystemOcdm::Decrypt(const std::string& id,
+int DrmSystemOcdm::Decrypt(const SessionHandle& session,
                             _GstBuffer* buffer,
                             _GstBuffer* sub_sample,
                             uint32_t sub_sample_count,
                             _GstBuffer* iv,
                             _GstBuffer* key,
+                            SbDrmEncryptionScheme scheme,
+                            const SbDrmEncryptionPattern& pattern,
                             _GstCaps* caps) {
-  session::Session* session = GetSessionById(id);
   if (!session)
     return ERROR_INVALID_SESSION;
-  return session->Decrypt(buffer, sub_sample, sub_sample_count, iv, key, caps);
+  return session->Decrypt(buffer, sub_sample, sub_sample_count, iv, key,
+                          scheme, pattern, caps);
+}
+
+// static
+void DrmSystemOcdm::AddDecrypt(const SessionHandle& session,
+                               SbTime duration,
+                               size_t size,
+                               bool failed) {
+  if (session)
+    session->Metrics().AddDecrypt(duration, size, failed);
+}
+
+// static
+void DrmSystemOcdm::AddKeyWait(const SessionHandle& session, SbTime duration) {
+  if (session)
+    session->Metrics().AddKeyWait(duration);
 }
 
 const void* DrmSystemOcdm::GetMetrics(int* size) {
-    return nullptr;
+  std::vector<SessionHandle> sessions;
+  {
+    ::starboard::ScopedLock lock(sessions_mutex_);
+    sessions = sessions_;
+  }
+
+  media::StatsWriter writer;
+  writer.BeginObject();
+  writer.Add("keysystem", key_system_.c_str());
+  // The per stream counters of the decryptors, same as in mediastats.
+  WriteDecryptorStats(writer);
+  writer.BeginArray("sessions");
+  for (const auto& session : sessions) {
+    std::string id = session->Id();
+    if (id.empty())
+      continue;
+    writer.BeginObject();
+    writer.Add("id", id.c_str());
+    session->Metrics().Write(writer);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+
+  ::starboard::ScopedLock lock(metrics_mutex_);
+  metrics_ = writer.str();
+  *size = static_cast<int>(metrics_.size());
+  return metrics_.data();
+}
+
+void WriteDrmSystemStats(media::StatsWriter& writer) {
+  KeySessionCacheStats* stats = GetKeySessionCacheStats();
+  writer.BeginObject("drmsystem");
+  writer.BeginObject("keysessioncache");
+  writer.Add("hits", stats->hits.load());
+  writer.Add("misses", stats->misses.load());
+  writer.Add("invalidations", stats->invalidations.load());
+  writer.EndObject();
+  writer.EndObject();
 }
 
 }  // namespace drm
@@ -17,6 +17,7 @@
 #ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_DRM_DRM_SYSTEM_OCDM_H_
 #define THIRD_PARTY_STARBOARD_RDK_SHARED_DRM_DRM_SYSTEM_OCDM_H_
 
+#include <atomic>
 #include <memory>
 #include <set>
 #include <string>
@@ -26,6 +27,7 @@
 #include "starboard/common/mutex.h"
 #include "starboard/event.h"
 #include "starboard/shared/starboard/drm/drm_system_internal.h"
+#include "starboard/time.h"
 
 struct _GstCaps;
 struct _GstBuffer;
@@ -35,6 +37,10 @@ namespace third_party {
 namespace starboard {
 namespace rdk {
 namespace shared {
+namespace media {
+class StatsWriter;
+}  // namespace media
+
 namespace drm {
 
 namespace session {
@@ -56,6 +62,38 @@ class DrmSystemOcdm : public SbDrmSystemPrivate {
 
   using KeysWithStatus = std::vector<KeyWithStatus>;
 
+  // Keeps a session alive, e.g. in a decryptor which resolves it once per key
+  // instead of for every sample. Decrypting with a session that got closed in
+  // the meantime fails with ERROR_INVALID_SESSION.
+  using SessionHandle = std::shared_ptr<session::Session>;
+
+  // Decrypt counters of a stream or a session. Relaxed atomics, recording
+  // from the streaming threads takes no lock. Time buckets are labelled by
+  // their upper bound, the last one is open. The keys they are written
+  // under are listed at GetMetrics().
+  struct DecryptMetrics {
+    static constexpr int64_t kTimeBucketsUs[] = {
+        250, 500, 1000, 2000, 4000, 8000, 16000, 32000 };
+    static constexpr int kTimeBucketCount =
+        sizeof(kTimeBucketsUs) / sizeof(kTimeBucketsUs[0]) + 1;
+
+    static void WriteTimeBuckets(media::StatsWriter& writer);
+
+    void AddDecrypt(SbTime duration, size_t size, bool failed);
+    void AddKeyWait(SbTime duration);
+    // Writes the counters into the current object of |writer|.
+    void Write(media::StatsWriter& writer) const;
+
+    std::atomic<uint64_t> buffers { 0 };
+    std::atomic<uint64_t> bytes { 0 };
+    std::atomic<uint64_t> errors { 0 };
+    std::atomic<uint64_t> total_us { 0 };
+    std::atomic<uint64_t> max_us { 0 };
+    std::atomic<uint64_t> time_hist[kTimeBucketCount] {};
+    std::atomic<uint64_t> key_waits { 0 };
+    std::atomic<uint64_t> key_wait_us { 0 };
+  };
+
   DrmSystemOcdm(
       const char* key_system,
       void* context,
@@ -69,6 +107,9 @@ class DrmSystemOcdm : public SbDrmSystemPrivate {
 
   static bool IsKeySystemSupported(const char* key_system,
                                    const char* mime_type);
+  // cbcs needs opencdm_gstreamer_session_decrypt_ex(), which reads the
+  // cipher mode and pattern of a sample from its protection meta.
+  static bool IsEncryptionSchemeSupported(SbDrmEncryptionScheme scheme);
 
   // SbDrmSystemPrivate
   void GenerateSessionUpdateRequest(int ticket,
@@ -87,6 +128,19 @@ class DrmSystemOcdm : public SbDrmSystemPrivate {
                                const void* certificate,
                                int certificate_size) override;
 
+  // JSON decrypt metrics of the process per stream and of the open sessions
+  // of this system. The returned buffer stays valid until the next call.
+  // Keys, the "decryptor" object is also what mediastats reports:
+  //   keysystem      the key system
+  //   decryptor      timebucketsus  upper bounds of the time buckets, us
+  //                  depthbuckets   upper bounds of the look-ahead depth
+  //                                 buckets, in buffers
+  //                  audio, video   counters, plus depthhist (per depth
+  //                                 bucket) and maxdepth
+  //   sessions       array of { id, counters } for the open sessions
+  // Counters: buffers, bytes and errors of the decrypt calls, totalus and
+  // maxus of their time, timehist (per time bucket), keywaits and keywaitus
+  // spent blocked until the session of a key showed up.
   const void* GetMetrics(int* size) override;
 
   void AddObserver(Observer* obs);
@@ -95,26 +149,42 @@ class DrmSystemOcdm : public SbDrmSystemPrivate {
                     SbDrmKeyId&& key_id,
                     SbDrmKeyStatus status);
   void OnAllKeysUpdated();
+  void OnSessionClosed(const std::string& session_id);
+  // Served from a cache of the usable keys reported through OnKeyUpdated(),
+  // OpenCDM is only asked for unknown keys.
   std::string SessionIdByKeyId(const uint8_t* key, uint8_t key_len);
-  int  Decrypt(const std::string& id,
+  SessionHandle GetSessionById(const std::string& id) const;
+  int  Decrypt(const SessionHandle& session,
                _GstBuffer* buffer,
                _GstBuffer* sub_sample,
                uint32_t sub_sample_count,
                _GstBuffer* iv,
                _GstBuffer* key_id,
+               SbDrmEncryptionScheme scheme,
+               const SbDrmEncryptionPattern& pattern,
                _GstCaps* caps);
+  // Account a decrypt, timed by the decryptor, and the time it was blocked
+  // until the key of |session| became usable, to the session's metrics.
+  static void AddDecrypt(const SessionHandle& session,
+                         SbTime duration,
+                         size_t size,
+                         bool failed);
+  static void AddKeyWait(const SessionHandle& session, SbTime duration);
   std::set<std::string> GetReadyKeys() const;
   KeysWithStatus GetSessionKeys(const std::string& session_id) const;
 
  private:
-  session::Session* GetSessionById(const std::string& id) const;
   void AnnounceKeys();
 
   std::set<std::string> GetReadyKeysUnlocked() const;
 
   std::string key_system_;
   void* context_;
-  std::vector<std::unique_ptr<session::Session>> sessions_;
+  // Open sessions by id, guarded by |sessions_mutex_| only so that lookups
+  // do not wait for key status updates and observer notifications.
+  std::vector<SessionHandle> sessions_;
+  std::unordered_map<std::string, SessionHandle> sessions_by_id_;
+  ::starboard::Mutex sessions_mutex_;
 
   const SbDrmSessionUpdateRequestFunc session_update_request_callback_;
   const SbDrmSessionUpdatedFunc session_updated_callback_;
@@ -128,6 +198,15 @@ class DrmSystemOcdm : public SbDrmSystemPrivate {
   mutable std::set<std::string> cached_ready_keys_;
   SbEventId event_id_;
   ::starboard::Mutex mutex_;
+
+  // Key id to session id, kept apart from |mutex_| which is held while
+  // observers are notified.
+  std::unordered_map<std::string, std::string> key_session_ids_;
+  ::starboard::Mutex key_session_mutex_;
+
+  // Last GetMetrics() result.
+  ::starboard::Mutex metrics_mutex_;
+  std::string metrics_;
 };
 
 }  // namespace drm
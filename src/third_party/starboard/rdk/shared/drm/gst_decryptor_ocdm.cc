@@ -18,13 +18,21 @@
 
 #if defined(HAS_OCDM)
 #include "third_party/starboard/rdk/shared/drm/drm_system_ocdm.h"
+#include "third_party/starboard/rdk/shared/drm/gst_drm_meta.h"
+#include "third_party/starboard/rdk/shared/media/media_stats.h"
 
 #include "starboard/common/mutex.h"
 #include "starboard/common/condition_variable.h"
+#include "starboard/once.h"
+#include "starboard/thread.h"
 
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+
 #include <opencdm/open_cdm.h>
 
 namespace third_party {
@@ -35,6 +43,70 @@ namespace drm {
 
 namespace {
 
+// Decrypt metrics and look-ahead depth of all decryptors, per media type,
+// reported through mediastats. Depth buckets are labelled by their upper
+// bound, the last one is open.
+const guint kLookaheadDepthBuckets[] = { 0, 1, 3, 7, 15, 31, 63 };
+const int kLookaheadDepthBucketCount = G_N_ELEMENTS(kLookaheadDepthBuckets) + 1;
+
+class DecryptStats {
+ public:
+  void Record(bool is_video, SbTime duration, gsize size, bool failed, bool has_depth, guint depth) {
+    Stream& stream = streams_[is_video ? 1 : 0];
+    stream.metrics.AddDecrypt(duration, size, failed);
+    if (!has_depth)
+      return;
+
+    int depth_bucket = 0;
+    while (depth_bucket < kLookaheadDepthBucketCount - 1 &&
+           depth > kLookaheadDepthBuckets[depth_bucket])
+      ++depth_bucket;
+    stream.depth_hist[depth_bucket].fetch_add(1, std::memory_order_relaxed);
+    guint max_depth = stream.max_depth.load(std::memory_order_relaxed);
+    while (depth > max_depth &&
+           !stream.max_depth.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {
+    }
+  }
+
+  void RecordKeyWait(bool is_video, SbTime duration) {
+    streams_[is_video ? 1 : 0].metrics.AddKeyWait(duration);
+  }
+
+  void Write(media::StatsWriter& writer) {
+    writer.BeginObject("decryptor");
+    DrmSystemOcdm::DecryptMetrics::WriteTimeBuckets(writer);
+    writer.BeginArray("depthbuckets");
+    for (guint bound : kLookaheadDepthBuckets)
+      writer.Add(nullptr, bound);
+    writer.EndArray();
+    WriteStream("audio", streams_[0], writer);
+    WriteStream("video", streams_[1], writer);
+    writer.EndObject();
+  }
+
+ private:
+  struct Stream {
+    DrmSystemOcdm::DecryptMetrics metrics;
+    std::atomic<uint64_t> depth_hist[kLookaheadDepthBucketCount] {};
+    std::atomic<guint> max_depth { 0 };
+  };
+
+  static void WriteStream(const char* name, const Stream& stream, media::StatsWriter& writer) {
+    writer.BeginObject(name);
+    stream.metrics.Write(writer);
+    writer.BeginArray("depthhist");
+    for (const auto& count : stream.depth_hist)
+      writer.Add(nullptr, count.load());
+    writer.EndArray();
+    writer.Add("maxdepth", stream.max_depth.load());
+    writer.EndObject();
+  }
+
+  Stream streams_[2];
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(DecryptStats, GetDecryptStats);
+
 G_BEGIN_DECLS
 
 #define COBALT_OCDM_DECRYPTOR_TYPE          (cobalt_ocdm_decryptor_get_type())
@@ -76,14 +148,6 @@ GST_DEBUG_CATEGORY(cobalt_ocdm_decryptor_debug_category);
 #define GST_CAT_DEFAULT cobalt_ocdm_decryptor_debug_category
 
 struct _CobaltOcdmDecryptorPrivate : public DrmSystemOcdm::Observer {
-  _CobaltOcdmDecryptorPrivate() {
-#ifndef GST_DISABLE_GST_DEBUG
-    if (gst_debug_category_get_threshold(GST_CAT_DEFAULT) >= GST_LEVEL_DEBUG) {
-      decrypt_dur_.reserve( 300 );
-    }
-#endif
-  }
-
   ~_CobaltOcdmDecryptorPrivate() {
     if (drm_system_)
       drm_system_->RemoveObserver(this);
@@ -95,6 +159,11 @@ struct _CobaltOcdmDecryptorPrivate : public DrmSystemOcdm::Observer {
       gst_caps_unref(cached_caps_);
       cached_caps_ = nullptr;
     }
+    if (lookahead_queue_) {
+      gst_object_unref(lookahead_queue_);
+      lookahead_queue_ = nullptr;
+    }
+    ClearAsyncQueueLocked();
   }
 
   // DrmSystemOcdm::Observer
@@ -115,9 +184,8 @@ struct _CobaltOcdmDecryptorPrivate : public DrmSystemOcdm::Observer {
   GstFlowReturn Decrypt(
     CobaltOcdmDecryptor* self, GstBuffer* buffer,
     GstBuffer* subsamples, uint32_t subsample_count,
-    GstBuffer* iv, GstBuffer* key) {
-
-    gint64 start = 0;
+    GstBuffer* iv, GstBuffer* key,
+    SbDrmEncryptionScheme scheme, const SbDrmEncryptionPattern& pattern) {
 
 #ifndef GST_DISABLE_GST_DEBUG
     const GstDebugLevel debug_level = gst_debug_category_get_threshold(GST_CAT_DEFAULT);
@@ -131,8 +199,11 @@ struct _CobaltOcdmDecryptorPrivate : public DrmSystemOcdm::Observer {
       }
 
       GST_TRACE_OBJECT(self, "buf=(%" GST_PTR_FORMAT "), "
-                       "subsample_count=%u, subsamples=(%p), iv=(%p), key=(%p : %s)",
-                       buffer, subsample_count, subsamples, iv, key, md5sum);
+                       "subsample_count=%u, subsamples=(%p), iv=(%p), key=(%p : %s), "
+                       "scheme=%s, pattern=%u:%u",
+                       buffer, subsample_count, subsamples, iv, key, md5sum,
+                       scheme == kSbDrmEncryptionSchemeAesCbc ? "cbcs" : "cenc",
+                       pattern.crypt_byte_block, pattern.skip_byte_block);
 
       g_free(md5sum);
     }
@@ -151,8 +222,15 @@ struct _CobaltOcdmDecryptorPrivate : public DrmSystemOcdm::Observer {
       }
     }
 
+    // Before waiting for a key, which is accounted to the stream.
+    if ( !cached_caps_ )
+      UpdateCachedCaps(self);
+
+    gint64 key_wait_start = 0;
     GstMapInfo map_info;
-    if (FALSE == gst_buffer_map(key, &map_info, GST_MAP_READ)) {
+    if (key == current_key_id_) {
+      // Same (interned) key id as the previous sample, nothing to resolve.
+    } else if (FALSE == gst_buffer_map(key, &map_info, GST_MAP_READ)) {
       GST_ELEMENT_ERROR (self, STREAM, DECRYPT, ("Failed to map kid buffer"), (NULL));
       return GST_FLOW_NOT_SUPPORTED;
     } else {
@@ -163,20 +241,21 @@ struct _CobaltOcdmDecryptorPrivate : public DrmSystemOcdm::Observer {
           g_free(md5sum);
         }
         ::starboard::ScopedLock lock(mutex_);
-        current_session_id_.clear();
-        if (current_key_id_) {
-          gst_buffer_unref(current_key_id_);
-          current_key_id_ = nullptr;
-        }
+        ResetCurrentKeyLocked();
         while(true) {
           if (is_flushing_ || is_active_ == false)
             break;
           current_session_id_ = drm_system_->SessionIdByKeyId(map_info.data, map_info.size);
           if (!current_session_id_.empty()) {
-            current_key_id_ = gst_buffer_copy(key);
+            // Resolved once per key, samples are decrypted through the handle
+            // without going through the DRM system's session table.
+            current_session_ = drm_system_->GetSessionById(current_session_id_);
+            current_key_id_ = gst_buffer_ref(key);
             break;
           }
           GST_DEBUG_OBJECT(self, "Session id is empty, waiting");
+          if (!key_wait_start)
+            key_wait_start = g_get_monotonic_time();
           awaiting_key_info_ = &map_info;
           condition_.Wait();
           awaiting_key_info_ = nullptr;
@@ -190,6 +269,12 @@ struct _CobaltOcdmDecryptorPrivate : public DrmSystemOcdm::Observer {
       gst_buffer_unmap(key, &map_info);
     }
 
+    if ( key_wait_start ) {
+      gint64 key_wait_us = g_get_monotonic_time() - key_wait_start;
+      DrmSystemOcdm::AddKeyWait(current_session_, key_wait_us);
+      GetDecryptStats()->RecordKeyWait(IsVideo(), key_wait_us);
+    }
+
     if ( current_session_id_.empty() ) {
       if ( is_flushing_ ) {
         GST_DEBUG_OBJECT(self, "flushing");
@@ -205,33 +290,37 @@ struct _CobaltOcdmDecryptorPrivate : public DrmSystemOcdm::Observer {
 
     GstCaps *caps = nullptr;
     gst_caps_replace(&caps, cached_caps_);
-    if ( !caps ) {
-      GstPad* sink_pad = gst_element_get_static_pad(GST_ELEMENT(self), "sink");
-      caps = gst_pad_get_current_caps(sink_pad);
-      gst_object_unref(sink_pad);
-      GST_DEBUG_OBJECT(self, "using new caps for decrypt = %" GST_PTR_FORMAT, caps);
-      SetCachedCaps( caps );
-    }
 
-#ifndef GST_DISABLE_GST_DEBUG
-    if ( debug_level >= GST_LEVEL_DEBUG ) {
-      start = g_get_monotonic_time();
-    }
-#endif
+    gint64 start = g_get_monotonic_time();
 
     int rc = drm_system_->Decrypt(
-      current_session_id_, buffer,
+      current_session_, buffer,
       subsamples, subsample_count,
-      iv, key, caps);
+      iv, key, scheme, pattern, caps);
+
+    gint64 dur_us = g_get_monotonic_time() - start;
 
     if ( caps ) {
       gst_caps_unref(caps);
       caps = nullptr;
     }
 
+    // Buffers already decrypted ahead of the decoder. Zero means the decoder
+    // drained the look-ahead and waits on decryption.
+    guint depth = 0;
+    if (lookahead_queue_)
+      g_object_get(lookahead_queue_, "current-level-buffers", &depth, nullptr);
+    gsize size = gst_buffer_get_size(buffer);
+    DrmSystemOcdm::AddDecrypt(current_session_, dur_us, size, rc != 0);
+    GetDecryptStats()->Record(
+      IsVideo(), dur_us, size, rc != 0, lookahead_queue_ != nullptr, depth);
+
     if ( rc != 0 ) {
       if ( rc == ERROR_INVALID_SESSION ) {
         GST_DEBUG_OBJECT(self, "Invalid session. Probably due to player shutdown.");
+        // The session got closed, look the key up again for the next sample.
+        ::starboard::ScopedLock lock(mutex_);
+        ResetCurrentKeyLocked();
         return GST_BASE_TRANSFORM_FLOW_DROPPED;
       }
 
@@ -239,42 +328,6 @@ struct _CobaltOcdmDecryptorPrivate : public DrmSystemOcdm::Observer {
       return GST_FLOW_ERROR;
     }
 
-    if ( start ) {
-      gint64 dur_ms = (g_get_monotonic_time() - start) / 1000;
-
-      decrypt_dur_.push_back(dur_ms);
-      total_time_ += dur_ms;
-      total_size_ += gst_buffer_get_size(buffer);
-
-      ++buf_count_;
-
-      if ( buf_count_ == 300 ) {
-        std::sort(decrypt_dur_.begin(), decrypt_dur_.end());
-
-        uint64_t median     = decrypt_dur_[ decrypt_dur_.size() / 2 ];
-        uint64_t max_time   = *decrypt_dur_.rbegin();
-        uint64_t total_time = total_time_; total_time_ = 0;
-        uint64_t total_size = total_size_; total_size_ = 0;
-        uint32_t buf_count  = buf_count_; buf_count_ = 0;
-
-        decrypt_dur_.resize(0);
-
-        GST_DEBUG_OBJECT(self,
-          "%s decrypt time: "
-          "avg = %" G_GUINT64_FORMAT " ms, "
-          "median = %" G_GUINT64_FORMAT " ms, "
-          "max = %" G_GUINT64_FORMAT " ms, "
-          "size = %" G_GUINT64_FORMAT " kb, "
-          "buf count = %u",
-          IsVideo() ? "video" : "audio",
-          (total_time / buf_count),
-          median,
-          max_time,
-          (total_size / 1024),
-          buf_count);
-      }
-    }
-
     return GST_FLOW_OK;
   }
 
@@ -288,14 +341,113 @@ struct _CobaltOcdmDecryptorPrivate : public DrmSystemOcdm::Observer {
 
   void SetIsFlushing(bool is_flushing) {
     ::starboard::ScopedLock lock(mutex_);
+    if (is_flushing) {
+      ClearAsyncQueueLocked();
+    } else {
+      // The worker's push fails once downstream flushes. Wait for it, so
+      // that nothing from before the flush goes out after FLUSH_STOP.
+      while (async_busy_)
+        async_condition_.Wait();
+      async_flow_ = GST_FLOW_OK;
+    }
     is_flushing_ = is_flushing;
     condition_.Signal();
+    async_condition_.Broadcast();
   }
 
   void SetActive(bool is_active) {
     ::starboard::ScopedLock lock(mutex_);
     is_active_ = is_active;
     condition_.Signal();
+    async_condition_.Broadcast();
+  }
+
+  void SetAsyncBuffers(int buffers) { async_buffers_ = buffers; }
+
+  bool IsAsync() const { return SbThreadIsValid(async_thread_); }
+
+  void StartAsync(CobaltOcdmDecryptor* self, void* (*entry_point)(void*)) {
+    if (async_buffers_ <= 0 || SbThreadIsValid(async_thread_))
+      return;
+    {
+      ::starboard::ScopedLock lock(mutex_);
+      async_stopping_ = false;
+      async_flow_ = GST_FLOW_OK;
+    }
+    async_thread_ = SbThreadCreate(0, kSbThreadNoPriority, kSbThreadNoAffinity, true,
+                                   "ocdm_decrypt", entry_point, self);
+    if (!SbThreadIsValid(async_thread_))
+      GST_WARNING_OBJECT(self, "Failed to start decrypt worker, decrypting in place");
+  }
+
+  void StopAsync() {
+    if (!SbThreadIsValid(async_thread_))
+      return;
+    {
+      ::starboard::ScopedLock lock(mutex_);
+      async_stopping_ = true;
+      ClearAsyncQueueLocked();
+      async_condition_.Broadcast();
+    }
+    SbThreadJoin(async_thread_, nullptr);
+    async_thread_ = kSbThreadInvalid;
+  }
+
+  // Streaming thread: queues |buffer| for the worker, waits while the queue
+  // is full. Returns the flow of the worker's last failed push, if any.
+  GstFlowReturn EnqueueAsync(GstBuffer* buffer) {
+    ::starboard::ScopedLock lock(mutex_);
+    while (static_cast<int>(async_queue_.size()) >= async_buffers_ &&
+           !is_flushing_ && is_active_ && async_flow_ == GST_FLOW_OK)
+      async_condition_.Wait();
+    GstFlowReturn ret = async_flow_;
+    if (is_flushing_ || !is_active_)
+      ret = GST_FLOW_FLUSHING;
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref(buffer);
+      return ret;
+    }
+    async_queue_.push_back(buffer);
+    async_condition_.Broadcast();
+    return GST_FLOW_OK;
+  }
+
+  // Streaming thread: waits until the worker pushed everything queued, so
+  // that serialized events and queries keep their place in the stream.
+  void DrainAsync() {
+    if (!IsAsync())
+      return;
+    ::starboard::ScopedLock lock(mutex_);
+    while ((!async_queue_.empty() || async_busy_) && !is_flushing_ && is_active_)
+      async_condition_.Wait();
+  }
+
+  // Worker: the next buffer to decrypt and push, null when stopping. What
+  // is left queued behind a failed push is dropped.
+  GstBuffer* TakeAsyncBuffer() {
+    ::starboard::ScopedLock lock(mutex_);
+    for (;;) {
+      while (!async_stopping_ && async_queue_.empty())
+        async_condition_.Wait();
+      if (async_stopping_)
+        return nullptr;
+      GstBuffer* buffer = async_queue_.front();
+      async_queue_.pop_front();
+      async_condition_.Broadcast();
+      if (async_flow_ == GST_FLOW_OK) {
+        async_busy_ = true;
+        return buffer;
+      }
+      gst_buffer_unref(buffer);
+    }
+  }
+
+  void FinishAsyncBuffer(GstFlowReturn ret) {
+    ::starboard::ScopedLock lock(mutex_);
+    async_busy_ = false;
+    if (ret != GST_FLOW_OK && async_flow_ == GST_FLOW_OK)
+      async_flow_ = ret;
+    async_condition_.Broadcast();
   }
 
   void SetCachedCaps(GstCaps* caps) {
@@ -313,7 +465,36 @@ struct _CobaltOcdmDecryptorPrivate : public DrmSystemOcdm::Observer {
 
   bool IsVideo() const { return is_video_; }
 
+  void SetLookaheadQueue(GstElement* queue) {
+    gst_object_replace(reinterpret_cast<GstObject**>(&lookahead_queue_), GST_OBJECT(queue));
+  }
+
 private:
+  void UpdateCachedCaps(CobaltOcdmDecryptor* self) {
+    GstPad* sink_pad = gst_element_get_static_pad(GST_ELEMENT(self), "sink");
+    GstCaps* caps = gst_pad_get_current_caps(sink_pad);
+    gst_object_unref(sink_pad);
+    GST_DEBUG_OBJECT(self, "using new caps for decrypt = %" GST_PTR_FORMAT, caps);
+    SetCachedCaps( caps );
+    if ( caps )
+      gst_caps_unref(caps);
+  }
+
+  void ClearAsyncQueueLocked() {
+    for (GstBuffer* buffer : async_queue_)
+      gst_buffer_unref(buffer);
+    async_queue_.clear();
+  }
+
+  void ResetCurrentKeyLocked() {
+    current_session_id_.clear();
+    current_session_.reset();
+    if (current_key_id_) {
+      gst_buffer_unref(current_key_id_);
+      current_key_id_ = nullptr;
+    }
+  }
+
   ::starboard::Mutex mutex_;
   ::starboard::ConditionVariable condition_ { mutex_ };
 
@@ -321,16 +502,23 @@ private:
   GstMapInfo* awaiting_key_info_ { nullptr };
   GstBuffer*  current_key_id_ { nullptr };
   std::string current_session_id_;
+  DrmSystemOcdm::SessionHandle current_session_;
+  GstElement* lookahead_queue_ { nullptr };
 
   DrmSystemOcdm* drm_system_ { nullptr };
   bool is_flushing_ { false };
   bool is_active_ { true };
   bool is_video_ { false };
 
-  std::vector<uint64_t> decrypt_dur_;
-  uint64_t total_time_ { 0 };
-  uint64_t total_size_ { 0 };
-  uint32_t buf_count_ { 0 };
+  // Optional decrypt worker, guarded by |mutex_| except for the thread
+  // handle, which only start() and stop() touch.
+  ::starboard::ConditionVariable async_condition_ { mutex_ };
+  std::deque<GstBuffer*> async_queue_;
+  SbThread async_thread_ { kSbThreadInvalid };
+  int async_buffers_ { 0 };
+  bool async_busy_ { false };
+  bool async_stopping_ { false };
+  GstFlowReturn async_flow_ { GST_FLOW_OK };
 };
 
 #define cobalt_ocdm_decryptor_parent_class parent_class
@@ -339,7 +527,10 @@ G_DEFINE_TYPE_WITH_PRIVATE(CobaltOcdmDecryptor, cobalt_ocdm_decryptor, GST_TYPE_
 static void cobalt_ocdm_decryptor_finalize(GObject*);
 static GstCaps* cobalt_ocdm_decryptor_transform_caps(GstBaseTransform*, GstPadDirection, GstCaps*, GstCaps*);
 static GstFlowReturn cobalt_ocdm_decryptor_transform_ip(GstBaseTransform* base, GstBuffer* buffer);
+static GstFlowReturn cobalt_ocdm_decryptor_submit_input_buffer(GstBaseTransform* base, gboolean is_discont, GstBuffer* buffer);
+static void* cobalt_ocdm_decryptor_async_loop(void* context);
 static gboolean cobalt_ocdm_decryptor_sink_event(GstBaseTransform* base, GstEvent* event);
+static gboolean cobalt_ocdm_decryptor_query(GstBaseTransform* base, GstPadDirection direction, GstQuery* query);
 static gboolean cobalt_ocdm_decryptor_stop(GstBaseTransform *base);
 static gboolean cobalt_ocdm_decryptor_start(GstBaseTransform *base);
 static void cobalt_ocdm_decryptor_set_context(GstElement* element, GstContext* context);
@@ -368,7 +559,9 @@ static void cobalt_ocdm_decryptor_class_init(CobaltOcdmDecryptorClass* klass) {
   base_transform_class->transform_caps = GST_DEBUG_FUNCPTR(cobalt_ocdm_decryptor_transform_caps);
   base_transform_class->transform_ip = GST_DEBUG_FUNCPTR(cobalt_ocdm_decryptor_transform_ip);
   base_transform_class->transform_ip_on_passthrough = FALSE;
+  base_transform_class->submit_input_buffer = GST_DEBUG_FUNCPTR(cobalt_ocdm_decryptor_submit_input_buffer);
   base_transform_class->sink_event = GST_DEBUG_FUNCPTR(cobalt_ocdm_decryptor_sink_event);
+  base_transform_class->query = GST_DEBUG_FUNCPTR(cobalt_ocdm_decryptor_query);
   base_transform_class->start = GST_DEBUG_FUNCPTR(cobalt_ocdm_decryptor_start);
   base_transform_class->stop = GST_DEBUG_FUNCPTR(cobalt_ocdm_decryptor_stop);
 }
@@ -417,6 +610,23 @@ static GstFlowReturn cobalt_ocdm_decryptor_transform_ip(GstBaseTransform* base,
 
   GST_TRACE_OBJECT(self, "Transform in place buf=(%" GST_PTR_FORMAT ")", buffer);
 
+  DrmMeta* drm_meta = GetDrmMeta(buffer);
+  if (drm_meta) {
+    GstFlowReturn ret = GST_FLOW_NOT_SUPPORTED;
+    if (!DrmSystemOcdm::IsEncryptionSchemeSupported(drm_meta->encryption_scheme)) {
+      GST_ELEMENT_ERROR (self, STREAM, DECRYPT, ("Decryption failed"), ("Unsupported encryption scheme = %d", drm_meta->encryption_scheme));
+    } else if (!drm_meta->key_id || !drm_meta->iv) {
+      GST_ELEMENT_ERROR (self, STREAM, DECRYPT_NOKEY, ("No key ID available for encrypted sample"), (NULL));
+    } else {
+      ret = priv->Decrypt(self, buffer, drm_meta->subsamples, drm_meta->subsample_count, drm_meta->iv, drm_meta->key_id,
+                          drm_meta->encryption_scheme, drm_meta->encryption_pattern);
+      GST_TRACE_OBJECT(self, "ret=%s", gst_flow_get_name(ret));
+    }
+    gst_buffer_remove_meta(buffer, reinterpret_cast<GstMeta*>(drm_meta));
+    return ret;
+  }
+
+  // Samples not produced by cobaltsrc may still carry the generic protection meta.
   GstProtectionMeta* protection_meta = reinterpret_cast<GstProtectionMeta*>(gst_buffer_get_protection_meta(buffer));
   if (!protection_meta) {
     GST_TRACE_OBJECT(self, "Clear sample");
@@ -430,14 +640,40 @@ static GstFlowReturn cobalt_ocdm_decryptor_transform_ip(GstBaseTransform* base,
   GstBuffer* key = nullptr;
   uint32_t subsample_count = 0u;
   uint32_t encryption_scheme = kSbDrmEncryptionSchemeAesCtr;
+  SbDrmEncryptionPattern encryption_pattern = {0, 0};
+  const gchar* cipher_mode = nullptr;
 
   const GValue* value = nullptr;
 
-  if ( gst_structure_get_uint(info, "encryption_scheme", &encryption_scheme) ) {
-    if (encryption_scheme != kSbDrmEncryptionSchemeAesCtr) {
-      GST_ELEMENT_ERROR (self, STREAM, DECRYPT, ("Decryption failed"), ("Unsupported encryption scheme = %d", encryption_scheme));
+  // Either the scheme of the Cobalt sample or, as set by qtdemux, the
+  // "cipher-mode" of the track ("cenc" or "cbcs").
+  cipher_mode = gst_structure_get_string(info, "cipher-mode");
+  if (cipher_mode) {
+    if (g_str_equal(cipher_mode, "cbcs")) {
+      encryption_scheme = kSbDrmEncryptionSchemeAesCbc;
+    } else if (!g_str_equal(cipher_mode, "cenc")) {
+      GST_ELEMENT_ERROR (self, STREAM, DECRYPT, ("Decryption failed"), ("Unsupported cipher mode = %s", cipher_mode));
       goto exit;
     }
+  } else {
+    gst_structure_get_uint(info, "encryption_scheme", &encryption_scheme);
+  }
+  if (!DrmSystemOcdm::IsEncryptionSchemeSupported(static_cast<SbDrmEncryptionScheme>(encryption_scheme))) {
+    GST_ELEMENT_ERROR (self, STREAM, DECRYPT, ("Decryption failed"), ("Unsupported encryption scheme = %d", encryption_scheme));
+    goto exit;
+  }
+
+  if (encryption_scheme == kSbDrmEncryptionSchemeAesCbc) {
+    gst_structure_get_uint(info, "crypt_byte_block", &encryption_pattern.crypt_byte_block);
+    gst_structure_get_uint(info, "skip_byte_block", &encryption_pattern.skip_byte_block);
+    // The OpenCDM adapter only looks at the cipher mode.
+    if (!cipher_mode) {
+      gst_structure_set(info,
+                        "cipher-mode", G_TYPE_STRING, "cbcs",
+                        "crypt_byte_block", G_TYPE_UINT, encryption_pattern.crypt_byte_block,
+                        "skip_byte_block", G_TYPE_UINT, encryption_pattern.skip_byte_block,
+                        nullptr);
+    }
   }
 
   value = gst_structure_get_value(info, "kid");
@@ -448,6 +684,9 @@ static GstFlowReturn cobalt_ocdm_decryptor_transform_ip(GstBaseTransform* base,
   key = gst_value_get_buffer(value);
 
   value = gst_structure_get_value(info, "iv");
+  // cbcs tracks usually carry a constant IV instead of a per-sample one.
+  if (!value && encryption_scheme == kSbDrmEncryptionSchemeAesCbc)
+    value = gst_structure_get_value(info, "constant_iv");
   if (!value) {
     GST_ELEMENT_ERROR (self, STREAM, DECRYPT_NOKEY, ("Failed to get IV buffer"), (NULL));
     goto exit;
@@ -468,7 +707,8 @@ static GstFlowReturn cobalt_ocdm_decryptor_transform_ip(GstBaseTransform* base,
     subsamples = gst_value_get_buffer(value);
   }
 
-  ret = priv->Decrypt(self, buffer, subsamples, subsample_count, iv, key);
+  ret = priv->Decrypt(self, buffer, subsamples, subsample_count, iv, key,
+                      static_cast<SbDrmEncryptionScheme>(encryption_scheme), encryption_pattern);
 
   GST_TRACE_OBJECT(self, "ret=%s", gst_flow_get_name(ret));
 
@@ -477,6 +717,43 @@ exit:
   return ret;
 }
 
+static GstFlowReturn cobalt_ocdm_decryptor_submit_input_buffer(GstBaseTransform* base, gboolean is_discont, GstBuffer* buffer) {
+  CobaltOcdmDecryptor* self = COBALT_OCDM_DECRYPTOR(base);
+  CobaltOcdmDecryptorPrivate* priv = reinterpret_cast<CobaltOcdmDecryptorPrivate*>(
+    cobalt_ocdm_decryptor_get_instance_private(self));
+
+  GstFlowReturn ret = GST_BASE_TRANSFORM_CLASS(parent_class)->submit_input_buffer(base, is_discont, buffer);
+  if (ret != GST_FLOW_OK || !priv->IsAsync() || !base->queued_buf)
+    return ret;
+
+  // Negotiated and past QoS, the worker takes it from here. Nothing is left
+  // queued, so generate_output() has nothing to push on this thread.
+  GstBuffer* queued = base->queued_buf;
+  base->queued_buf = nullptr;
+  return priv->EnqueueAsync(queued);
+}
+
+static void* cobalt_ocdm_decryptor_async_loop(void* context) {
+  CobaltOcdmDecryptor* self = COBALT_OCDM_DECRYPTOR(context);
+  CobaltOcdmDecryptorPrivate* priv = reinterpret_cast<CobaltOcdmDecryptorPrivate*>(
+    cobalt_ocdm_decryptor_get_instance_private(self));
+  GstBaseTransform* base = GST_BASE_TRANSFORM(self);
+
+  while (GstBuffer* buffer = priv->TakeAsyncBuffer()) {
+    buffer = gst_buffer_make_writable(buffer);
+    GstFlowReturn ret = cobalt_ocdm_decryptor_transform_ip(base, buffer);
+    if (ret == GST_FLOW_OK) {
+      ret = gst_pad_push(GST_BASE_TRANSFORM_SRC_PAD(base), buffer);
+    } else {
+      gst_buffer_unref(buffer);
+      if (ret == GST_BASE_TRANSFORM_FLOW_DROPPED)
+        ret = GST_FLOW_OK;
+    }
+    priv->FinishAsyncBuffer(ret);
+  }
+  return nullptr;
+}
+
 static void cobalt_ocdm_decryptor_set_context(GstElement* element, GstContext* context) {
   CobaltOcdmDecryptor* self = COBALT_OCDM_DECRYPTOR(element);
   CobaltOcdmDecryptorPrivate* priv = reinterpret_cast<CobaltOcdmDecryptorPrivate*>(
@@ -530,6 +807,9 @@ static gboolean cobalt_ocdm_decryptor_sink_event(GstBaseTransform* base, GstEven
       priv->SetIsFlushing(false);
       break;
     default:
+        // Keeps the event behind the samples queued for the worker.
+        if (GST_EVENT_IS_SERIALIZED(event))
+          priv->DrainAsync();
         break;
     }
   }
@@ -537,11 +817,23 @@ static gboolean cobalt_ocdm_decryptor_sink_event(GstBaseTransform* base, GstEven
   return GST_BASE_TRANSFORM_CLASS(parent_class)->sink_event(base, event);
 }
 
+static gboolean cobalt_ocdm_decryptor_query(GstBaseTransform* base, GstPadDirection direction, GstQuery* query) {
+  CobaltOcdmDecryptor* self = COBALT_OCDM_DECRYPTOR(base);
+  CobaltOcdmDecryptorPrivate* priv = reinterpret_cast<CobaltOcdmDecryptorPrivate*>(
+    cobalt_ocdm_decryptor_get_instance_private(self));
+
+  if (direction == GST_PAD_SINK && GST_QUERY_IS_SERIALIZED(query))
+    priv->DrainAsync();
+
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->query(base, direction, query);
+}
+
 static gboolean cobalt_ocdm_decryptor_stop(GstBaseTransform *base) {
   CobaltOcdmDecryptor* self = COBALT_OCDM_DECRYPTOR(base);
   CobaltOcdmDecryptorPrivate* priv = reinterpret_cast<CobaltOcdmDecryptorPrivate*>(
     cobalt_ocdm_decryptor_get_instance_private(self));
   priv->SetActive(false);
+  priv->StopAsync();
   return TRUE;
 }
 
@@ -550,6 +842,7 @@ static gboolean cobalt_ocdm_decryptor_start(GstBaseTransform *base) {
   CobaltOcdmDecryptorPrivate* priv = reinterpret_cast<CobaltOcdmDecryptorPrivate*>(
     cobalt_ocdm_decryptor_get_instance_private(self));
   priv->SetActive(true);
+  priv->StartAsync(self, &cobalt_ocdm_decryptor_async_loop);
   return TRUE;
 }
 
@@ -559,6 +852,26 @@ GstElement *CreateDecryptorElement(const gchar* name) {
   return GST_ELEMENT ( g_object_new (COBALT_OCDM_DECRYPTOR_TYPE, name) );
 }
 
+bool IsDecryptorElement(GstElement* element) {
+  return G_TYPE_CHECK_INSTANCE_TYPE(element, COBALT_OCDM_DECRYPTOR_TYPE);
+}
+
+void SetDecryptorLookaheadQueue(GstElement* decryptor, GstElement* queue) {
+  CobaltOcdmDecryptorPrivate* priv = reinterpret_cast<CobaltOcdmDecryptorPrivate*>(
+    cobalt_ocdm_decryptor_get_instance_private(COBALT_OCDM_DECRYPTOR(decryptor)));
+  priv->SetLookaheadQueue(queue);
+}
+
+void SetDecryptorAsyncBuffers(GstElement* decryptor, int buffers) {
+  CobaltOcdmDecryptorPrivate* priv = reinterpret_cast<CobaltOcdmDecryptorPrivate*>(
+    cobalt_ocdm_decryptor_get_instance_private(COBALT_OCDM_DECRYPTOR(decryptor)));
+  priv->SetAsyncBuffers(buffers);
+}
+
+void WriteDecryptorStats(media::StatsWriter& writer) {
+  GetDecryptStats()->Write(writer);
+}
+
 }  // namespace drm
 }  // namespace shared
 }  // namespace rdk
@@ -577,6 +890,16 @@ GstElement *CreateDecryptorElement(const gchar* name) {
   return nullptr;
 }
 
+bool IsDecryptorElement(GstElement* element) {
+  return false;
+}
+
+void SetDecryptorLookaheadQueue(GstElement* decryptor, GstElement* queue) {
+}
+
+void SetDecryptorAsyncBuffers(GstElement* decryptor, int buffers) {
+}
+
 }  // namespace drm
 }  // namespace shared
 }  // namespace rdk
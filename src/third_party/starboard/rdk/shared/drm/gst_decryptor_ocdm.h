@@ -26,6 +26,14 @@ namespace shared {
 namespace drm {
 
 GstElement *CreateDecryptorElement(const gchar* name);
+bool IsDecryptorElement(GstElement* element);
+// |queue| buffers decrypted samples ahead of the decoder, its level is
+// sampled for the look-ahead depth histogram of the decrypt stats.
+void SetDecryptorLookaheadQueue(GstElement* decryptor, GstElement* queue);
+// Decrypts on a worker thread of the element, with up to |buffers| samples
+// queued in front of it in order. 0 decrypts on the streaming thread. Takes
+// effect when the element starts.
+void SetDecryptorAsyncBuffers(GstElement* decryptor, int buffers);
 
 }  // namespace drm
 }  // namespace shared
@@ -0,0 +1,277 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#include "third_party/starboard/rdk/shared/drm/gst_drm_meta.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "starboard/common/log.h"
+#include "starboard/common/mutex.h"
+#include "starboard/once.h"
+#include "third_party/starboard/rdk/shared/media/media_stats.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace drm {
+namespace {
+
+GST_DEBUG_CATEGORY(cobalt_gst_drm_meta_debug);
+#define GST_CAT_DEFAULT cobalt_gst_drm_meta_debug
+
+const int kMaxIvSize = 16;
+const gsize kSubsampleEntrySize = sizeof(guint16) + sizeof(guint32);
+// Subsample maps up to this size are taken from the pool, bigger ones are
+// allocated.
+const gsize kMaxPooledSubsamplesSize = 32 * kSubsampleEntrySize;
+const guint kMaxPooledBuffers = 256;
+// Number of key ids kept interned, a stream rarely uses more than a couple.
+const size_t kMaxKeyIds = 16;
+
+gboolean DrmMetaInit(GstMeta* meta, gpointer params, GstBuffer* buffer) {
+  DrmMeta* drm_meta = reinterpret_cast<DrmMeta*>(meta);
+  drm_meta->key_id = nullptr;
+  drm_meta->iv = nullptr;
+  drm_meta->subsamples = nullptr;
+  drm_meta->subsample_count = 0;
+  drm_meta->encryption_scheme = kSbDrmEncryptionSchemeAesCtr;
+  drm_meta->encryption_pattern = {0, 0};
+  return TRUE;
+}
+
+void DrmMetaFree(GstMeta* meta, GstBuffer* buffer) {
+  DrmMeta* drm_meta = reinterpret_cast<DrmMeta*>(meta);
+  if (drm_meta->key_id)
+    gst_buffer_unref(drm_meta->key_id);
+  if (drm_meta->iv)
+    gst_buffer_unref(drm_meta->iv);
+  if (drm_meta->subsamples)
+    gst_buffer_unref(drm_meta->subsamples);
+}
+
+gboolean DrmMetaTransform(GstBuffer* dest, GstMeta* meta, GstBuffer* buffer,
+                          GQuark type, gpointer data) {
+  if (!GST_META_TRANSFORM_IS_COPY(type))
+    return FALSE;
+
+  // Same as GstProtectionMeta, only copy if the complete data is copied.
+  GstMetaTransformCopy* copy = static_cast<GstMetaTransformCopy*>(data);
+  if (copy->region)
+    return FALSE;
+
+  DrmMeta* src_meta = reinterpret_cast<DrmMeta*>(meta);
+  DrmMeta* dest_meta = reinterpret_cast<DrmMeta*>(
+      gst_buffer_add_meta(dest, DrmMetaGetInfo(), nullptr));
+  if (!dest_meta)
+    return FALSE;
+
+  dest_meta->key_id = src_meta->key_id ? gst_buffer_ref(src_meta->key_id) : nullptr;
+  dest_meta->iv = src_meta->iv ? gst_buffer_ref(src_meta->iv) : nullptr;
+  dest_meta->subsamples = src_meta->subsamples ? gst_buffer_ref(src_meta->subsamples) : nullptr;
+  dest_meta->subsample_count = src_meta->subsample_count;
+  dest_meta->encryption_scheme = src_meta->encryption_scheme;
+  dest_meta->encryption_pattern = src_meta->encryption_pattern;
+  return TRUE;
+}
+
+class DrmMetaBuilder {
+ public:
+  DrmMetaBuilder() {
+    GST_DEBUG_CATEGORY_INIT(cobalt_gst_drm_meta_debug, "gstdrmmeta", 0,
+                            "Cobalt DRM meta");
+    iv_pool_ = CreatePool(kMaxIvSize);
+    subsamples_pool_ = CreatePool(kMaxPooledSubsamplesSize);
+  }
+
+  ~DrmMetaBuilder() {
+    for (GstBuffer* key_id : key_ids_)
+      gst_buffer_unref(key_id);
+    for (GstBufferPool* pool : { iv_pool_, subsamples_pool_ }) {
+      gst_buffer_pool_set_active(pool, FALSE);
+      gst_object_unref(pool);
+    }
+  }
+
+  DrmMeta* Add(GstBuffer* buffer, const SbDrmSampleInfo& drm_info) {
+    DrmMeta* meta = reinterpret_cast<DrmMeta*>(
+        gst_buffer_add_meta(buffer, DrmMetaGetInfo(), nullptr));
+    if (!meta)
+      return nullptr;
+
+    ++metas_;
+    meta->encryption_scheme = drm_info.encryption_scheme;
+    meta->encryption_pattern = drm_info.encryption_pattern;
+    meta->key_id = InternKeyId(drm_info.identifier, drm_info.identifier_size);
+
+    // A CTR IV is an 8-byte counter block prefix padded to 16 bytes, while
+    // a CBC IV is used as is, trailing zeros included.
+    int iv_size = drm_info.initialization_vector_size;
+    if (iv_size == kMaxIvSize &&
+        drm_info.encryption_scheme == kSbDrmEncryptionSchemeAesCtr) {
+      static const uint8_t kEmptyArray[kMaxIvSize / 2] = {0};
+      if (memcmp(drm_info.initialization_vector + kMaxIvSize / 2,
+                 kEmptyArray, kMaxIvSize / 2) == 0) {
+        iv_size /= 2;
+      }
+    }
+    meta->iv = Acquire(iv_pool_, kMaxIvSize, iv_size);
+    gst_buffer_fill(meta->iv, 0, drm_info.initialization_vector, iv_size);
+
+    meta->subsample_count = drm_info.subsample_count;
+    if (drm_info.subsample_count) {
+      gsize size = drm_info.subsample_count * kSubsampleEntrySize;
+      meta->subsamples = Acquire(subsamples_pool_, kMaxPooledSubsamplesSize, size);
+      GstMapInfo map_info;
+      if (gst_buffer_map(meta->subsamples, &map_info, GST_MAP_WRITE)) {
+        guint8* data = map_info.data;
+        for (uint32_t i = 0; i < drm_info.subsample_count; ++i) {
+          const SbDrmSubSampleMapping& mapping = drm_info.subsample_mapping[i];
+          GST_WRITE_UINT16_BE(data, mapping.clear_byte_count);
+          GST_WRITE_UINT32_BE(data + sizeof(guint16), mapping.encrypted_byte_count);
+          data += kSubsampleEntrySize;
+        }
+        gst_buffer_unmap(meta->subsamples, &map_info);
+      } else {
+        GST_ERROR("Failed to map subsamples buffer");
+      }
+    }
+    return meta;
+  }
+
+  void WriteStats(media::StatsWriter& writer) const {
+    writer.BeginObject("drmmeta");
+    writer.Add("metas", metas_.load());
+    writer.Add("keyidhits", key_id_hits_.load());
+    writer.Add("keyidmisses", key_id_misses_.load());
+    writer.Add("poolhits", pool_hits_.load());
+    writer.Add("poolmisses", pool_misses_.load());
+    writer.EndObject();
+  }
+
+ private:
+  static GstBufferPool* CreatePool(gsize size) {
+    GstBufferPool* pool = gst_buffer_pool_new();
+    GstStructure* config = gst_buffer_pool_get_config(pool);
+    gst_buffer_pool_config_set_params(config, nullptr, size, 0, kMaxPooledBuffers);
+    if (!gst_buffer_pool_set_config(pool, config) ||
+        !gst_buffer_pool_set_active(pool, TRUE)) {
+      GST_WARNING("Failed to configure %" G_GSIZE_FORMAT " bytes pool", size);
+    }
+    return pool;
+  }
+
+  // Returns a writable buffer of exactly |size| bytes.
+  GstBuffer* Acquire(GstBufferPool* pool, gsize pool_size, gsize size) {
+    GstBuffer* buffer = nullptr;
+    if (size <= pool_size) {
+      GstBufferPoolAcquireParams params = {};
+      params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+      if (gst_buffer_pool_acquire_buffer(pool, &buffer, &params) == GST_FLOW_OK) {
+        ++pool_hits_;
+        gst_buffer_resize(buffer, 0, size);
+        return buffer;
+      }
+    }
+    ++pool_misses_;
+    return gst_buffer_new_allocate(nullptr, size, nullptr);
+  }
+
+  GstBuffer* InternKeyId(const uint8_t* key_id, int size) {
+    ::starboard::ScopedLock lock(mutex_);
+    for (auto it = key_ids_.begin(); it != key_ids_.end(); ++it) {
+      GstBuffer* interned = *it;
+      if (gst_buffer_get_size(interned) == static_cast<gsize>(size) &&
+          gst_buffer_memcmp(interned, 0, key_id, size) == 0) {
+        ++key_id_hits_;
+        // Keep the most recently used keys in front.
+        if (it != key_ids_.begin())
+          std::rotate(key_ids_.begin(), it, it + 1);
+        return gst_buffer_ref(interned);
+      }
+    }
+
+    ++key_id_misses_;
+    GstBuffer* interned = gst_buffer_new_allocate(nullptr, size, nullptr);
+    gst_buffer_fill(interned, 0, key_id, size);
+    if (key_ids_.size() == kMaxKeyIds) {
+      gst_buffer_unref(key_ids_.back());
+      key_ids_.pop_back();
+    }
+    key_ids_.insert(key_ids_.begin(), interned);
+    GST_DEBUG("Interned key id %p (%zu key ids)", interned, key_ids_.size());
+    return gst_buffer_ref(interned);
+  }
+
+  ::starboard::Mutex mutex_;
+  std::vector<GstBuffer*> key_ids_;
+  GstBufferPool* iv_pool_ { nullptr };
+  GstBufferPool* subsamples_pool_ { nullptr };
+
+  std::atomic<uint64_t> metas_ { 0 };
+  std::atomic<uint64_t> key_id_hits_ { 0 };
+  std::atomic<uint64_t> key_id_misses_ { 0 };
+  std::atomic<uint64_t> pool_hits_ { 0 };
+  std::atomic<uint64_t> pool_misses_ { 0 };
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(DrmMetaBuilder, GetDrmMetaBuilder);
+
+}  // namespace
+
+GType DrmMetaApiGetType() {
+  static gsize type = 0;
+  static const gchar* tags[] = { nullptr };
+  if (g_once_init_enter(&type)) {
+    GType api = gst_meta_api_type_register("CobaltDrmMetaAPI", tags);
+    g_once_init_leave(&type, api);
+  }
+  return static_cast<GType>(type);
+}
+
+const GstMetaInfo* DrmMetaGetInfo() {
+  static const GstMetaInfo* meta_info = nullptr;
+  if (g_once_init_enter(&meta_info)) {
+    const GstMetaInfo* info = gst_meta_register(
+        DrmMetaApiGetType(), "CobaltDrmMeta", sizeof(DrmMeta),
+        DrmMetaInit, DrmMetaFree, DrmMetaTransform);
+    g_once_init_leave(&meta_info, info);
+  }
+  return meta_info;
+}
+
+DrmMeta* AddDrmMeta(GstBuffer* buffer, const SbDrmSampleInfo& drm_info) {
+  return GetDrmMetaBuilder()->Add(buffer, drm_info);
+}
+
+DrmMeta* GetDrmMeta(GstBuffer* buffer) {
+  return reinterpret_cast<DrmMeta*>(
+      gst_buffer_get_meta(buffer, DrmMetaApiGetType()));
+}
+
+void WriteDrmMetaStats(media::StatsWriter& writer) {
+  GetDrmMetaBuilder()->WriteStats(writer);
+}
+
+}  // namespace drm
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,71 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_DRM_GST_DRM_META_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_DRM_GST_DRM_META_H_
+
+#include <gst/gst.h>
+
+#include "starboard/drm.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+class StatsWriter;
+}  // namespace media
+
+namespace drm {
+
+// Decryption parameters of an encrypted sample. This is a typed replacement of
+// the "application/x-cenc" GstProtectionMeta, the decryptor reads the fields
+// directly instead of looking them up in a GstStructure.
+//
+// |key_id| buffers are interned (samples using the same key share a single
+// buffer, so the pointer may be compared instead of the contents), |iv| and
+// |subsamples| come from buffer pools. All of them are read-only.
+struct DrmMeta {
+  GstMeta meta;
+
+  GstBuffer* key_id;
+  GstBuffer* iv;
+  // |subsample_count| entries of big endian (uint16 clear, uint32 encrypted)
+  // byte counts, as expected by OpenCDM. Null if there are no subsamples.
+  GstBuffer* subsamples;
+  uint32_t subsample_count;
+  SbDrmEncryptionScheme encryption_scheme;
+  // Crypt and skip 16-byte blocks of cbcs, zero for full-sample encryption.
+  SbDrmEncryptionPattern encryption_pattern;
+};
+
+GType DrmMetaApiGetType();
+const GstMetaInfo* DrmMetaGetInfo();
+
+// Attaches |drm_info| to |buffer|.
+DrmMeta* AddDrmMeta(GstBuffer* buffer, const SbDrmSampleInfo& drm_info);
+
+DrmMeta* GetDrmMeta(GstBuffer* buffer);
+
+void WriteDrmMetaStats(media::StatsWriter& writer);
+
+}  // namespace drm
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_DRM_GST_DRM_META_H_
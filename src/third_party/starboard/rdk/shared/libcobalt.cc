@@ -28,6 +28,7 @@
 
 #include "third_party/starboard/rdk/shared/rdkservices.h"
 #include "third_party/starboard/rdk/shared/application_rdk.h"
+#include "third_party/starboard/rdk/shared/media/media_stats.h"
 
 using namespace third_party::starboard::rdk::shared;
 
@@ -329,6 +330,9 @@ int SbRdkGetSetting(const char* key, char** out_json) {
   else if (strcmp(key, "advertisingid") == 0) {
     result = AdvertisingId::GetSettings(tmp);
   }
+  else if (strcmp(key, "mediastats") == 0) {
+    result = media::GetMediaStats(tmp);
+  }
 
   if (result && !tmp.empty()) {
     char *out = (char*)malloc(tmp.size() + 1);
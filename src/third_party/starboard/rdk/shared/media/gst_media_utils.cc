@@ -14,8 +14,14 @@
 // limitations under the License.
 //
 // SPDX-License-Identifier: Apache-2.0
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <map>
+#include <sstream>
 #include <type_traits>
 
 #include <glib.h>
@@ -24,7 +30,13 @@
 
 #include "starboard/configuration.h"
 #include "starboard/configuration_constants.h"
+#include "starboard/common/file.h"
 #include "starboard/common/log.h"
+#include "starboard/common/mutex.h"
+#include "starboard/once.h"
+#include "starboard/system.h"
+#include "starboard/thread.h"
+#include "starboard/time.h"
 #include "third_party/starboard/rdk/shared/media/gst_media_utils.h"
 #include "third_party/starboard/rdk/shared/log_override.h"
 
@@ -129,17 +141,222 @@ bool GstRegistryHasElementForCodecImpl(C codec) {
   return false;
 }
 
+// Hash of everything that can change what the registry answers: the
+// GStreamer version, every plugin's name, version and file, and rank
+// overrides from the environment.
+std::string ComputeRegistryFingerprint() {
+  std::vector<std::string> plugins;
+  GList* list = gst_registry_get_plugin_list(gst_registry_get());
+  for (GList* iter = list; iter; iter = iter->next) {
+    GstPlugin* plugin = static_cast<GstPlugin*>(iter->data);
+    std::string entry = gst_plugin_get_name(plugin);
+    entry += ' ';
+    entry += gst_plugin_get_version(plugin);
+    const gchar* filename = gst_plugin_get_filename(plugin);
+    if (filename) {
+      struct stat st;
+      entry += ' ';
+      entry += filename;
+      if (stat(filename, &st) == 0) {
+        entry += ' ' + std::to_string(st.st_size);
+        entry += ' ' + std::to_string(st.st_mtime);
+      }
+    }
+    plugins.push_back(std::move(entry));
+  }
+  gst_plugin_list_free(list);
+  std::sort(plugins.begin(), plugins.end());
+
+  guint major, minor, micro, nano;
+  gst_version(&major, &minor, &micro, &nano);
+  const char* ranks = getenv("GST_PLUGIN_FEATURE_RANK");
+  plugins.push_back(std::to_string(major) + '.' + std::to_string(minor) + '.' +
+                    std::to_string(micro) + '.' + std::to_string(nano));
+  plugins.push_back(ranks ? ranks : "");
+
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (const auto& entry : plugins) {
+    for (unsigned char c : entry) {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+    hash ^= '\n';
+    hash *= 1099511628211ULL;
+  }
+
+  char buffer[17];
+  snprintf(buffer, sizeof(buffer), "%016llx",
+           static_cast<unsigned long long>(hash));
+  return buffer;
+}
+
+// Memoized capability probes, shared by all threads. Registry based answers
+// are persisted in the cache directory and reused by later runs as long as
+// the registry fingerprint matches; other answers (e.g. OCDM key systems)
+// only live as long as the process.
+class CapabilityCache {
+ public:
+  bool Lookup(const std::string& key, bool* supported) {
+    ::starboard::ScopedLock lock(mutex_);
+    LoadLocked();
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+      return false;
+    *supported = it->second.supported;
+    return true;
+  }
+
+  void Store(const std::string& key, bool supported, bool persist) {
+    ::starboard::ScopedLock lock(mutex_);
+    LoadLocked();
+    entries_[key] = {supported, persist};
+    if (persist)
+      dirty_ = true;
+  }
+
+  void Save() {
+    ::starboard::ScopedLock lock(mutex_);
+    if (!dirty_ || path_.empty())
+      return;
+
+    std::string content = fingerprint_ + '\n';
+    for (const auto& entry : entries_) {
+      if (entry.second.persist)
+        content += entry.first + ' ' + (entry.second.supported ? '1' : '0') + '\n';
+    }
+
+    std::string tmp_path = path_ + ".tmp";
+    {
+      ::starboard::ScopedFile file(tmp_path.c_str(),
+                                   kSbFileCreateAlways | kSbFileWrite);
+      if (!file.IsValid() ||
+          file.WriteAll(content.data(), content.size()) !=
+              static_cast<int>(content.size())) {
+        SB_LOG(WARNING) << "Failed to write " << tmp_path;
+        return;
+      }
+    }
+    if (rename(tmp_path.c_str(), path_.c_str()) != 0) {
+      SB_LOG(WARNING) << "Failed to replace " << path_;
+      return;
+    }
+    dirty_ = false;
+  }
+
+ private:
+  struct Entry {
+    bool supported;
+    bool persist;
+  };
+
+  void LoadLocked() {
+    if (loaded_)
+      return;
+    loaded_ = true;
+
+    fingerprint_ = ComputeRegistryFingerprint();
+
+    static const bool kDisablePersistence =
+        !!getenv("COBALT_DISABLE_CODEC_CACHE");
+    std::vector<char> path(kSbFileMaxPath);
+    if (kDisablePersistence ||
+        !SbSystemGetPath(kSbSystemPathCacheDirectory, path.data(),
+                         kSbFileMaxPath)) {
+      return;
+    }
+    path_ = std::string(path.data()) + "/codec_capabilities";
+
+    ::starboard::ScopedFile file(path_.c_str(), kSbFileOpenOnly | kSbFileRead);
+    if (!file.IsValid())
+      return;
+    const int kMaxSize = 16 * 1024;
+    std::vector<char> buffer(kMaxSize);
+    int size = file.ReadAll(buffer.data(), kMaxSize);
+    if (size <= 0)
+      return;
+
+    std::istringstream content(std::string(buffer.data(), size));
+    std::string line;
+    if (!std::getline(content, line) || line != fingerprint_) {
+      SB_LOG(INFO) << "GStreamer registry changed, dropping " << path_;
+      dirty_ = true;
+      return;
+    }
+    while (std::getline(content, line)) {
+      size_t space = line.rfind(' ');
+      if (space == std::string::npos || space + 2 != line.size())
+        continue;
+      entries_[line.substr(0, space)] = {line[space + 1] == '1', true};
+    }
+    SB_LOG(INFO) << "Loaded " << entries_.size() << " codec capabilities from "
+                 << path_;
+  }
+
+  ::starboard::Mutex mutex_;
+  bool loaded_ { false };
+  bool dirty_ { false };
+  std::string fingerprint_;
+  std::string path_;
+  std::map<std::string, Entry> entries_;
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(CapabilityCache, GetCapabilityCache);
+
 template <typename C>
-bool GstRegistryHasElementForCodec(C codec) {
-  static std::map<C, bool> cache;
-  auto it = cache.find(codec);
-  if (it != cache.end())
-    return it->second;
-  bool r = GstRegistryHasElementForCodecImpl(codec);
-  cache[codec] = r;
+std::string CodecCapabilityKey(C codec) {
+  return (std::is_same<C, SbMediaVideoCodec>::value ? "video/" : "audio/") +
+         std::to_string(static_cast<int>(codec));
+}
+
+template <typename C>
+bool GstRegistryHasElementForCodec(C codec, bool save = true) {
+  std::string key = CodecCapabilityKey(codec);
+  bool r = false;
+  if (GetCapabilityCache()->Lookup(key, &r))
+    return r;
+  // Probing is slow but idempotent, so it runs unlocked; a concurrent probe
+  // of the same codec just stores the same answer twice.
+  r = GstRegistryHasElementForCodecImpl(codec);
+  GetCapabilityCache()->Store(key, r, true);
+  if (save)
+    GetCapabilityCache()->Save();
   return r;
 }
 
+// Joined on teardown, the probes must not outlive GStreamer.
+SbThread g_prewarm_thread = kSbThreadInvalid;
+std::atomic<bool> g_prewarm_cancelled { false };
+
+void* PrewarmThreadEntryPoint(void*) {
+  const SbMediaVideoCodec video_codecs[] = {
+      kSbMediaVideoCodecH264, kSbMediaVideoCodecH265, kSbMediaVideoCodecMpeg2,
+      kSbMediaVideoCodecTheora, kSbMediaVideoCodecVc1, kSbMediaVideoCodecAv1,
+      kSbMediaVideoCodecVp8, kSbMediaVideoCodecVp9,
+  };
+  const SbMediaAudioCodec audio_codecs[] = {
+      kSbMediaAudioCodecAac, kSbMediaAudioCodecAc3, kSbMediaAudioCodecEac3,
+      kSbMediaAudioCodecOpus, kSbMediaAudioCodecVorbis,
+  };
+
+  SbTime started_at = SbTimeGetMonotonicNow();
+  for (auto codec : video_codecs) {
+    if (g_prewarm_cancelled.load())
+      break;
+    GstRegistryHasElementForCodec(codec, false);
+  }
+  for (auto codec : audio_codecs) {
+    if (g_prewarm_cancelled.load())
+      break;
+    GstRegistryHasElementForCodec(codec, false);
+  }
+  GetCapabilityCache()->Save();
+  SB_LOG(INFO) << "Codec capabilities ready in "
+               << (SbTimeGetMonotonicNow() - started_at) / kSbTimeMillisecond
+               << " ms";
+  return nullptr;
+}
+
 }  // namespace
 
 bool GstRegistryHasElementForMediaType(SbMediaVideoCodec codec) {
@@ -152,6 +369,32 @@ bool GstRegistryHasElementForMediaType(SbMediaAudioCodec codec) {
   return GstRegistryHasElementForCodec(codec);
 }
 
+bool LookupCapability(const std::string& key, bool* supported) {
+  return GetCapabilityCache()->Lookup(key, supported);
+}
+
+void StoreCapability(const std::string& key, bool supported) {
+  GetCapabilityCache()->Store(key, supported, false);
+}
+
+void PrewarmCodecCapabilities() {
+  SB_DCHECK(!SbThreadIsValid(g_prewarm_thread));
+  g_prewarm_cancelled.store(false);
+  g_prewarm_thread = SbThreadCreate(0, kSbThreadPriorityLow, kSbThreadNoAffinity,
+                                    true, "codec_probe",
+                                    &PrewarmThreadEntryPoint, nullptr);
+  SB_DCHECK(SbThreadIsValid(g_prewarm_thread));
+}
+
+void StopCodecCapabilitiesPrewarm() {
+  if (!SbThreadIsValid(g_prewarm_thread))
+    return;
+  // The probe running now finishes, the remaining ones are skipped.
+  g_prewarm_cancelled.store(true);
+  SbThreadJoin(g_prewarm_thread, nullptr);
+  g_prewarm_thread = kSbThreadInvalid;
+}
+
 std::vector<std::string> CodecToGstCaps(SbMediaVideoCodec codec) {
   switch (codec) {
     default:
@@ -30,6 +30,18 @@ namespace media {
 
 bool GstRegistryHasElementForMediaType(SbMediaVideoCodec codec);
 bool GstRegistryHasElementForMediaType(SbMediaAudioCodec codec);
+
+// Process wide memo for other capability probes, e.g. OCDM key systems.
+// These answers are not persisted.
+bool LookupCapability(const std::string& key, bool* supported);
+void StoreCapability(const std::string& key, bool supported);
+
+// Probes every codec on a background thread, answers are reused from the
+// on-disk cache when the GStreamer registry did not change.
+void PrewarmCodecCapabilities();
+// Cancels the remaining probes and joins the thread, call before GStreamer
+// gets deinitialized.
+void StopCodecCapabilitiesPrewarm();
 std::vector<std::string> CodecToGstCaps(
     SbMediaAudioCodec codec,
     const SbMediaAudioSampleInfo* info = nullptr);
@@ -0,0 +1,321 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#include "third_party/starboard/rdk/shared/media/gst_sample_pool.h"
+
+#include <algorithm>
+
+#include "starboard/common/log.h"
+#include "starboard/once.h"
+#include "third_party/starboard/rdk/shared/media/media_stats.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+namespace {
+
+GST_DEBUG_CATEGORY(cobalt_gst_sample_pool_debug);
+#define GST_CAT_DEFAULT cobalt_gst_sample_pool_debug
+
+constexpr gsize kMinSizeClass = 1024;
+constexpr guint kMinBuffersPerClass = 4;
+// Idle retention limits, in buffers per class and in budget share per pool.
+constexpr int64_t kMaxIdleBuffersPerClass = 16;
+constexpr int kIdleBudgetDivisor = 8;
+
+void UpdateHighWaterMark(std::atomic<int64_t>& hwm, int64_t value) {
+  int64_t prev = hwm.load(std::memory_order_relaxed);
+  while (prev < value &&
+         !hwm.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+  }
+}
+
+G_BEGIN_DECLS
+
+#define GST_COBALT_TYPE_SAMPLE_POOL (gst_cobalt_sample_pool_get_type())
+#define GST_COBALT_SAMPLE_POOL(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_COBALT_TYPE_SAMPLE_POOL, GstCobaltSamplePool))
+
+typedef struct _GstCobaltSamplePool GstCobaltSamplePool;
+typedef struct _GstCobaltSamplePoolClass GstCobaltSamplePoolClass;
+
+struct _GstCobaltSamplePool {
+  GstBufferPool parent;
+  SamplePool::SizeClass* size_class;
+};
+
+struct _GstCobaltSamplePoolClass {
+  GstBufferPoolClass parent_class;
+};
+
+GType gst_cobalt_sample_pool_get_type(void);
+
+G_END_DECLS
+
+G_DEFINE_TYPE(GstCobaltSamplePool, gst_cobalt_sample_pool, GST_TYPE_BUFFER_POOL);
+
+static GstFlowReturn gst_cobalt_sample_pool_alloc_buffer(GstBufferPool* pool,
+                                                         GstBuffer** buffer,
+                                                         GstBufferPoolAcquireParams* params) {
+  GstFlowReturn ret = GST_BUFFER_POOL_CLASS(gst_cobalt_sample_pool_parent_class)
+                          ->alloc_buffer(pool, buffer, params);
+  if (ret == GST_FLOW_OK) {
+    SamplePool::SizeClass* size_class = GST_COBALT_SAMPLE_POOL(pool)->size_class;
+    int64_t allocated = ++size_class->allocated;
+    UpdateHighWaterMark(size_class->allocated_hwm, allocated);
+    // Idle until acquired.
+    size_class->idle_bytes->fetch_add(size_class->size, std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+static void gst_cobalt_sample_pool_free_buffer(GstBufferPool* pool, GstBuffer* buffer) {
+  SamplePool::SizeClass* size_class = GST_COBALT_SAMPLE_POOL(pool)->size_class;
+  --size_class->allocated;
+  size_class->idle_bytes->fetch_sub(size_class->size, std::memory_order_relaxed);
+  GST_BUFFER_POOL_CLASS(gst_cobalt_sample_pool_parent_class)->free_buffer(pool, buffer);
+}
+
+static GstFlowReturn gst_cobalt_sample_pool_acquire_buffer(GstBufferPool* pool,
+                                                           GstBuffer** buffer,
+                                                           GstBufferPoolAcquireParams* params) {
+  GstFlowReturn ret = GST_BUFFER_POOL_CLASS(gst_cobalt_sample_pool_parent_class)
+                          ->acquire_buffer(pool, buffer, params);
+  if (ret == GST_FLOW_OK) {
+    SamplePool::SizeClass* size_class = GST_COBALT_SAMPLE_POOL(pool)->size_class;
+    ++size_class->in_use;
+    size_class->idle_bytes->fetch_sub(size_class->size, std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+static void gst_cobalt_sample_pool_release_buffer(GstBufferPool* pool, GstBuffer* buffer) {
+  SamplePool::SizeClass* size_class = GST_COBALT_SAMPLE_POOL(pool)->size_class;
+  int64_t in_use = --size_class->in_use;
+  int64_t idle_bytes =
+      size_class->idle_bytes->fetch_add(size_class->size, std::memory_order_relaxed) +
+      static_cast<int64_t>(size_class->size);
+  // The default release frees buffers with tagged memory instead of queueing
+  // them.
+  if (size_class->allocated.load(std::memory_order_relaxed) - in_use > kMaxIdleBuffersPerClass ||
+      idle_bytes > size_class->max_idle_bytes) {
+    GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_TAG_MEMORY);
+    ++size_class->idle_frees;
+  }
+  GST_BUFFER_POOL_CLASS(gst_cobalt_sample_pool_parent_class)->release_buffer(pool, buffer);
+}
+
+static void gst_cobalt_sample_pool_init(GstCobaltSamplePool* pool) {
+  pool->size_class = nullptr;
+}
+
+static void gst_cobalt_sample_pool_class_init(GstCobaltSamplePoolClass* klass) {
+  GstBufferPoolClass* pool_class = GST_BUFFER_POOL_CLASS(klass);
+  pool_class->alloc_buffer = gst_cobalt_sample_pool_alloc_buffer;
+  pool_class->free_buffer = gst_cobalt_sample_pool_free_buffer;
+  pool_class->acquire_buffer = gst_cobalt_sample_pool_acquire_buffer;
+  pool_class->release_buffer = gst_cobalt_sample_pool_release_buffer;
+}
+
+int GetBufferBudget(SbMediaType type) {
+  if (type == kSbMediaTypeAudio)
+    return SbMediaGetAudioBufferBudget();
+  return SbMediaGetVideoBufferBudget(kSbMediaVideoCodecNone,
+                                     kSbMediaVideoResolutionDimensionInvalid,
+                                     kSbMediaVideoResolutionDimensionInvalid,
+                                     8);
+}
+
+struct SamplePools {
+  SamplePool audio { kSbMediaTypeAudio };
+  SamplePool video { kSbMediaTypeVideo };
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(SamplePools, GetSamplePools);
+
+}  // namespace
+
+// static
+SamplePool* SamplePool::Get(SbMediaType type) {
+  SamplePools* pools = GetSamplePools();
+  return type == kSbMediaTypeVideo ? &pools->video : &pools->audio;
+}
+
+SamplePool::SamplePool(SbMediaType type) : type_(type) {
+  GST_DEBUG_CATEGORY_INIT(cobalt_gst_sample_pool_debug, "gstsamplepool", 0,
+                          "Cobalt sample pool");
+
+#if SB_API_VERSION >= 14
+  int alignment = SbMediaGetBufferAlignment();
+  int padding = SbMediaGetBufferPadding();
+#else
+  int alignment = SbMediaGetBufferAlignment(type);
+  int padding = SbMediaGetBufferPadding(type);
+#endif
+  gsize max_size = std::max<gsize>(SbMediaGetBufferAllocationUnit(), kMinSizeClass);
+  gsize budget = GetBufferBudget(type);
+
+  int class_count = 0;
+  for (gsize size = kMinSizeClass; size <= max_size; size *= 2)
+    ++class_count;
+
+  GstAllocationParams params;
+  gst_allocation_params_init(&params);
+  params.align = alignment > 1 ? alignment - 1 : 0;
+  params.padding = padding > 0 ? padding : 0;
+
+  // Split the budget evenly between the classes.
+  for (gsize size = kMinSizeClass; size <= max_size; size *= 2) {
+    SizeClass* size_class = new SizeClass();
+    size_class->size = size;
+    size_class->max_buffers =
+        std::max<guint>(kMinBuffersPerClass, budget / class_count / size);
+    size_class->idle_bytes = &idle_bytes_;
+    size_class->max_idle_bytes =
+        std::max<int64_t>(budget / kIdleBudgetDivisor, max_size);
+
+    GstCobaltSamplePool* pool = GST_COBALT_SAMPLE_POOL(
+        g_object_new(GST_COBALT_TYPE_SAMPLE_POOL, nullptr));
+    gst_object_ref_sink(pool);
+    pool->size_class = size_class;
+    size_class->pool = GST_BUFFER_POOL(pool);
+
+    GstStructure* config = gst_buffer_pool_get_config(size_class->pool);
+    gst_buffer_pool_config_set_params(config, nullptr, size, 0, size_class->max_buffers);
+    gst_buffer_pool_config_set_allocator(config, nullptr, &params);
+    if (!gst_buffer_pool_set_config(size_class->pool, config) ||
+        !gst_buffer_pool_set_active(size_class->pool, TRUE)) {
+      GST_WARNING("Failed to configure %" G_GSIZE_FORMAT " bytes pool", size);
+    }
+    classes_.push_back(size_class);
+  }
+
+  GST_INFO("Created %s sample pool: %d classes (%" G_GSIZE_FORMAT "..%" G_GSIZE_FORMAT
+           " bytes), budget %" G_GSIZE_FORMAT ", align %d, padding %d",
+           type == kSbMediaTypeVideo ? "video" : "audio", class_count,
+           kMinSizeClass, max_size, budget, alignment, padding);
+}
+
+SamplePool::~SamplePool() {
+  for (SizeClass* size_class : classes_) {
+    gst_buffer_pool_set_active(size_class->pool, FALSE);
+    gst_object_unref(size_class->pool);
+    delete size_class;
+  }
+}
+
+SamplePool::SizeClass* SamplePool::FindSizeClass(gsize size) {
+  for (SizeClass* size_class : classes_) {
+    if (size <= size_class->size)
+      return size_class;
+  }
+  return nullptr;
+}
+
+GstBuffer* SamplePool::Allocate(gsize size) {
+  SizeClass* size_class = FindSizeClass(size);
+  if (size_class) {
+    GstBuffer* buffer = nullptr;
+    GstBufferPoolAcquireParams params = {};
+    params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+    if (gst_buffer_pool_acquire_buffer(size_class->pool, &buffer, &params) == GST_FLOW_OK) {
+      ++size_class->hits;
+      gst_buffer_resize(buffer, 0, size);
+      return buffer;
+    }
+  }
+
+  ++misses_;
+  GST_LOG("Pool miss for %" G_GSIZE_FORMAT " bytes", size);
+  return gst_buffer_new_allocate(nullptr, size, nullptr);
+}
+
+GstBuffer* SamplePool::AllocateAndFill(const void* data, gsize size) {
+  GstBuffer* buffer = Allocate(size);
+  gsize written = gst_buffer_fill(buffer, 0, data, size);
+  SB_DCHECK(written == size);
+  return buffer;
+}
+
+void SamplePool::Trim() {
+  // A deactivated pool keeps its idle buffers as long as any buffer is
+  // outstanding. Take the idle ones out instead and free them on release.
+  GstBufferPoolAcquireParams params = {};
+  params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+  gsize trimmed = 0;
+  for (SizeClass* size_class : classes_) {
+    // Acquiring beyond the idle count would allocate new buffers.
+    int64_t idle = size_class->allocated.load() - size_class->in_use.load();
+    for (; idle > 0; --idle) {
+      GstBuffer* buffer = nullptr;
+      if (gst_buffer_pool_acquire_buffer(size_class->pool, &buffer, &params) != GST_FLOW_OK)
+        break;
+      GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_TAG_MEMORY);
+      gst_buffer_unref(buffer);
+      trimmed += size_class->size;
+    }
+  }
+  GST_INFO("Trimmed %" G_GSIZE_FORMAT " bytes from %s sample pool", trimmed,
+           type_ == kSbMediaTypeVideo ? "video" : "audio");
+}
+
+void SamplePool::WriteStats(const char* name, StatsWriter& writer) const {
+  uint64_t hits = 0;
+  int64_t pooled_bytes = 0;
+  int64_t pooled_bytes_hwm = 0;
+  int64_t in_use_bytes = 0;
+
+  writer.BeginObject(name);
+  writer.BeginArray("classes");
+  for (const SizeClass* size_class : classes_) {
+    int64_t size = static_cast<int64_t>(size_class->size);
+    int64_t allocated = size_class->allocated.load();
+    int64_t allocated_hwm = size_class->allocated_hwm.load();
+    int64_t in_use = size_class->in_use.load();
+    uint64_t class_hits = size_class->hits.load();
+
+    hits += class_hits;
+    pooled_bytes += allocated * size;
+    pooled_bytes_hwm += allocated_hwm * size;
+    in_use_bytes += in_use * size;
+
+    writer.BeginObject();
+    writer.Add("size", size);
+    writer.Add("maxbuffers", size_class->max_buffers);
+    writer.Add("hits", class_hits);
+    writer.Add("allocated", allocated);
+    writer.Add("allocatedhwm", allocated_hwm);
+    writer.Add("inuse", in_use);
+    writer.Add("idlefrees", size_class->idle_frees.load());
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.Add("hits", hits);
+  writer.Add("misses", misses_.load());
+  writer.Add("pooledbytes", pooled_bytes);
+  writer.Add("pooledbyteshwm", pooled_bytes_hwm);
+  writer.Add("inusebytes", in_use_bytes);
+  writer.Add("idlebytes", idle_bytes_.load());
+  writer.EndObject();
+}
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,88 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_GST_SAMPLE_POOL_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_GST_SAMPLE_POOL_H_
+
+#include <atomic>
+#include <vector>
+
+#include <gst/gst.h>
+
+#include "starboard/media.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+
+class StatsWriter;
+
+// Set of size-classed GstBufferPools for media sample payloads. Classes grow
+// in powers of two up to SbMediaGetBufferAllocationUnit(), buffers honour
+// SbMediaGetBufferAlignment() and SbMediaGetBufferPadding(). The memory kept by
+// all classes of a pool is bounded by the media type's buffer budget; a
+// request which does not fit any class, or hits an exhausted one, falls back
+// to the default allocator and is counted as a miss. Idle buffers are kept
+// up to a small count per class and a share of the budget for the whole
+// pool, buffers released above either limit are freed.
+class SamplePool {
+ public:
+  static SamplePool* Get(SbMediaType type);
+
+  explicit SamplePool(SbMediaType type);
+  ~SamplePool();
+
+  // Returns a writable buffer of exactly |size| bytes.
+  GstBuffer* Allocate(gsize size);
+  GstBuffer* AllocateAndFill(const void* data, gsize size);
+
+  // Releases the memory of all idle buffers.
+  void Trim();
+
+  void WriteStats(const char* name, StatsWriter& writer) const;
+
+  struct SizeClass {
+    gsize size { 0 };
+    guint max_buffers { 0 };
+    GstBufferPool* pool { nullptr };
+    std::atomic<uint64_t> hits { 0 };
+    std::atomic<int64_t> allocated { 0 };
+    std::atomic<int64_t> allocated_hwm { 0 };
+    std::atomic<int64_t> in_use { 0 };
+    std::atomic<uint64_t> idle_frees { 0 };
+    // Shared by all classes of the pool.
+    std::atomic<int64_t>* idle_bytes { nullptr };
+    int64_t max_idle_bytes { 0 };
+  };
+
+ private:
+  SizeClass* FindSizeClass(gsize size);
+
+  SbMediaType type_;
+  std::vector<SizeClass*> classes_;
+  std::atomic<uint64_t> misses_ { 0 };
+  std::atomic<int64_t> idle_bytes_ { 0 };
+};
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_GST_SAMPLE_POOL_H_
@@ -0,0 +1,421 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/media/media_buffer_budget.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+#include "starboard/common/log.h"
+#include "starboard/once.h"
+#include "third_party/starboard/rdk/shared/media/media_stats.h"
+#include "third_party/starboard/rdk/shared/rdkservices.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+namespace {
+
+constexpr int64_t kMiB = 1024 * 1024;
+// Budgets are ints in bytes. Capping every profile value at half the range
+// keeps a video budget plus the audio one representable.
+constexpr int kMaxProfileMiB = INT32_MAX / kMiB / 2;
+
+// Budgets the port used to hardcode, in MiB. They are the reference for a
+// device with enough memory and are scaled down from there.
+constexpr int kDefaultVideo[] = { 30, 100, 300 };
+constexpr int kDefaultVideoHighBitDepth[] = { 30, 160, 300 };
+constexpr int kDefaultMaxCapacity[] = { 50, 210, 360 };
+constexpr int kDefaultAudio = 5;
+constexpr int kDefaultProgressive = 12;
+constexpr int kDefaultInitialCapacity = 21;
+
+// Share of the process memory the media buffers of the display's tier may
+// take. Overridable through the profile ("memory_share_percent").
+constexpr int kDefaultMemorySharePercent = 20;
+constexpr double kMinScale = 0.25;
+constexpr double kMaxScale = 4.0;
+
+// Video and progressive budgets are cut by this factor under memory pressure.
+constexpr double kPressureScale = 0.5;
+
+constexpr const char* kDefaultProfilePath = "/etc/cobalt/media_buffer_budget.conf";
+
+const char* TierName(BufferBudget::Tier tier) {
+  switch (tier) {
+    case BufferBudget::k1080p: return "1080p";
+    case BufferBudget::k4k: return "4k";
+    case BufferBudget::k8k: return "8k";
+    default: break;
+  }
+  return "unknown";
+}
+
+int64_t ReadMemTotal() {
+  FILE* meminfo = fopen("/proc/meminfo", "r");
+  if (!meminfo)
+    return 0;
+
+  int64_t total_kb = 0;
+  char* buffer = nullptr;
+  size_t size = 0;
+  while (getline(&buffer, &size, meminfo) != -1) {
+    if (sscanf(buffer, "MemTotal: %" SCNd64 " kB", &total_kb) == 1)
+      break;
+  }
+  free(buffer);
+  fclose(meminfo);
+  return total_kb * 1024;
+}
+
+// Returns the limit from a cgroup v1 "memory.limit_in_bytes" or v2
+// "memory.max" file, 0 if there is none. Unlimited v1 groups report a value
+// close to INT64_MAX.
+int64_t ReadCgroupLimitFile(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file)
+    return 0;
+
+  char value[32] = {};
+  int64_t limit = 0;
+  if (fgets(value, sizeof(value), file) && strncmp(value, "max", 3) != 0)
+    limit = strtoll(value, nullptr, 10);
+  fclose(file);
+  return limit > 0 && limit < INT64_MAX / 2 ? limit : 0;
+}
+
+int64_t ReadCgroupLimit() {
+  // "hierarchy-ID:controller-list:cgroup-path", v2 uses "0::path".
+  std::string v1_path, v2_path;
+  FILE* cgroup = fopen("/proc/self/cgroup", "r");
+  if (cgroup) {
+    char* buffer = nullptr;
+    size_t size = 0;
+    while (getline(&buffer, &size, cgroup) != -1) {
+      std::string line(buffer);
+      if (!line.empty() && line.back() == '\n')
+        line.pop_back();
+      size_t first = line.find(':');
+      size_t second = line.find(':', first + 1);
+      if (first == std::string::npos || second == std::string::npos)
+        continue;
+      std::string controllers = line.substr(first + 1, second - first - 1);
+      std::string path = line.substr(second + 1);
+      if (path == "/")
+        path.clear();
+      if (controllers.empty())
+        v2_path = path;
+      else if (("," + controllers + ",").find(",memory,") != std::string::npos)
+        v1_path = path;
+    }
+    free(buffer);
+    fclose(cgroup);
+  }
+
+  // The process' own cgroup may not be visible from a namespaced mount, fall
+  // back to the root of the hierarchy then.
+  const std::string candidates[] = {
+    "/sys/fs/cgroup" + v2_path + "/memory.max",
+    "/sys/fs/cgroup/memory" + v1_path + "/memory.limit_in_bytes",
+    "/sys/fs/cgroup/memory.max",
+    "/sys/fs/cgroup/memory/memory.limit_in_bytes",
+  };
+  for (const std::string& candidate : candidates) {
+    int64_t limit = ReadCgroupLimitFile(candidate);
+    if (limit > 0)
+      return limit;
+  }
+  return 0;
+}
+
+// Profile values, -1 when not set. Sizes are in MiB.
+struct Profile {
+  int memory_share_percent { -1 };
+  double max_scale { -1 };
+  int video[BufferBudget::kTierCount] { -1, -1, -1 };
+  int video_high_bit_depth[BufferBudget::kTierCount] { -1, -1, -1 };
+  int max_capacity[BufferBudget::kTierCount] { -1, -1, -1 };
+  int audio { -1 };
+  int progressive { -1 };
+  int initial_capacity { -1 };
+};
+
+// Reads "key = value" lines, '#' starts a comment. Keys are the members of
+// Profile, per tier ones carry a "_1080p", "_4k" or "_8k" suffix, e.g.
+//   memory_share_percent = 30
+//   video_high_bit_depth_4k = 120
+bool LoadProfile(const char* path, Profile* profile) {
+  FILE* file = fopen(path, "r");
+  if (!file)
+    return false;
+
+  char* buffer = nullptr;
+  size_t size = 0;
+  while (getline(&buffer, &size, file) != -1) {
+    char key[64];
+    char value[32];
+    if (buffer[0] == '#' ||
+        sscanf(buffer, " %63[a-z0-9_] = %31s", key, value) != 2)
+      continue;
+
+    std::string name(key);
+    if (name == "max_scale") {
+      profile->max_scale = strtod(value, nullptr);
+      continue;
+    }
+
+    char* end = nullptr;
+    long long parsed = strtoll(value, &end, 10);
+    if (end == value || *end != '\0') {
+      SB_LOG(WARNING) << "Ignoring '" << name << "' in " << path;
+      continue;
+    }
+    if (parsed > kMaxProfileMiB) {
+      SB_LOG(WARNING) << "Clamping '" << name << "' in " << path << " to "
+                      << kMaxProfileMiB;
+      parsed = kMaxProfileMiB;
+    }
+    int mib = static_cast<int>(std::max<long long>(parsed, 0));
+    if (name == "memory_share_percent") {
+      profile->memory_share_percent = std::min(std::max(mib, 1), 100);
+      continue;
+    }
+    if (mib <= 0) {
+      SB_LOG(WARNING) << "Ignoring '" << name << "' in " << path;
+      continue;
+    }
+    if (name == "audio") {
+      profile->audio = mib;
+    } else if (name == "progressive") {
+      profile->progressive = mib;
+    } else if (name == "initial_capacity") {
+      profile->initial_capacity = mib;
+    } else {
+      bool known = false;
+      for (int tier = 0; tier < BufferBudget::kTierCount; ++tier) {
+        const std::string suffix =
+            std::string("_") + TierName(static_cast<BufferBudget::Tier>(tier));
+        if (name == "video" + suffix)
+          profile->video[tier] = mib;
+        else if (name == "video_high_bit_depth" + suffix)
+          profile->video_high_bit_depth[tier] = mib;
+        else if (name == "max_capacity" + suffix)
+          profile->max_capacity[tier] = mib;
+        else
+          continue;
+        known = true;
+      }
+      if (!known)
+        SB_LOG(WARNING) << "Unknown key '" << name << "' in " << path;
+    }
+  }
+  free(buffer);
+  fclose(file);
+  return true;
+}
+
+int Scale(int mib, double scale) {
+  return static_cast<int>(mib * kMiB * scale);
+}
+
+int Override(int computed, int profile_mib) {
+  return profile_mib > 0 ? static_cast<int>(profile_mib * kMiB) : computed;
+}
+
+// Max capacity must stay above each tier's video budget plus the audio one.
+void EnsureCapacity(BufferBudget* b) {
+  for (int tier = 0; tier < BufferBudget::kTierCount; ++tier) {
+    int64_t needed =
+        static_cast<int64_t>(std::max(b->video[tier], b->video_high_bit_depth[tier])) +
+        b->audio;
+    if (b->max_capacity[tier] < needed) {
+      SB_LOG(WARNING) << "Raising "
+                      << TierName(static_cast<BufferBudget::Tier>(tier))
+                      << " max capacity to fit video and audio budgets";
+      b->max_capacity[tier] =
+          static_cast<int>(std::min<int64_t>(needed, INT32_MAX));
+    }
+  }
+}
+
+BufferBudget Reduce(const BufferBudget& in) {
+  BufferBudget out = in;
+  for (int tier = 0; tier < BufferBudget::kTierCount; ++tier) {
+    out.video[tier] = static_cast<int>(in.video[tier] * kPressureScale);
+    out.video_high_bit_depth[tier] =
+        static_cast<int>(in.video_high_bit_depth[tier] * kPressureScale);
+    out.max_capacity[tier] =
+        static_cast<int>(in.max_capacity[tier] * kPressureScale);
+  }
+  out.progressive = static_cast<int>(in.progressive * kPressureScale);
+  EnsureCapacity(&out);
+  out.initial_capacity = std::min(in.initial_capacity,
+                                  out.max_capacity[BufferBudget::k1080p]);
+  return out;
+}
+
+struct BufferBudgetState {
+  BufferBudgetState();
+  BufferBudget budget;
+  BufferBudget reduced;
+  std::atomic<bool> under_pressure { false };
+  std::atomic<uint64_t> pressure_events { 0 };
+};
+
+BufferBudgetState::BufferBudgetState() {
+  BufferBudget& b = budget;
+
+  const char* profile_path = getenv("COBALT_MEDIA_BUFFER_PROFILE");
+  if (!profile_path)
+    profile_path = kDefaultProfilePath;
+  Profile profile;
+  b.profile = LoadProfile(profile_path, &profile) ? profile_path : nullptr;
+
+  b.memory_total = ReadMemTotal();
+  b.memory_limit = ReadCgroupLimit();
+  int64_t memory = b.memory_total;
+  if (b.memory_limit > 0 && (memory == 0 || b.memory_limit < memory))
+    memory = b.memory_limit;
+
+  b.memory_share_percent = profile.memory_share_percent > 0
+      ? profile.memory_share_percent : kDefaultMemorySharePercent;
+  double max_scale = profile.max_scale > 0
+      ? std::min(std::max(profile.max_scale, kMinScale), kMaxScale) : 1.0;
+  double share = static_cast<double>(memory) * b.memory_share_percent / 100;
+
+  ResolutionInfo resolution = DisplayInfo::GetResolution();
+  b.display_tier = BufferBudget::GetTier(resolution.Width, resolution.Height);
+
+  // Each tier is scaled so that its capacity fits the memory share. Tiers
+  // above the display's are never played, they get the display's budgets.
+  double scale_1080p = 1.0;
+  for (int tier = 0; tier < BufferBudget::kTierCount; ++tier) {
+    int source = std::min<int>(tier, b.display_tier);
+    double scale = 1.0;
+    if (memory > 0) {
+      scale = share / (kDefaultMaxCapacity[source] * kMiB);
+      scale = std::min(std::max(scale, kMinScale), max_scale);
+    }
+    if (tier == BufferBudget::k1080p)
+      scale_1080p = scale;
+    b.video[tier] = Scale(kDefaultVideo[source], scale);
+    b.video_high_bit_depth[tier] =
+        Scale(kDefaultVideoHighBitDepth[source], scale);
+    b.max_capacity[tier] = Scale(kDefaultMaxCapacity[source], scale);
+  }
+  b.audio = static_cast<int>(kDefaultAudio * kMiB);
+  b.progressive = Scale(kDefaultProgressive, scale_1080p);
+
+  b.audio = Override(b.audio, profile.audio);
+  b.progressive = Override(b.progressive, profile.progressive);
+  for (int tier = 0; tier < BufferBudget::kTierCount; ++tier) {
+    b.video[tier] = Override(b.video[tier], profile.video[tier]);
+    b.video_high_bit_depth[tier] =
+        Override(b.video_high_bit_depth[tier],
+                 profile.video_high_bit_depth[tier]);
+    b.max_capacity[tier] =
+        Override(b.max_capacity[tier], profile.max_capacity[tier]);
+  }
+  EnsureCapacity(&b);
+  b.initial_capacity =
+      Override(std::min<int>(kDefaultInitialCapacity * kMiB,
+                             b.max_capacity[BufferBudget::k1080p]),
+               profile.initial_capacity);
+
+  SB_LOG(INFO) << "Media buffer budgets for " << memory / kMiB << " MiB ("
+               << b.memory_share_percent << "%), "
+               << TierName(b.display_tier) << " display, profile "
+               << (b.profile ? b.profile : "none") << ": video "
+               << b.video[BufferBudget::k1080p] / kMiB << "/"
+               << b.video[BufferBudget::k4k] / kMiB << "/"
+               << b.video[BufferBudget::k8k] / kMiB << " MiB, capacity "
+               << b.max_capacity[BufferBudget::k1080p] / kMiB << "/"
+               << b.max_capacity[BufferBudget::k4k] / kMiB << "/"
+               << b.max_capacity[BufferBudget::k8k] / kMiB << " MiB, audio "
+               << b.audio / kMiB << " MiB";
+
+  reduced = Reduce(b);
+}
+
+SB_ONCE_INITIALIZE_FUNCTION(BufferBudgetState, GetBufferBudgetState);
+
+}  // namespace
+
+// static
+BufferBudget::Tier BufferBudget::GetTier(int width, int height) {
+  if (width <= 1920 && height <= 1080)
+    return k1080p;
+  if (width <= 3840 && height <= 2160)
+    return k4k;
+  return k8k;
+}
+
+const BufferBudget& GetBufferBudget() {
+  BufferBudgetState* state = GetBufferBudgetState();
+  return state->under_pressure.load() ? state->reduced : state->budget;
+}
+
+void SetBufferBudgetUnderPressure(bool under_pressure) {
+  BufferBudgetState* state = GetBufferBudgetState();
+  if (state->under_pressure.exchange(under_pressure) == under_pressure)
+    return;
+  if (under_pressure)
+    ++state->pressure_events;
+  SB_LOG(INFO) << (under_pressure ? "Reducing" : "Restoring")
+               << " media buffer budgets";
+}
+
+void WriteBufferBudgetStats(StatsWriter& writer) {
+  BufferBudgetState* state = GetBufferBudgetState();
+  const BufferBudget& b = GetBufferBudget();
+  writer.BeginObject("bufferbudget");
+  writer.AddBool("pressure", state->under_pressure.load());
+  writer.Add("pressureevents", state->pressure_events.load());
+  writer.Add("memtotal", b.memory_total);
+  writer.Add("memlimit", b.memory_limit);
+  writer.Add("sharepercent", b.memory_share_percent);
+  writer.Add("display", TierName(b.display_tier));
+  writer.Add("profile", b.profile ? b.profile : "");
+  writer.BeginArray("tiers");
+  for (int tier = 0; tier < BufferBudget::kTierCount; ++tier) {
+    writer.BeginObject();
+    writer.Add("name", TierName(static_cast<BufferBudget::Tier>(tier)));
+    writer.Add("video", b.video[tier]);
+    writer.Add("videohbd", b.video_high_bit_depth[tier]);
+    writer.Add("maxcapacity", b.max_capacity[tier]);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.Add("audio", b.audio);
+  writer.Add("progressive", b.progressive);
+  writer.Add("initialcapacity", b.initial_capacity);
+  writer.EndObject();
+}
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,67 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_MEDIA_BUFFER_BUDGET_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_MEDIA_BUFFER_BUDGET_H_
+
+#include <stdint.h>
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+
+class StatsWriter;
+
+// Media buffer budgets of this device, in bytes. Computed once from the
+// memory available to the process (MemTotal, bounded by the cgroup limit),
+// the display resolution and an optional profile file, see
+// media_buffer_budget.cc. A reduced set is derived for memory pressure.
+struct BufferBudget {
+  enum Tier { k1080p, k4k, k8k, kTierCount };
+
+  static Tier GetTier(int width, int height);
+
+  int video[kTierCount];
+  int video_high_bit_depth[kTierCount];
+  int max_capacity[kTierCount];
+  int audio;
+  int progressive;
+  int initial_capacity;
+
+  // Inputs the budgets were derived from.
+  int64_t memory_total;
+  int64_t memory_limit;
+  int memory_share_percent;
+  Tier display_tier;
+  const char* profile;
+};
+
+// Returns the reduced budgets while memory pressure is reported.
+const BufferBudget& GetBufferBudget();
+void SetBufferBudgetUnderPressure(bool under_pressure);
+
+void WriteBufferBudgetStats(StatsWriter& writer);
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_MEDIA_BUFFER_BUDGET_H_
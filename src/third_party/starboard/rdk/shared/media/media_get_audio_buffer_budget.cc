@@ -32,9 +32,12 @@
 #include "starboard/media.h"
 
 #include "starboard/common/log.h"
+#include "third_party/starboard/rdk/shared/media/media_buffer_budget.h"
+
+using third_party::starboard::rdk::shared::media::GetBufferBudget;
 
 #if SB_API_VERSION >= 10
 int SbMediaGetAudioBufferBudget() {
-  return 5 * 1024 * 1024;
+  return GetBufferBudget().audio;
 }
 #endif  // SB_API_VERSION >= 10
@@ -16,9 +16,12 @@
 #include "starboard/media.h"
 
 #include "starboard/common/log.h"
+#include "third_party/starboard/rdk/shared/media/media_buffer_budget.h"
+
+using third_party::starboard::rdk::shared::media::GetBufferBudget;
 
 #if SB_API_VERSION >= 10
 int SbMediaGetInitialBufferCapacity() {
-  return 21 * 1024 * 1024;
+  return GetBufferBudget().initial_capacity;
 }
 #endif  // SB_API_VERSION >= 10
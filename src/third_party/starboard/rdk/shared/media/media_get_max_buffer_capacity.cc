@@ -16,6 +16,10 @@
 #include "starboard/media.h"
 
 #include "starboard/common/log.h"
+#include "third_party/starboard/rdk/shared/media/media_buffer_budget.h"
+
+using third_party::starboard::rdk::shared::media::BufferBudget;
+using third_party::starboard::rdk::shared::media::GetBufferBudget;
 
 #if SB_API_VERSION >= 10
 int SbMediaGetMaxBufferCapacity(SbMediaVideoCodec codec,
@@ -23,26 +27,15 @@ int SbMediaGetMaxBufferCapacity(SbMediaVideoCodec codec,
                                 int resolution_height,
                                 int bits_per_pixel) {
   SB_UNREFERENCED_PARAMETER(codec);
-  if ((resolution_width <= 1920 && resolution_height <= 1080) ||
-      resolution_width == kSbMediaVideoResolutionDimensionInvalid ||
-      resolution_height == kSbMediaVideoResolutionDimensionInvalid) {
-    // The maximum amount of memory that will be used to store media buffers
-    // when video resolution is 1080p. If 0, then memory can grow without bound.
-    // This must be larger than sum of 1080p video budget and non-video budget.
-    return 50 * 1024 * 1024;
-  }
-
-  if (resolution_width <= 3840 && resolution_height <= 2160) {
-      // The maximum amount of memory that will be used to store media buffers
-      // when video resolution is 4k. If 0,
-      // then memory can grow without bound. This must be larger than sum of 4k
-      // video budget and non-video budget.
-      return 210 * 1024 * 1024;
+  SB_UNREFERENCED_PARAMETER(bits_per_pixel);
+  // The maximum amount of memory that will be used to store media buffers at
+  // the given video resolution, larger than the sum of the resolution's video
+  // budget and the non-video budget. An invalid resolution is taken as 1080p.
+  BufferBudget::Tier tier = BufferBudget::k1080p;
+  if (resolution_width != kSbMediaVideoResolutionDimensionInvalid &&
+      resolution_height != kSbMediaVideoResolutionDimensionInvalid) {
+    tier = BufferBudget::GetTier(resolution_width, resolution_height);
   }
-
-  // The maximum amount of memory that will be used to store media buffers when
-  // video resolution is 8k. If 0, then memory can grow without bound. This
-  // must be larger than sum of 8k video budget and non-video budget.
-  return 360 * 1024 * 1024;
+  return GetBufferBudget().max_capacity[tier];
 }
 #endif  // SB_API_VERSION >= 10
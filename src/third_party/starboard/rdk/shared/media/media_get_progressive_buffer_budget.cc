@@ -17,6 +17,9 @@
 #include "starboard/media.h"
 
 #include "starboard/common/log.h"
+#include "third_party/starboard/rdk/shared/media/media_buffer_budget.h"
+
+using third_party::starboard::rdk::shared::media::GetBufferBudget;
 
 #if SB_API_VERSION >= 10
 int SbMediaGetProgressiveBufferBudget(SbMediaVideoCodec codec,
@@ -27,6 +30,6 @@ int SbMediaGetProgressiveBufferBudget(SbMediaVideoCodec codec,
   SB_UNREFERENCED_PARAMETER(resolution_width);
   SB_UNREFERENCED_PARAMETER(resolution_height);
   SB_UNREFERENCED_PARAMETER(bits_per_pixel);
-  return 12 * 1024 * 1024;
+  return GetBufferBudget().progressive;
 }
 #endif  // SB_API_VERSION >= 10
@@ -15,6 +15,10 @@
 #include "starboard/media.h"
 
 #include "starboard/common/log.h"
+#include "third_party/starboard/rdk/shared/media/media_buffer_budget.h"
+
+using third_party::starboard::rdk::shared::media::BufferBudget;
+using third_party::starboard::rdk::shared::media::GetBufferBudget;
 
 #if SB_API_VERSION >= 10
 int SbMediaGetVideoBufferBudget(SbMediaVideoCodec codec,
@@ -22,32 +26,17 @@ int SbMediaGetVideoBufferBudget(SbMediaVideoCodec codec,
                                 int resolution_height,
                                 int bits_per_pixel) {
   SB_UNREFERENCED_PARAMETER(codec);
-  if ((resolution_width <= 1920 && resolution_height <= 1080) ||
-      resolution_width == kSbMediaVideoResolutionDimensionInvalid ||
-      resolution_height == kSbMediaVideoResolutionDimensionInvalid) {
-    // Specifies the maximum amount of memory used by video buffers of media
-    // source before triggering a garbage collection when the video resolution
-    // is lower than 1080p (1920x1080).
-    return 30 * 1024 * 1024;
-  }
-
-  if (resolution_width <= 3840 && resolution_height <= 2160) {
-    if (bits_per_pixel <= 8) {
-      // Specifies the maximum amount of memory used by video buffers of media
-      // source before triggering a garbage collection when the video resolution
-      // is lower than 4k (3840x2160) and bit per pixel is lower than 8.
-      return 100 * 1024 * 1024;
-    } else {
-      // Specifies the maximum amount of memory used by video buffers of media
-      // source before triggering a garbage collection when video resolution is
-      // lower than 4k (3840x2160) and bit per pixel is greater than 8.
-      return 160 * 1024 * 1024;
-    }
-  }
-
   // Specifies the maximum amount of memory used by video buffers of media
-  // source before triggering a garbage collection when the video resolution is
-  // lower than 8k (7680x4320).
-  return 300 * 1024 * 1024;
+  // source before triggering a garbage collection. Above 1080p the budget also
+  // depends on whether the bit depth is greater than 8. An invalid resolution
+  // is taken as 1080p.
+  BufferBudget::Tier tier = BufferBudget::k1080p;
+  if (resolution_width != kSbMediaVideoResolutionDimensionInvalid &&
+      resolution_height != kSbMediaVideoResolutionDimensionInvalid) {
+    tier = BufferBudget::GetTier(resolution_width, resolution_height);
+  }
+  const BufferBudget& budget = GetBufferBudget();
+  return bits_per_pixel <= 8 ? budget.video[tier]
+                             : budget.video_high_bit_depth[tier];
 }
 #endif  // SB_API_VERSION >= 10
@@ -29,6 +29,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <string.h>
+
 #include <string>
 
 #if SB_API_VERSION >= 13
@@ -38,6 +40,7 @@
 #include "starboard/media.h"
 
 #include "third_party/starboard/rdk/shared/drm/drm_system_ocdm.h"
+#include "third_party/starboard/rdk/shared/media/gst_media_utils.h"
 
 namespace {
 
@@ -98,17 +101,90 @@ std::string CodecToMimeType(SbMediaAudioCodec codec) {
   }
 }
 
+#if defined(HAS_OCDM)
+// Every query is a round trip to the OCDM service, remember the answers.
+// Only positive ones: a negative answer may just mean the service or the
+// CDM plugin is not up yet.
+bool IsKeySystemSupported(const char* key_system, const std::string& mime) {
+  using third_party::starboard::rdk::shared::drm::DrmSystemOcdm;
+  namespace media = third_party::starboard::rdk::shared::media;
+  std::string key = "keysystem/";
+  key += key_system ? key_system : "";
+  key += '/' + mime;
+  bool supported = false;
+  if (media::LookupCapability(key, &supported))
+    return supported;
+  supported = DrmSystemOcdm::IsKeySystemSupported(key_system, mime.c_str());
+  if (supported)
+    media::StoreCapability(key, supported);
+  return supported;
+}
+
+std::string Trim(const std::string& value) {
+  size_t begin = value.find_first_not_of(" \t");
+  if (begin == std::string::npos)
+    return {};
+  size_t end = value.find_last_not_of(" \t");
+  return value.substr(begin, end - begin + 1);
+}
+
+// |key_system| may carry attributes, e.g.
+// 'com.widevine.alpha; encryptionscheme="cbcs"'. Returns the bare key system
+// in |name|, or false if an attribute cannot be honored.
+bool ParseKeySystem(const char* key_system, std::string* name) {
+  using third_party::starboard::rdk::shared::drm::DrmSystemOcdm;
+  const char* separator = key_system ? strchr(key_system, ';') : nullptr;
+  if (!separator) {
+    *name = key_system ? key_system : "";
+    return true;
+  }
+  *name = Trim(std::string(key_system, separator - key_system));
+
+  std::string attributes(separator + 1);
+  size_t begin = 0;
+  while (begin <= attributes.size()) {
+    size_t end = attributes.find(';', begin);
+    if (end == std::string::npos)
+      end = attributes.size();
+    std::string attribute = Trim(attributes.substr(begin, end - begin));
+    begin = end + 1;
+    if (attribute.empty())
+      continue;
+
+    size_t equals = attribute.find('=');
+    if (equals == std::string::npos)
+      return false;
+    std::string key = Trim(attribute.substr(0, equals));
+    std::string value = Trim(attribute.substr(equals + 1));
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+      value = value.substr(1, value.size() - 2);
+
+    if (key != "encryptionscheme")
+      return false;
+    if (value == "cenc")
+      continue;
+    if (value == "cbcs" || value == "cbcs-1-9") {
+      if (!DrmSystemOcdm::IsEncryptionSchemeSupported(kSbDrmEncryptionSchemeAesCbc))
+        return false;
+      continue;
+    }
+    return false;
+  }
+  return true;
+}
+#endif
+
 }  // namspace
 
 SB_EXPORT bool SbMediaIsSupported(SbMediaVideoCodec video_codec,
                                   SbMediaAudioCodec audio_codec,
                                   const char* key_system) {
 #if defined(HAS_OCDM)
-  using third_party::starboard::rdk::shared::drm::DrmSystemOcdm;
-  return DrmSystemOcdm::IsKeySystemSupported(
-      key_system, CodecToMimeType(video_codec).c_str()) &&
-      DrmSystemOcdm::IsKeySystemSupported(
-            key_system, CodecToMimeType(audio_codec).c_str());
+  std::string name;
+  if (!ParseKeySystem(key_system, &name))
+    return false;
+  return IsKeySystemSupported(name.c_str(), CodecToMimeType(video_codec)) &&
+         IsKeySystemSupported(name.c_str(), CodecToMimeType(audio_codec));
 #else
   return false;
 #endif
@@ -0,0 +1,155 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#include "third_party/starboard/rdk/shared/media/media_stats.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "third_party/starboard/rdk/shared/drm/gst_drm_meta.h"
+#include "third_party/starboard/rdk/shared/media/gst_sample_pool.h"
+#include "third_party/starboard/rdk/shared/media/media_buffer_budget.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace audio_sink {
+void WriteStats(media::StatsWriter& writer);
+}  // namespace audio_sink
+
+namespace player {
+void WriteStats(media::StatsWriter& writer);
+}  // namespace player
+
+#if defined(HAS_OCDM)
+namespace drm {
+void WriteDrmSystemStats(media::StatsWriter& writer);
+void WriteDecryptorStats(media::StatsWriter& writer);
+}  // namespace drm
+#endif
+
+namespace media {
+
+void StatsWriter::Key(const char* name) {
+  if (need_comma_)
+    out_ += ',';
+  if (name) {
+    out_ += '"';
+    out_ += name;
+    out_ += "\":";
+  }
+  need_comma_ = true;
+}
+
+void StatsWriter::BeginObject(const char* name) {
+  Key(name);
+  out_ += '{';
+  need_comma_ = false;
+}
+
+void StatsWriter::EndObject() {
+  out_ += '}';
+  need_comma_ = true;
+}
+
+void StatsWriter::BeginArray(const char* name) {
+  Key(name);
+  out_ += '[';
+  need_comma_ = false;
+}
+
+void StatsWriter::EndArray() {
+  out_ += ']';
+  need_comma_ = true;
+}
+
+void StatsWriter::Add(const char* name, int value) {
+  Add(name, static_cast<int64_t>(value));
+}
+
+void StatsWriter::Add(const char* name, unsigned int value) {
+  Add(name, static_cast<uint64_t>(value));
+}
+
+void StatsWriter::Add(const char* name, int64_t value) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%" PRId64, value);
+  Key(name);
+  out_ += buf;
+}
+
+void StatsWriter::Add(const char* name, uint64_t value) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%" PRIu64, value);
+  Key(name);
+  out_ += buf;
+}
+
+void StatsWriter::Add(const char* name, double value) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.3f", value);
+  Key(name);
+  out_ += buf;
+}
+
+void StatsWriter::Add(const char* name, const char* value) {
+  Key(name);
+  out_ += '"';
+  for (const char* c = value; c && *c; ++c) {
+    if (*c == '"' || *c == '\\')
+      out_ += '\\';
+    out_ += *c;
+  }
+  out_ += '"';
+}
+
+void StatsWriter::AddBool(const char* name, bool value) {
+  Key(name);
+  out_ += value ? "true" : "false";
+}
+
+bool GetMediaStats(std::string& out_json) {
+  StatsWriter writer;
+  writer.BeginObject();
+
+  writer.BeginObject("samplepool");
+  SamplePool::Get(kSbMediaTypeAudio)->WriteStats("audio", writer);
+  SamplePool::Get(kSbMediaTypeVideo)->WriteStats("video", writer);
+  writer.EndObject();
+
+  WriteBufferBudgetStats(writer);
+
+  player::WriteStats(writer);
+
+  audio_sink::WriteStats(writer);
+
+  drm::WriteDrmMetaStats(writer);
+#if defined(HAS_OCDM)
+  drm::WriteDrmSystemStats(writer);
+  drm::WriteDecryptorStats(writer);
+#endif
+
+  writer.EndObject();
+  out_json = writer.str();
+  return true;
+}
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,66 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_MEDIA_STATS_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_MEDIA_STATS_H_
+
+#include <stdint.h>
+
+#include <string>
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+
+// Minimal JSON writer used by media components to report runtime statistics.
+class StatsWriter {
+ public:
+  void BeginObject(const char* name = nullptr);
+  void EndObject();
+  void BeginArray(const char* name = nullptr);
+  void EndArray();
+
+  void Add(const char* name, int value);
+  void Add(const char* name, unsigned int value);
+  void Add(const char* name, int64_t value);
+  void Add(const char* name, uint64_t value);
+  void Add(const char* name, double value);
+  void Add(const char* name, const char* value);
+  void AddBool(const char* name, bool value);
+
+  const std::string& str() const { return out_; }
+
+ private:
+  void Key(const char* name);
+
+  std::string out_;
+  bool need_comma_ { false };
+};
+
+// Serializes statistics of the media stack (sample pools, buffer budgets,
+// players, audio sinks, DRM) as a JSON object. Exposed through
+// SbRdkGetSetting("mediastats").
+bool GetMediaStats(std::string& out_json);
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_MEDIA_STATS_H_
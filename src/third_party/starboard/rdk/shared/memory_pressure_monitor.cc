@@ -0,0 +1,207 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/memory_pressure_monitor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "starboard/common/log.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace {
+
+// Tasks stalled on memory for 150ms within a 2s window. Unprivileged
+// processes may only create triggers with a window that is a multiple of 2s.
+const char kPsiTrigger[] = "some 150000 2000000";
+
+// While under pressure the state is rechecked every second. Pressure is
+// considered gone once no event came for |kQuietPeriod| and the 10s stall
+// average dropped below |kClearStallAverage| percent.
+const SbTime kRecheckInterval = kSbTimeSecond;
+const SbTime kQuietPeriod = 10 * kSbTimeSecond;
+const double kClearStallAverage = 1.0;
+
+// Returns the cgroup v2 path of the process, e.g. "/apps/cobalt", empty for
+// the root group or a v1 only hierarchy.
+std::string GetCgroupV2Path() {
+  std::string path;
+  FILE* cgroup = fopen("/proc/self/cgroup", "r");
+  if (!cgroup)
+    return path;
+
+  char* buffer = nullptr;
+  size_t size = 0;
+  while (getline(&buffer, &size, cgroup) != -1) {
+    if (strncmp(buffer, "0::", 3) == 0) {
+      path = buffer + 3;
+      while (!path.empty() && (path.back() == '\n' || path.back() == '/'))
+        path.pop_back();
+      break;
+    }
+  }
+  free(buffer);
+  fclose(cgroup);
+  return path;
+}
+
+ssize_t ReadFromStart(int fd, char* buffer, size_t size) {
+  if (lseek(fd, 0, SEEK_SET) == -1)
+    return -1;
+  ssize_t length = read(fd, buffer, size - 1);
+  buffer[length > 0 ? length : 0] = '\0';
+  return length;
+}
+
+void SetTimer(int fd, SbTime interval) {
+  struct itimerspec timeout = {};
+  timeout.it_value.tv_sec = interval / kSbTimeSecond;
+  timeout.it_value.tv_nsec =
+      (interval % kSbTimeSecond) * kSbTimeNanosecondsPerMicrosecond;
+  timeout.it_interval = timeout.it_value;
+  timerfd_settime(fd, 0, &timeout, NULL);
+}
+
+}  // namespace
+
+MemoryPressureMonitor::MemoryPressureMonitor(Handler handler)
+    : handler_(handler) {
+  std::string cgroup = GetCgroupV2Path();
+  std::string cgroup_dir = "/sys/fs/cgroup" + cgroup;
+  if ((!cgroup.empty() &&
+       OpenPsiTrigger((cgroup_dir + "/memory.pressure").c_str())) ||
+      OpenPsiTrigger("/proc/pressure/memory") ||
+      (!cgroup.empty() &&
+       OpenMemoryEvents((cgroup_dir + "/memory.events").c_str()))) {
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (timer_fd_ == -1) {
+      SB_LOG(ERROR) << "Failed to create timerfd, error: " << errno << " ("
+                    << strerror(errno) << ')';
+    }
+  } else {
+    SB_LOG(INFO) << "Memory pressure monitoring is not available";
+  }
+}
+
+MemoryPressureMonitor::~MemoryPressureMonitor() {
+  if (event_fd_ != -1)
+    close(event_fd_);
+  if (timer_fd_ != -1)
+    close(timer_fd_);
+}
+
+bool MemoryPressureMonitor::OpenPsiTrigger(const char* path) {
+  int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd == -1)
+    return false;
+  if (write(fd, kPsiTrigger, strlen(kPsiTrigger) + 1) < 0) {
+    SB_LOG(INFO) << "Cannot set PSI trigger on " << path << ", error: "
+                 << errno << " (" << strerror(errno) << ')';
+    close(fd);
+    return false;
+  }
+  SB_LOG(INFO) << "Monitoring memory pressure with " << path;
+  event_fd_ = fd;
+  source_ = kSourcePsi;
+  return true;
+}
+
+bool MemoryPressureMonitor::OpenMemoryEvents(const char* path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return false;
+  SB_LOG(INFO) << "Monitoring memory pressure with " << path;
+  event_fd_ = fd;
+  source_ = kSourceMemoryEvents;
+  event_count_ = ReadMemoryEventCount();
+  return true;
+}
+
+int64_t MemoryPressureMonitor::ReadMemoryEventCount() {
+  char buffer[512];
+  if (ReadFromStart(event_fd_, buffer, sizeof(buffer)) <= 0)
+    return event_count_;
+
+  // "low" only tells that the group is below its protection, not counted.
+  int64_t count = 0;
+  char* save = nullptr;
+  for (char* line = strtok_r(buffer, "\n", &save); line;
+       line = strtok_r(nullptr, "\n", &save)) {
+    char name[32];
+    long long value = 0;
+    if (sscanf(line, "%31s %lld", name, &value) != 2)
+      continue;
+    if (!strcmp(name, "high") || !strcmp(name, "max") || !strcmp(name, "oom"))
+      count += value;
+  }
+  return count;
+}
+
+double MemoryPressureMonitor::ReadStallAverage() {
+  char buffer[256];
+  double average = 0;
+  if (ReadFromStart(event_fd_, buffer, sizeof(buffer)) > 0)
+    sscanf(buffer, "some avg10=%lf", &average);
+  return average;
+}
+
+void MemoryPressureMonitor::OnEvent() {
+  if (source_ == kSourceMemoryEvents) {
+    int64_t count = ReadMemoryEventCount();
+    if (count <= event_count_)
+      return;
+    event_count_ = count;
+  }
+
+  last_event_time_ = SbTimeGetMonotonicNow();
+  if (!under_pressure_)
+    SetUnderPressure(true);
+}
+
+void MemoryPressureMonitor::OnTimer() {
+  if (!under_pressure_)
+    return;
+  if (SbTimeGetMonotonicNow() - last_event_time_ < kQuietPeriod)
+    return;
+  if (source_ == kSourcePsi && ReadStallAverage() >= kClearStallAverage)
+    return;
+  SetUnderPressure(false);
+}
+
+void MemoryPressureMonitor::SetUnderPressure(bool under_pressure) {
+  under_pressure_ = under_pressure;
+  if (timer_fd_ != -1)
+    SetTimer(timer_fd_, under_pressure ? kRecheckInterval : 0);
+  SB_LOG(INFO) << "Memory pressure "
+               << (under_pressure ? "detected" : "cleared");
+  handler_(under_pressure);
+}
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,79 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_MEMORY_PRESSURE_MONITOR_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_MEMORY_PRESSURE_MONITOR_H_
+
+#include <stdint.h>
+
+#include <functional>
+
+#include "starboard/time.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+
+// Watches memory pressure of the process' cgroup, or of the whole system,
+// from the event loop. Sources, in order of preference:
+//   - a PSI trigger on the cgroup v2 "memory.pressure" file,
+//   - a PSI trigger on /proc/pressure/memory,
+//   - "high", "max" and "oom" events of the cgroup v2 "memory.events" file.
+// The handler is called with true on the first event, and with false once
+// no event came for a while and, with PSI, the stall average settled.
+class MemoryPressureMonitor {
+ public:
+  typedef std::function<void(bool under_pressure)> Handler;
+
+  explicit MemoryPressureMonitor(Handler handler);
+  ~MemoryPressureMonitor();
+
+  // Polled for POLLPRI, -1 if no source is available.
+  int GetEventFd() const { return event_fd_; }
+  // Polled for POLLIN, armed while under pressure.
+  int GetTimerFd() const { return timer_fd_; }
+
+  void OnEvent();
+  void OnTimer();
+
+  bool IsUnderPressure() const { return under_pressure_; }
+
+ private:
+  enum Source { kSourceNone, kSourcePsi, kSourceMemoryEvents };
+
+  bool OpenPsiTrigger(const char* path);
+  bool OpenMemoryEvents(const char* path);
+  int64_t ReadMemoryEventCount();
+  double ReadStallAverage();
+  void SetUnderPressure(bool under_pressure);
+
+  Handler handler_;
+  Source source_ { kSourceNone };
+  int event_fd_ { -1 };
+  int timer_fd_ { -1 };
+  int64_t event_count_ { 0 };
+  bool under_pressure_ { false };
+  SbTimeMonotonic last_event_time_ { 0 };
+};
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_MEMORY_PRESSURE_MONITOR_H_
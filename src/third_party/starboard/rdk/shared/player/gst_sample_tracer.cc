@@ -0,0 +1,283 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#include "third_party/starboard/rdk/shared/player/gst_sample_tracer.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "third_party/starboard/rdk/shared/drm/gst_decryptor_ocdm.h"
+#include "third_party/starboard/rdk/shared/media/media_stats.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace player {
+namespace {
+
+GST_DEBUG_CATEGORY(cobalt_gst_sample_tracer_debug);
+#define GST_CAT_DEFAULT cobalt_gst_sample_tracer_debug
+
+// Samples which never reach the sink (e.g. dropped by the decoder) are
+// forgotten once this many newer ones are in flight.
+const size_t kMaxRecordsPerStream = 1024;
+
+const char* kStreamNames[] = { "audio", "video" };
+const char* kStageNames[] = { "appsrc", "decrypt", "decode", "render" };
+
+int StreamIndex(SbMediaType type) {
+  return type == kSbMediaTypeVideo ? 1 : 0;
+}
+
+}  // namespace
+
+// static
+bool SampleTracer::IsEnabled() {
+  static const bool enabled = !!getenv("COBALT_ENABLE_SAMPLE_TRACING");
+  return enabled;
+}
+
+void SampleTracer::Histogram::Add(SbTime value) {
+  if (value < 0)
+    value = 0;
+  int bucket = 0;
+  while (bucket < kBuckets - 1 && (static_cast<SbTime>(2) << bucket) <= value)
+    ++bucket;
+  ++buckets[bucket];
+  ++count;
+  total += value;
+  if (value > max)
+    max = value;
+}
+
+void SampleTracer::Histogram::Write(const char* name, media::StatsWriter& writer) const {
+  writer.BeginObject(name);
+  writer.Add("count", count);
+  writer.Add("avgus", count ? static_cast<double>(total) / count : .0);
+  writer.Add("maxus", static_cast<int64_t>(max));
+  // Bucket i counts latencies in [2^i, 2^(i+1)) microseconds, the first one
+  // also counts 0 and the last one everything above.
+  writer.BeginArray("log2buckets");
+  for (int i = 0; i < kBuckets; ++i)
+    writer.Add(nullptr, buckets[i]);
+  writer.EndArray();
+  writer.EndObject();
+}
+
+SampleTracer::SampleTracer() {
+  GST_DEBUG_CATEGORY_INIT(cobalt_gst_sample_tracer_debug, "gstsampletracer", 0,
+                          "Cobalt sample tracer");
+  for (Stream& stream : streams_)
+    gst_segment_init(&stream.segment, GST_FORMAT_TIME);
+}
+
+SampleTracer::~SampleTracer() {}
+
+void SampleTracer::OnSampleWritten(SbMediaType type, uint64_t serial, GstClockTime pts) {
+  if (!GST_CLOCK_TIME_IS_VALID(pts))
+    return;
+
+  ::starboard::ScopedLock lock(mutex_);
+  Stream& stream = streams_[StreamIndex(type)];
+  Record& record = stream.records[serial];
+  record.pts = pts;
+  record.written = SbTimeGetMonotonicNow();
+  stream.serial_by_pts[pts] = serial;
+
+  if (stream.records.size() > kMaxRecordsPerStream) {
+    auto oldest = stream.records.begin();
+    stream.serial_by_pts.erase(oldest->second.pts);
+    stream.records.erase(oldest);
+    ++stream.dropped;
+  }
+}
+
+void SampleTracer::TraceSource(SbMediaType type, GstElement* appsrc) {
+  int stream = StreamIndex(type);
+  GstPad* src_pad = gst_element_get_static_pad(appsrc, "src");
+  if (!src_pad)
+    return;
+  AddProbe(src_pad, stream, kProbeAppSrcOut);
+
+  GstPad* peer_pad = gst_pad_get_peer(src_pad);
+  GstElement* peer = peer_pad ? gst_pad_get_parent_element(peer_pad) : nullptr;
+  if (peer && drm::IsDecryptorElement(peer)) {
+    GstPad* sink_pad = gst_element_get_static_pad(peer, "sink");
+    GstPad* decrypted_pad = gst_element_get_static_pad(peer, "src");
+    AddProbe(sink_pad, stream, kProbeDecryptIn);
+    AddProbe(decrypted_pad, stream, kProbeDecryptOut);
+    gst_object_unref(sink_pad);
+    gst_object_unref(decrypted_pad);
+  }
+
+  if (peer)
+    gst_object_unref(peer);
+  if (peer_pad)
+    gst_object_unref(peer_pad);
+  gst_object_unref(src_pad);
+}
+
+void SampleTracer::TraceSink(GstElement* sink) {
+  const gchar* klass = gst_element_class_get_metadata(
+      GST_ELEMENT_GET_CLASS(sink), GST_ELEMENT_METADATA_KLASS);
+  int stream = -1;
+  if (klass && strstr(klass, "Video"))
+    stream = StreamIndex(kSbMediaTypeVideo);
+  else if (klass && strstr(klass, "Audio"))
+    stream = StreamIndex(kSbMediaTypeAudio);
+  if (stream < 0)
+    return;
+
+  GstPad* sink_pad = gst_element_get_static_pad(sink, "sink");
+  if (!sink_pad)
+    return;
+  GST_DEBUG_OBJECT(sink, "Tracing %s samples", kStreamNames[stream]);
+  AddProbe(sink_pad, stream, kProbeSink);
+  gst_object_unref(sink_pad);
+}
+
+void SampleTracer::Reset() {
+  ::starboard::ScopedLock lock(mutex_);
+  for (Stream& stream : streams_) {
+    stream.records.clear();
+    stream.serial_by_pts.clear();
+  }
+}
+
+void SampleTracer::WriteStats(media::StatsWriter& writer) {
+  ::starboard::ScopedLock lock(mutex_);
+  writer.BeginObject("tracing");
+  for (int i = 0; i < 2; ++i) {
+    const Stream& stream = streams_[i];
+    writer.BeginObject(kStreamNames[i]);
+    writer.Add("inflight", static_cast<uint64_t>(stream.records.size()));
+    writer.Add("dropped", stream.dropped);
+    for (int stage = 0; stage < kStageCount; ++stage)
+      stream.histograms[stage].Write(kStageNames[stage], writer);
+    writer.EndObject();
+  }
+  writer.EndObject();
+}
+
+void SampleTracer::AddProbe(GstPad* pad, int stream, ProbePoint point) {
+  if (!pad)
+    return;
+  GstPadProbeType type = static_cast<GstPadProbeType>(
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST);
+  if (point == kProbeSink)
+    type = static_cast<GstPadProbeType>(type | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM);
+  gst_pad_add_probe(pad, type, &SampleTracer::OnProbe,
+                    new Probe { this, stream, point },
+                    [](gpointer data) { delete static_cast<Probe*>(data); });
+}
+
+// static
+GstPadProbeReturn SampleTracer::OnProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+  Probe* probe = static_cast<Probe*>(user_data);
+  SampleTracer* self = probe->tracer;
+
+  if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+    if (GST_EVENT_TYPE(event) == GST_EVENT_SEGMENT) {
+      const GstSegment* segment = nullptr;
+      gst_event_parse_segment(event, &segment);
+      ::starboard::ScopedLock lock(self->mutex_);
+      gst_segment_copy_into(segment, &self->streams_[probe->stream].segment);
+    }
+  } else if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList* list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+    guint length = gst_buffer_list_length(list);
+    for (guint i = 0; i < length; ++i)
+      self->OnBuffer(pad, probe->stream, probe->point, gst_buffer_list_get(list, i));
+  } else if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    self->OnBuffer(pad, probe->stream, probe->point, GST_PAD_PROBE_INFO_BUFFER(info));
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+void SampleTracer::OnBuffer(GstPad* pad, int stream_index, ProbePoint point, GstBuffer* buffer) {
+  GstClockTime pts = GST_BUFFER_PTS(buffer);
+  if (!GST_CLOCK_TIME_IS_VALID(pts))
+    return;
+
+  SbTimeMonotonic now = SbTimeGetMonotonicNow();
+
+  // Pipeline clock time, needed to tell how long the sink holds the buffer.
+  GstClockTime clock_now = GST_CLOCK_TIME_NONE;
+  GstClockTime base_time = GST_CLOCK_TIME_NONE;
+  if (point == kProbeSink) {
+    GstElement* sink = gst_pad_get_parent_element(pad);
+    if (sink) {
+      GstClock* clock = gst_element_get_clock(sink);
+      if (clock) {
+        clock_now = gst_clock_get_time(clock);
+        base_time = gst_element_get_base_time(sink);
+        gst_object_unref(clock);
+      }
+      gst_object_unref(sink);
+    }
+  }
+
+  ::starboard::ScopedLock lock(mutex_);
+  Stream& stream = streams_[stream_index];
+  auto serial = stream.serial_by_pts.find(pts);
+  if (serial == stream.serial_by_pts.end())
+    return;
+  auto it = stream.records.find(serial->second);
+  if (it == stream.records.end())
+    return;
+  Record& record = it->second;
+
+  switch (point) {
+    case kProbeAppSrcOut:
+      record.left_source = now;
+      stream.histograms[kStageAppSrc].Add(now - record.written);
+      break;
+    case kProbeDecryptIn:
+      record.decrypt_in = now;
+      break;
+    case kProbeDecryptOut:
+      if (record.decrypt_in)
+        stream.histograms[kStageDecrypt].Add(now - record.decrypt_in);
+      record.left_source = now;
+      break;
+    case kProbeSink: {
+      if (record.left_source)
+        stream.histograms[kStageDecode].Add(now - record.left_source);
+      guint64 running_time = gst_segment_to_running_time(&stream.segment, GST_FORMAT_TIME, pts);
+      if (GST_CLOCK_TIME_IS_VALID(running_time) && GST_CLOCK_TIME_IS_VALID(clock_now)) {
+        gint64 wait_ns = static_cast<gint64>(running_time + base_time) -
+                         static_cast<gint64>(clock_now);
+        stream.histograms[kStageRender].Add(wait_ns / kSbTimeNanosecondsPerMicrosecond);
+      }
+      GST_TRACE("%s sample id:%" G_GUINT64_FORMAT " %" GST_TIME_FORMAT
+                " reached the sink after %" PRId64 " us",
+                kStreamNames[stream_index], it->first, GST_TIME_ARGS(pts),
+                now - record.written);
+      stream.serial_by_pts.erase(serial);
+      stream.records.erase(it);
+      break;
+    }
+  }
+}
+
+}  // namespace player
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
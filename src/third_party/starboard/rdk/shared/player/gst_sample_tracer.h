@@ -0,0 +1,132 @@
+//
+// Copyright 2022 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_GST_SAMPLE_TRACER_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_GST_SAMPLE_TRACER_H_
+
+#include <gst/gst.h>
+
+#include <map>
+#include <unordered_map>
+
+#include "starboard/common/mutex.h"
+#include "starboard/media.h"
+#include "starboard/time.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+class StatsWriter;
+}  // namespace media
+
+namespace player {
+
+// Per-sample latency tracing, enabled with COBALT_ENABLE_SAMPLE_TRACING.
+//
+// Every sample written by Cobalt is recorded under its serial id. Pad probes
+// on the appsrc, around the decryptor and on the sinks add the time the
+// sample left each stage. Decoded buffers are matched back to the sample by
+// their PTS. The stage latencies are aggregated into per stream log2
+// histograms:
+//  - appsrc:  SbPlayerWriteSample() -> leaving appsrc,
+//  - decrypt: decryptor sink pad -> decryptor src pad,
+//  - decode:  leaving appsrc / decryptor -> reaching the sink,
+//  - render:  reaching the sink -> scheduled presentation time.
+class SampleTracer {
+ public:
+  static bool IsEnabled();
+
+  SampleTracer();
+  ~SampleTracer();
+
+  void OnSampleWritten(SbMediaType type, uint64_t serial, GstClockTime pts);
+
+  // Installs probes on |appsrc| and on the decryptor linked to it, if any.
+  void TraceSource(SbMediaType type, GstElement* appsrc);
+  // Installs a probe on the sink pad of |sink| if it is an audio or video sink.
+  void TraceSink(GstElement* sink);
+
+  // Drops samples in flight, e.g. on flushing seek.
+  void Reset();
+
+  void WriteStats(media::StatsWriter& writer);
+
+ private:
+  enum Stage {
+    kStageAppSrc,
+    kStageDecrypt,
+    kStageDecode,
+    kStageRender,
+    kStageCount,
+  };
+
+  enum ProbePoint {
+    kProbeAppSrcOut,
+    kProbeDecryptIn,
+    kProbeDecryptOut,
+    kProbeSink,
+  };
+
+  struct Histogram {
+    static constexpr int kBuckets = 24;
+
+    void Add(SbTime value);
+    void Write(const char* name, media::StatsWriter& writer) const;
+
+    uint64_t buckets[kBuckets] {};
+    uint64_t count { 0 };
+    uint64_t total { 0 };
+    SbTime max { 0 };
+  };
+
+  struct Record {
+    GstClockTime pts { GST_CLOCK_TIME_NONE };
+    SbTimeMonotonic written { 0 };
+    SbTimeMonotonic left_source { 0 };
+    SbTimeMonotonic decrypt_in { 0 };
+  };
+
+  struct Stream {
+    std::map<uint64_t, Record> records;
+    std::unordered_map<GstClockTime, uint64_t> serial_by_pts;
+    Histogram histograms[kStageCount];
+    GstSegment segment;
+    uint64_t dropped { 0 };
+  };
+
+  struct Probe {
+    SampleTracer* tracer;
+    int stream;
+    ProbePoint point;
+  };
+
+  static GstPadProbeReturn OnProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+  void AddProbe(GstPad* pad, int stream, ProbePoint point);
+  void OnBuffer(GstPad* pad, int stream, ProbePoint point, GstBuffer* buffer);
+
+  ::starboard::Mutex mutex_;
+  Stream streams_[2];
+};
+
+}  // namespace player
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_GST_SAMPLE_TRACER_H_
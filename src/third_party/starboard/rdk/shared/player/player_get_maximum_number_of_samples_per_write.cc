@@ -35,7 +35,7 @@
 
 #if SB_API_VERSION >= 10
 int SbPlayerGetMaximumNumberOfSamplesPerWrite(SbPlayer player,
-                                              SbMediaType /*sample_type*/) {
-  return player->MaxNumberOfSamplesPerWrite();
+                                              SbMediaType sample_type) {
+  return player->MaxNumberOfSamplesPerWrite(sample_type);
 }
 #endif  // SB_API_VERSION >= 10
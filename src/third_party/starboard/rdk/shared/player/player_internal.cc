@@ -16,21 +16,28 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "third_party/starboard/rdk/shared/player/player_internal.h"
 
+#include <errno.h>
 #include <inttypes.h>
 #include <stdint.h>
 #include <math.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <gst/app/gstappsrc.h>
 #include <gst/audio/streamvolume.h>
-#include <gst/base/gstbytewriter.h>
 #include <gst/gst.h>
 #include <gst/base/gstflowcombiner.h>
 #include <gst/video/video.h>
 #include <gst/base/gstbasetransform.h>
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <algorithm>
 #include <cstring>
@@ -38,13 +45,18 @@
 #include "starboard/once.h"
 #include "starboard/common/mutex.h"
 #include "starboard/common/condition_variable.h"
+#include "starboard/common/log.h"
 #include "starboard/thread.h"
 #include "starboard/time.h"
 #include "starboard/memory.h"
 #include "starboard/drm.h"
 #include "third_party/starboard/rdk/shared/media/gst_media_utils.h"
+#include "third_party/starboard/rdk/shared/media/gst_sample_pool.h"
+#include "third_party/starboard/rdk/shared/media/media_stats.h"
 #include "third_party/starboard/rdk/shared/hang_detector.h"
+#include "third_party/starboard/rdk/shared/player/gst_sample_tracer.h"
 #include "third_party/starboard/rdk/shared/drm/gst_decryptor_ocdm.h"
+#include "third_party/starboard/rdk/shared/drm/gst_drm_meta.h"
 
 namespace third_party {
 namespace starboard {
@@ -52,17 +64,104 @@ namespace rdk {
 namespace shared {
 namespace player {
 
-static constexpr int kMaxNumberOfSamplesPerWrite = 1;
+// Audio frames are short (~21ms for AAC/Opus) so batching them amortizes the
+// per-write cost, video stays at one sample per write to keep latency low.
+static constexpr int kDefaultMaxNumberOfAudioSamplesPerWrite = 8;
+static constexpr int kDefaultMaxNumberOfVideoSamplesPerWrite = 1;
+static constexpr int kMaxNumberOfSamplesPerWriteLimit = 64;
 static const char kCustomInstantRateChangeEventName[] = "custom-instant-rate-change";
 static const char kDidReceiveFirstSegmentMsgName[] = "did-receive-first-segment";
 
+// Reads an integer knob from the environment. Garbage keeps |default_value|,
+// values outside [min_value, max_value] are clamped, both get logged.
+static int64_t ReadEnvInt(const char* name,
+                          int64_t default_value,
+                          int64_t min_value,
+                          int64_t max_value) {
+  const char* env = getenv(name);
+  if (!env)
+    return default_value;
+  char* end = nullptr;
+  long long value = strtoll(env, &end, 10);
+  if (end == env || *end != '\0') {
+    SB_LOG(WARNING) << "Ignoring invalid " << name << "=" << env;
+    return default_value;
+  }
+  if (value < min_value || value > max_value) {
+    int64_t clamped = value < min_value ? min_value : max_value;
+    SB_LOG(WARNING) << "Clamping " << name << "=" << env << " to " << clamped;
+    return clamped;
+  }
+  return value;
+}
+
+// Reads a positive number from the environment, anything else keeps
+// |default_value| with a warning.
+static double ReadEnvPositive(const char* name, double default_value) {
+  const char* env = getenv(name);
+  if (!env)
+    return default_value;
+  char* end = nullptr;
+  double value = strtod(env, &end);
+  // Written so that NaN fails too.
+  if (end == env || *end != '\0' || !(value > .0) || isinf(value)) {
+    SB_LOG(WARNING) << "Ignoring invalid " << name << "=" << env;
+    return default_value;
+  }
+  return value;
+}
+
+// Samples are decrypted on the appsrc streaming thread into a bounded queue,
+// whose thread feeds the decoder. The depth is how far decryption may run
+// ahead, COBALT_DECRYPT_LOOKAHEAD_BUFFERS tunes it for slow TEEs.
+static constexpr int kDefaultDecryptLookaheadBuffers = 60;
+static constexpr int kMaxDecryptLookaheadBuffers = 512;
+
+static int GetDecryptLookaheadBuffers() {
+  static const int kLookaheadBuffers = static_cast<int>(
+      ReadEnvInt("COBALT_DECRYPT_LOOKAHEAD_BUFFERS", kDefaultDecryptLookaheadBuffers,
+                 1, kMaxDecryptLookaheadBuffers));
+  return kLookaheadBuffers;
+}
+
+// With COBALT_DECRYPT_ASYNC_BUFFERS > 0 the decryptor hands samples to its
+// own worker thread, so the appsrc thread can queue that many more while a
+// slow TEE call is in progress. Off by default.
+static constexpr int kMaxDecryptAsyncBuffers = 64;
+
+static int GetDecryptAsyncBuffers() {
+  static const int kAsyncBuffers = static_cast<int>(
+      ReadEnvInt("COBALT_DECRYPT_ASYNC_BUFFERS", 0, 0, kMaxDecryptAsyncBuffers));
+  return kAsyncBuffers;
+}
+
+static int GetMaxNumberOfSamplesPerWriteFromEnv(const char* name, int default_value) {
+  const char* env = getenv(name);
+  if (!env)
+    return default_value;
+  int value = atoi(env);
+  if (value < 1 || value > kMaxNumberOfSamplesPerWriteLimit) {
+    SB_LOG(WARNING) << "Ignoring invalid " << name << "=" << env;
+    return default_value;
+  }
+  return value;
+}
+
 // static
-int Player::MaxNumberOfSamplesPerWrite() {
-  return kMaxNumberOfSamplesPerWrite;
+int Player::MaxNumberOfSamplesPerWrite(SbMediaType sample_type) {
+  static const int kMaxAudioSamples = GetMaxNumberOfSamplesPerWriteFromEnv(
+      "COBALT_MAX_AUDIO_SAMPLES_PER_WRITE", kDefaultMaxNumberOfAudioSamplesPerWrite);
+  static const int kMaxVideoSamples = GetMaxNumberOfSamplesPerWriteFromEnv(
+      "COBALT_MAX_VIDEO_SAMPLES_PER_WRITE", kDefaultMaxNumberOfVideoSamplesPerWrite);
+  return sample_type == kSbMediaTypeVideo ? kMaxVideoSamples : kMaxAudioSamples;
 }
 
+using third_party::starboard::rdk::shared::drm::AddDrmMeta;
 using third_party::starboard::rdk::shared::drm::CreateDecryptorElement;
+using third_party::starboard::rdk::shared::drm::SetDecryptorAsyncBuffers;
+using third_party::starboard::rdk::shared::drm::SetDecryptorLookaheadQueue;
 using third_party::starboard::rdk::shared::media::CodecToGstCaps;
+using third_party::starboard::rdk::shared::media::SamplePool;
 
 // **************************** GST/GLIB Helpers **************************** //
 
@@ -80,16 +179,15 @@ GST_DEBUG_CATEGORY(cobalt_gst_player_debug);
 static void PrintGstCaps(GstCaps* caps);
 static GstElement* CreatePayloader();
 
-static GSourceFuncs SourceFunctions = {
+// Dispatched whenever the attached unix fd becomes readable or the ready time
+// of the source expires.
+static GSourceFuncs FdSourceFunctions = {
     // prepare
     nullptr,
     // check
     nullptr,
     // dispatch
     [](GSource* source, GSourceFunc callback, gpointer userData) -> gboolean {
-      if (g_source_get_ready_time(source) == -1)
-        return G_SOURCE_CONTINUE;
-      g_source_set_ready_time(source, -1);
       return callback(userData);
     },
     // finalize
@@ -411,6 +509,8 @@ void gst_cobalt_src_setup_and_add_app_src(SbMediaType media_type,
   if (decryptor) {
     GST_DEBUG("Injecting decryptor element %" GST_PTR_FORMAT, decryptor);
 
+    // Before the state sync, the worker is started with the element.
+    SetDecryptorAsyncBuffers(decryptor, GetDecryptAsyncBuffers());
     gst_bin_add(GST_BIN(element), decryptor);
     gst_element_sync_state_with_parent(decryptor);
     gst_element_link(src_elem, decryptor);
@@ -434,11 +534,13 @@ void gst_cobalt_src_setup_and_add_app_src(SbMediaType media_type,
     GstElement* queue = gst_element_factory_make("queue", nullptr);
     g_object_set (
       G_OBJECT (queue),
-      "max-size-buffers", 60,
+      "max-size-buffers", GetDecryptLookaheadBuffers(),
       "max-size-bytes", 0,
       "max-size-time", (gint64) 0,
       "silent", TRUE,
       nullptr);
+    if (decryptor)
+      SetDecryptorLookaheadQueue(decryptor, queue);
     gst_bin_add(GST_BIN(element), queue);
     gst_element_sync_state_with_parent(queue);
     gst_element_link(src_elem, queue);
@@ -916,8 +1018,6 @@ static GstElement* CreatePayloader() {
 // ********************************* Player ******************************** //
 namespace {
 
-const int kMaxIvSize = 16;
-
 enum class MediaType {
   kNone = 0,
   kAudio = 1,
@@ -925,10 +1025,80 @@ enum class MediaType {
   kBoth = kAudio | kVideo
 };
 
-struct Task {
-  virtual ~Task() {}
-  virtual void Do() = 0;
-  virtual void PrintInfo() = 0;
+// How often the player thread refreshes the playback state returned by
+// GetInfo(). In between, GetInfo() extrapolates the position, but never by
+// more than kMaxPositionExtrapolation.
+constexpr SbTime kPlaybackStateInterval = 100 * kSbTimeMillisecond;
+constexpr SbTime kMaxPositionExtrapolation = 2 * kPlaybackStateInterval;
+
+struct PlaybackState {
+  gint64 position_ns { 0 };
+  gint64 duration_ns { static_cast<gint64>(GST_CLOCK_TIME_NONE) };
+  SbTimeMonotonic updated_at { 0 };
+  double rate { 1. };
+  bool is_paused { true };
+  bool is_seeking { false };
+  int dropped_video_frames { 0 };
+  int total_video_frames { 0 };
+  // Bumped by every seek, so a refresh that started before the seek cannot
+  // overwrite the seek position.
+  uint64_t epoch { 0 };
+};
+
+// Single writer (serialized by the caller), many readers sequence lock.
+// Readers never block, they retry if they raced with a writer.
+class PlaybackStateSnapshot {
+ public:
+  void Store(const PlaybackState& state) {
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    position_ns_.store(state.position_ns, std::memory_order_relaxed);
+    duration_ns_.store(state.duration_ns, std::memory_order_relaxed);
+    updated_at_.store(state.updated_at, std::memory_order_relaxed);
+    rate_.store(state.rate, std::memory_order_relaxed);
+    is_paused_.store(state.is_paused, std::memory_order_relaxed);
+    is_seeking_.store(state.is_seeking, std::memory_order_relaxed);
+    dropped_video_frames_.store(state.dropped_video_frames, std::memory_order_relaxed);
+    total_video_frames_.store(state.total_video_frames, std::memory_order_relaxed);
+    epoch_.store(state.epoch, std::memory_order_relaxed);
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  PlaybackState Load() const {
+    PlaybackState state;
+    uint32_t sequence = 0;
+    do {
+      sequence = sequence_.load(std::memory_order_acquire);
+      if (sequence & 1)
+        continue;
+      state.position_ns = position_ns_.load(std::memory_order_relaxed);
+      state.duration_ns = duration_ns_.load(std::memory_order_relaxed);
+      state.updated_at = updated_at_.load(std::memory_order_relaxed);
+      state.rate = rate_.load(std::memory_order_relaxed);
+      state.is_paused = is_paused_.load(std::memory_order_relaxed);
+      state.is_seeking = is_seeking_.load(std::memory_order_relaxed);
+      state.dropped_video_frames = dropped_video_frames_.load(std::memory_order_relaxed);
+      state.total_video_frames = total_video_frames_.load(std::memory_order_relaxed);
+      state.epoch = epoch_.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) || sequence != sequence_.load(std::memory_order_relaxed));
+    return state;
+  }
+
+  uint64_t Epoch() const { return epoch_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint32_t> sequence_ { 0 };
+  std::atomic<gint64> position_ns_ { 0 };
+  std::atomic<gint64> duration_ns_ { static_cast<gint64>(GST_CLOCK_TIME_NONE) };
+  std::atomic<SbTimeMonotonic> updated_at_ { 0 };
+  std::atomic<double> rate_ { 1. };
+  std::atomic<bool> is_paused_ { true };
+  std::atomic<bool> is_seeking_ { false };
+  std::atomic<int> dropped_video_frames_ { 0 };
+  std::atomic<int> total_video_frames_ { 0 };
+  std::atomic<uint64_t> epoch_ { 0 };
 };
 
 static const char* PlayerStateToStr(SbPlayerState state) {
@@ -953,129 +1123,277 @@ static const char* DecoderStateToStr(SbPlayerDecoderState state) {
     return "unknown";
 }
 
-class PlayerStatusTask : public Task {
+// Bounded multi-producer single-consumer queue (D. Vyukov's bounded queue),
+// |N| must be a power of two. Push never allocates and never blocks, it fails
+// when the queue is full.
+template <typename T, size_t N>
+class BoundedMpscQueue {
  public:
-  PlayerStatusTask(SbPlayerStatusFunc func,
-                   SbPlayer player,
-                   int ticket,
-                   void* ctx,
-                   SbPlayerState state) {
-    this->func_ = func;
-    this->player_ = player;
-    this->ticket_ = ticket;
-    this->ctx_ = ctx;
-    this->state_ = state;
+  static_assert(N > 1 && (N & (N - 1)) == 0, "N must be a power of two");
+
+  BoundedMpscQueue() {
+    for (size_t i = 0; i < N; ++i)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
   }
 
-  ~PlayerStatusTask() override {}
+  BoundedMpscQueue(const BoundedMpscQueue&) = delete;
+  BoundedMpscQueue& operator=(const BoundedMpscQueue&) = delete;
+
+  bool TryPush(const T& value) {
+    Cell* cell = nullptr;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos & (N - 1)];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = value;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
 
-  void Do() override { func_(player_, ctx_, state_, ticket_); }
+  // Must only be called from the consumer thread.
+  bool TryPop(T& value) {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Cell& cell = cells_[pos & (N - 1)];
+    size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1) < 0)
+      return false;
+    value = cell.value;
+    cell.sequence.store(pos + N, std::memory_order_release);
+    dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
 
-  void PrintInfo() override {
-    GST_TRACE("PlayerStatusTask state:%d (%s), ticket:%d", state_, PlayerStateToStr(state_), ticket_);
+  // Approximate when called concurrently with push or pop.
+  size_t Size() const {
+    size_t enqueued = enqueue_pos_.load(std::memory_order_relaxed);
+    size_t dequeued = dequeue_pos_.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
   }
 
  private:
-  SbPlayerStatusFunc func_;
-  SbPlayer player_;
-  int ticket_;
-  void* ctx_;
-  SbPlayerState state_;
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  Cell cells_[N];
+  std::atomic<size_t> enqueue_pos_ { 0 };
+  std::atomic<size_t> dequeue_pos_ { 0 };
 };
 
-class PlayerDestroyedTask : public PlayerStatusTask {
- public:
-  PlayerDestroyedTask(SbPlayerStatusFunc func,
-                      SbPlayer player,
-                      int ticket,
-                      void* ctx,
-                      GMainLoop* loop)
-      : PlayerStatusTask(func, player, ticket, ctx, kSbPlayerStateDestroyed) {
-    this->loop_ = loop;
-  }
+// Cobalt callback to be run on the player thread.
+struct DispatchItem {
+  enum class Type {
+    kPlayerStatus,
+    kPlayerDestroyed,
+    kDecoderStatus,
+    kPlayerError,
+  };
+
+  static constexpr size_t kMaxMessageSize = 256;
+
+  Type type;
+  int ticket;
+  SbPlayerState player_state;
+  SbPlayerDecoderState decoder_state;
+  MediaType media;
+  SbPlayerError error;
+  // Truncated to fit.
+  char message[kMaxMessageSize];
+  SbTimeMonotonic queued_at;
+};
 
-  ~PlayerDestroyedTask() override {}
+struct LatencyStats {
+  uint64_t count { 0 };
+  SbTime total { 0 };
+  SbTime max { 0 };
 
-  void Do() override {
-    PlayerStatusTask::Do();
-    g_main_loop_quit(loop_);
+  void Add(SbTime duration) {
+    ++count;
+    total += duration;
+    max = std::max(max, duration);
   }
 
-  void PrintInfo() override {
-    GST_TRACE("PlayerDestroyedTask: START");
-    PlayerStatusTask::PrintInfo();
-    GST_TRACE("PlayerDestroyedTask: END");
+  void Write(media::StatsWriter& writer, const char* name) const {
+    writer.BeginObject(name);
+    writer.Add("count", count);
+    writer.Add("avgus", count ? static_cast<double>(total) / count : .0);
+    writer.Add("maxus", static_cast<int64_t>(max));
+    writer.EndObject();
   }
-
- private:
-  GMainLoop* loop_;
 };
 
-class DecoderStatusTask : public Task {
+// Decides when to pause for rebuffering and when to resume, from how far
+// the written data runs ahead of the playback position. Resuming waits for
+// the high watermark, sized so the buffer lasts kHorizon at the measured
+// drain rate (playback speed minus the media time ingested per second while
+// starved), so slow links refill more and fast links restart sooner. The
+// low watermark moves up when the buffer drains, so the pause happens
+// before the sinks run dry. Every 100 ms tick calls Update().
+class BufferingController {
  public:
-  DecoderStatusTask(SbPlayerDecoderStatusFunc func,
-                    SbPlayer player,
-                    int ticket,
-                    void* ctx,
-                    SbPlayerDecoderState state,
-                    MediaType media) {
-    this->func_ = func;
-    this->player_ = player;
-    this->ticket_ = ticket;
-    this->ctx_ = ctx;
-    this->state_ = state;
-    this->media_ = media;
+  BufferingController() {
+    low_base_ = ReadEnvMs("COBALT_BUFFERING_LOW_MS", kDefaultLow);
+    high_min_ = ReadEnvMs("COBALT_BUFFERING_HIGH_MIN_MS", kDefaultHighMin);
+    high_max_ = ReadEnvMs("COBALT_BUFFERING_HIGH_MAX_MS", kDefaultHighMax);
+    // Resuming below the pause threshold would flap between the two.
+    if (low_base_ >= high_min_ || high_min_ > high_max_) {
+      SB_LOG(WARNING) << "Ignoring buffering watermarks low="
+                      << low_base_ / GST_MSECOND << "ms high_min="
+                      << high_min_ / GST_MSECOND << "ms high_max="
+                      << high_max_ / GST_MSECOND << "ms";
+      low_base_ = kDefaultLow;
+      high_min_ = kDefaultHighMin;
+      high_max_ = kDefaultHighMax;
+    }
+    low_ = low_base_;
+    high_ = high_min_;
   }
 
-  ~DecoderStatusTask() override {}
+  gint64 LowWatermark() const { return low_; }
+  gint64 HighWatermark() const { return high_; }
+  bool IsRebuffering() const { return rebuffer_started_at_ >= 0; }
+
+  void Update(SbTimeMonotonic now, gint64 position, gint64 min_ts,
+              bool playing, bool starved, uint64_t ingested_bytes) {
+    if (last_update_ >= 0) {
+      double elapsed = static_cast<double>(now - last_update_) * GST_USECOND;
+      if (elapsed > 0) {
+        if (playing && position >= last_position_)
+          speed_ += kAlpha * ((position - last_position_) / elapsed - speed_);
+        // Ingest is limited by Cobalt's flow control unless we asked for
+        // data, only then does it tell how fast the link is.
+        if (starved && min_ts >= last_min_ts_) {
+          ingest_ratio_ += kAlpha * ((min_ts - last_min_ts_) / elapsed - ingest_ratio_);
+          ingest_bps_ += kAlpha * ((ingested_bytes - last_bytes_) * 8. * GST_SECOND / elapsed - ingest_bps_);
+        }
+      }
+    }
+    last_update_ = now;
+    last_position_ = position;
+    last_min_ts_ = min_ts;
+    last_bytes_ = ingested_bytes;
+
+    if (!IsRebuffering() && last_rebuffer_end_ >= 0 &&
+        now - last_rebuffer_end_ > kBoostDecay && boost_ > 1) {
+      boost_ = 1;
+    }
 
-  void Do() override {
-    if ((static_cast<int>(media_) & static_cast<int>(MediaType::kAudio)) != 0)
-      func_(player_, ctx_, kSbMediaTypeAudio, state_, ticket_);
-    if ((static_cast<int>(media_) & static_cast<int>(MediaType::kVideo)) != 0)
-      func_(player_, ctx_, kSbMediaTypeVideo, state_, ticket_);
+    double drain = std::max(speed_ - ingest_ratio_, 0.);
+    gint64 high = static_cast<gint64>(drain * kHorizon) * boost_;
+    high_ = std::min(std::max(high, high_min_), high_max_);
+    low_ = std::min(low_base_ + static_cast<gint64>(drain * kReaction), high_ / 2);
   }
 
-  void PrintInfo() override {
-    GST_TRACE("DecoderStatusTask state:%d (%s), ticket:%d, media:%d", state_,
-              DecoderStateToStr(state_), ticket_, static_cast<int>(media_));
+  bool ShouldPause(gint64 ahead) const { return ahead <= low_; }
+  bool ShouldResume(gint64 ahead) const { return ahead >= high_; }
+
+  void OnRebufferStart(SbTimeMonotonic now, gint64 ahead) {
+    // Back to back rebuffers mean the watermark is too low for this link.
+    if (last_rebuffer_end_ >= 0 && now - last_rebuffer_end_ < kBoostDecay)
+      boost_ = boost_ * 2 > kMaxBoost ? kMaxBoost : boost_ * 2;
+    rebuffer_started_at_ = now;
+    History& entry = history_[rebuffers_ % kHistorySize];
+    entry.ahead = ahead;
+    entry.low = low_;
+    entry.high = high_;
+    entry.duration = -1;
+    ++rebuffers_;
   }
 
- private:
-  SbPlayerDecoderStatusFunc func_;
-  SbPlayer player_;
-  int ticket_;
-  void* ctx_;
-  SbPlayerDecoderState state_;
-  MediaType media_;
-};
+  void OnRebufferEnd(SbTimeMonotonic now) {
+    if (!IsRebuffering())
+      return;
+    SbTime duration = now - rebuffer_started_at_;
+    history_[(rebuffers_ - 1) % kHistorySize].duration = duration;
+    rebuffering_.Add(duration);
+    rebuffer_started_at_ = -1;
+    last_rebuffer_end_ = now;
+  }
 
-class PlayerErrorTask : public Task {
- public:
-  PlayerErrorTask(SbPlayerErrorFunc func,
-                  SbPlayer player,
-                  void* ctx,
-                  SbPlayerError error,
-                  const char* msg) {
-    this->func_ = func;
-    this->player_ = player;
-    this->ctx_ = ctx;
-    this->error_ = error;
-    this->msg_ = msg;
+  // Position and written timestamps jump on seek, restart the sampling.
+  void OnSeek() {
+    rebuffer_started_at_ = -1;
+    last_update_ = -1;
   }
 
-  ~PlayerErrorTask() override {}
+  void WriteStats(media::StatsWriter& writer) const {
+    writer.BeginObject("buffering");
+    writer.Add("rebuffers", rebuffers_);
+    rebuffering_.Write(writer, "rebuffering");
+    writer.Add("lowms", low_ / GST_MSECOND);
+    writer.Add("highms", high_ / GST_MSECOND);
+    writer.Add("boost", boost_);
+    writer.Add("playbackspeed", speed_);
+    writer.Add("ingestratio", ingest_ratio_);
+    writer.Add("ingestbps", ingest_bps_);
+    writer.BeginArray("history");
+    uint64_t first = rebuffers_ > kHistorySize ? rebuffers_ - kHistorySize : 0;
+    for (uint64_t i = first; i < rebuffers_; ++i) {
+      const History& entry = history_[i % kHistorySize];
+      writer.BeginObject();
+      writer.Add("aheadms", entry.ahead / GST_MSECOND);
+      writer.Add("lowms", entry.low / GST_MSECOND);
+      writer.Add("highms", entry.high / GST_MSECOND);
+      writer.Add("durationus", static_cast<int64_t>(entry.duration));
+      writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+  }
 
-  void Do() override { func_(player_, ctx_, error_, msg_.c_str()); }
+ private:
+  static constexpr double kAlpha = .2;
+  static constexpr gint64 kHorizon = 10 * GST_SECOND;
+  static constexpr gint64 kReaction = 2 * kPlaybackStateInterval * GST_USECOND;
+  static constexpr SbTime kBoostDecay = 30 * kSbTimeSecond;
+  static constexpr int kMaxBoost = 4;
+  static constexpr uint64_t kHistorySize = 16;
+  static constexpr gint64 kDefaultLow = -350 * GST_MSECOND;
+  static constexpr gint64 kDefaultHighMin = 250 * GST_MSECOND;
+  static constexpr gint64 kDefaultHighMax = 5 * GST_SECOND;
+  static constexpr int64_t kMaxWatermarkMs = 60 * 1000;
+
+  struct History {
+    gint64 ahead;
+    gint64 low;
+    gint64 high;
+    SbTime duration;
+  };
 
-  void PrintInfo() override { GST_TRACE("PlayerErrorTask"); }
+  static gint64 ReadEnvMs(const char* name, gint64 fallback) {
+    return ReadEnvInt(name, fallback / GST_MSECOND, -kMaxWatermarkMs,
+                      kMaxWatermarkMs) * GST_MSECOND;
+  }
 
- private:
-  SbPlayerErrorFunc func_;
-  SbPlayer player_;
-  SbPlayerError error_;
-  void* ctx_;
-  std::string msg_;
+  gint64 low_base_;
+  gint64 high_min_;
+  gint64 high_max_;
+  gint64 low_;
+  gint64 high_;
+  int boost_ { 1 };
+  double speed_ { 1. };
+  double ingest_ratio_ { 1. };
+  double ingest_bps_ { 0. };
+  SbTimeMonotonic last_update_ { -1 };
+  gint64 last_position_ { 0 };
+  gint64 last_min_ts_ { 0 };
+  uint64_t last_bytes_ { 0 };
+  SbTimeMonotonic rebuffer_started_at_ { -1 };
+  SbTimeMonotonic last_rebuffer_end_ { -1 };
+  uint64_t rebuffers_ { 0 };
+  LatencyStats rebuffering_;
+  History history_[kHistorySize];
 };
 
 class PlayerImpl : public Player {
@@ -1109,6 +1427,7 @@ class PlayerImpl : public Player {
 
   GstElement* GetPipeline() const { return pipeline_;  }
   bool IsValid() const { return SbThreadIsValid(playback_thread_); }
+  void WriteStats(media::StatsWriter& writer);
 
  private:
   enum class State {
@@ -1125,71 +1444,102 @@ class PlayerImpl : public Player {
     kMediaNumber,
   };
 
-  struct DispatchData {
-    DispatchData& operator=(DispatchData&) = delete;
-    DispatchData(const DispatchData&) = delete;
-
-    DispatchData(Task* task, GSource* src) : task_(task), src_(src) {
-      SB_DCHECK(task_ && src_);
-    }
-
-    ~DispatchData() {
-      delete task_;
-      g_source_unref(src_);
-    }
-
-    Task* task() const { return task_; }
-
-   private:
-    Task* task_{nullptr};
-    GSource* src_{nullptr};
+  // kSkip steps the sinks over data that is already queued, without a
+  // flush, kKeyUnit flushes to the key frame preceding the target (opt-in,
+  // the playback starts before the requested position) and kAccurate
+  // flushes and decodes up to the target.
+  enum class SeekMode {
+    kSkip,
+    kKeyUnit,
+    kAccurate,
+    kCount,
   };
 
-  class PendingSample {
-   public:
-    PendingSample() = delete;
-    PendingSample& operator=(const PendingSample&) = delete;
-    PendingSample(const PendingSample&) = delete;
+  static constexpr size_t kDispatchQueueSize = 64;
 
-    PendingSample& operator=(PendingSample&& other) {
-      type_ = other.type_;
-      buffer_ = other.buffer_;
-      other.buffer_ = nullptr;
-      serial_ = other.serial_;
-      other.serial_ = 0;
-      timestamp_ = other.timestamp_;
-      other.timestamp_ = GST_CLOCK_TIME_NONE;
-      return *this;
+  // Samples written while a seek is pending. They are held by reference and
+  // replayed in serial order once the flush completes, the same GstBuffer is
+  // pushed again on each replay (downstream elements copy on write, so the
+  // stored buffers stay intact). The store belongs to a generation (the seek
+  // ticket), switching to a new ticket drops all samples of the old one.
+  // Guarded by |mutex_|.
+  class PendingSampleStore {
+   public:
+    struct Sample {
+      SbMediaType type;
+      uint64_t serial;
+      GstBuffer* buffer;
+    };
+
+    PendingSampleStore() = default;
+    PendingSampleStore(const PendingSampleStore&) = delete;
+    PendingSampleStore& operator=(const PendingSampleStore&) = delete;
+    ~PendingSampleStore() { Clear(); }
+
+    bool IsEmpty() const { return samples_.empty(); }
+    size_t Size() const { return samples_.size(); }
+    size_t Bytes() const { return bytes_; }
+    size_t BytesHighWaterMark() const { return bytes_hwm_; }
+    int Generation() const { return generation_; }
+    uint64_t Generations() const { return generations_; }
+
+    void Reset(int generation) {
+      Clear();
+      if (generation_ != generation) {
+        generation_ = generation;
+        ++generations_;
+      }
     }
 
-    PendingSample(PendingSample&& other) { operator=(std::move(other)); }
+    // Stores a reference to |buffer|.
+    bool Add(SbMediaType type, uint64_t serial, GstBuffer* buffer) {
+      Key key { serial, type == kSbMediaTypeVideo ? kVideoIndex : kAudioIndex };
+      auto res = samples_.emplace(key, Sample { type, serial, buffer });
+      if (!res.second) {
+        GST_WARNING("Sample %d:%" G_GUINT64_FORMAT " already stored", type, serial);
+        return false;
+      }
+      gst_buffer_ref(buffer);
+      bytes_ += gst_buffer_get_size(buffer);
+      bytes_hwm_ = std::max(bytes_hwm_, bytes_);
+      return true;
+    }
 
-    PendingSample(SbMediaType type,
-                  GstBuffer* buffer,
-                  uint64_t serial)
-        : type_(type),
-          buffer_(buffer),
-          serial_(serial),
-          timestamp_(GST_BUFFER_TIMESTAMP(buffer_)) {
-      SB_DCHECK(gst_buffer_is_writable(buffer));
+    // Appends new references to all stored samples in serial order.
+    void Snapshot(std::vector<Sample>& out) const {
+      out.reserve(out.size() + samples_.size());
+      for (const auto& kv : samples_) {
+        out.push_back(kv.second);
+        gst_buffer_ref(kv.second.buffer);
+      }
     }
 
-    ~PendingSample() {
-      if (buffer_)
-        gst_buffer_unref(buffer_);
+    // Moves all stored samples (and their references) to |out|.
+    void Take(std::vector<Sample>& out) {
+      out.reserve(out.size() + samples_.size());
+      for (const auto& kv : samples_)
+        out.push_back(kv.second);
+      samples_.clear();
+      bytes_ = 0;
     }
 
-    SbMediaType Type() const { return type_; }
-    GstClockTime Timestamp() const { return timestamp_; }
-    GstBuffer* CopyBuffer() const { return gst_buffer_copy_deep(buffer_); }
-    GstBuffer* TakeBuffer() { GstBuffer* res = buffer_; buffer_ = nullptr; return res; }
-    uint64_t SerialID() const { return serial_; }
+    void Clear() {
+      for (const auto& kv : samples_)
+        gst_buffer_unref(kv.second.buffer);
+      samples_.clear();
+      bytes_ = 0;
+    }
 
    private:
-    SbMediaType type_;
-    GstBuffer* buffer_;
-    uint64_t serial_;
-    GstClockTime timestamp_;
+    // Serials count per media type, so only the order within each stream is
+    // kept. Audio and video alternate by sample index, which is all the
+    // independent appsrcs need.
+    using Key = std::pair<uint64_t, int>;
+    std::map<Key, Sample> samples_;
+    int generation_ { SB_PLAYER_INITIAL_TICKET };
+    uint64_t generations_ { 0 };
+    size_t bytes_ { 0 };
+    size_t bytes_hwm_ { 0 };
   };
 
   struct PendingBounds {
@@ -1203,14 +1553,13 @@ class PlayerImpl : public Player {
     int h;
   };
 
-  using PendingSamples = std::vector<PendingSample>;
-  using SamplesPendingKey = std::map<std::string, PendingSamples>;
 
   static gboolean BusMessageCallback(GstBus* bus,
                                      GstMessage* message,
                                      gpointer user_data);
   static void* ThreadEntryPoint(void* context);
-  static gboolean WorkerTask(gpointer user_data);
+  void RecordFirstFrame();
+  static gboolean DispatchQueuedItems(gpointer user_data);
   static gboolean FinishSourceSetup(gpointer user_data);
   static void AppSrcNeedData(GstAppSrc* src, guint length, gpointer user_data);
   static void AppSrcEnoughData(GstAppSrc* src, gpointer user_data);
@@ -1224,11 +1573,24 @@ class PlayerImpl : public Player {
                            GstElement* element,
                            PlayerImpl* self);
   bool ChangePipelineState(GstState state) const;
-  void DispatchOnWorkerThread(Task* task) const;
+  void DispatchOnWorkerThread(const DispatchItem& item) const;
+  void SignalDispatch() const;
+  void DispatchPlayerStatus(int ticket, SbPlayerState state) const;
+  void DispatchDecoderStatus(int ticket, SbPlayerDecoderState state, MediaType media) const;
+  void DispatchPlayerError(SbPlayerError error, const char* message) const;
+  bool RunDispatchItem(const DispatchItem& item) const;
+  bool DrainDispatchQueue();
   gint64 GetPosition() const;
   bool WriteSample(SbMediaType sample_type,
                    GstBuffer* buffer,
                    uint64_t serial_id);
+  bool WriteSamples(SbMediaType sample_type,
+                    GstBufferList* buffers,
+                    uint64_t first_serial_id);
+  void OnSamplesWritten(SbMediaType sample_type);
+  GstBuffer* CreateSampleBuffer(SbMediaType sample_type,
+                                const SbPlayerSampleInfo& sample_info);
+  GstBuffer* WrapSampleBuffer(const void* sample_buffer, int size);
   MediaType GetBothMediaTypeTakingCodecsIntoAccount() const;
   void RecordTimestamp(SbMediaType type, SbTime timestamp);
   SbTime MinTimestamp(MediaType* origin) const;
@@ -1244,14 +1606,23 @@ class PlayerImpl : public Player {
       return;
     }
     decoder_state_data_ |= need_data;
-    DispatchOnWorkerThread(new DecoderStatusTask(
-      decoder_status_func_, player_, ticket_, context_,
-      kSbPlayerDecoderStateNeedsData, media));
+    DispatchDecoderStatus(ticket_, kSbPlayerDecoderStateNeedsData, media);
   }
 
   void HandleApplicationMessage(GstBus* bus, GstMessage* message);
   void WritePendingSamples();
   void CheckBuffering(gint64 position);
+  gint64 PublishPlaybackState();
+  void PublishSeekPositionLocked(SbTime seek_to_timestamp);
+  bool TrySkipSeek(SbTime seek_to_timestamp, int ticket, gint64 position_ns);
+  void CompleteSkipSeek(bool timed_out);
+  void CancelSkipSeekLocked();
+  SbTime KeyUnitSeekTargetLocked(SbTime seek_to_timestamp) const;
+  void RecordKeyFrameLocked(GstClockTime timestamp);
+  void RecordSeekDoneLocked();
+  bool UpdateTrickPlayLocked(double rate);
+  void DropTrickPlayFramesLocked(GstBufferList* buffers);
+  void StorePlaybackState(const PlaybackState& state);
   void ConfigureLimitedVideo();
 
   SbPlayer player_;
@@ -1296,7 +1667,7 @@ class PlayerImpl : public Player {
   int frame_width_{0};
   int frame_height_{0};
   State state_{State::kNull};
-  PendingSamples pending_samples_;
+  PendingSampleStore pending_samples_;
   mutable gint64 cached_position_ns_{-1};
   PendingBounds pending_bounds_;
   SbMediaColorMetadata color_metadata_{};
@@ -1307,12 +1678,78 @@ class PlayerImpl : public Player {
   ::starboard::ConditionVariable pending_oob_write_condition_ { mutex_ };
 
   int hang_monitor_source_id_ { -1 };
+  // Callbacks for Cobalt, drained on the player thread when |dispatch_fd_|
+  // gets signalled.
+  mutable BoundedMpscQueue<DispatchItem, kDispatchQueueSize> dispatch_queue_;
+  // Takes what does not fit in |dispatch_queue_|, producers never wait for
+  // the player thread. Once it is in use everything goes there until the
+  // player thread catches up, so callbacks keep their order.
+  mutable ::starboard::Mutex dispatch_overflow_mutex_;
+  mutable std::vector<DispatchItem> dispatch_overflow_;
+  mutable std::atomic<bool> dispatch_overflowing_ { false };
+  // Player thread only, set once the destroy marker ran.
+  bool dispatch_destroyed_ { false };
+  // Without an eventfd the source gets woken through its ready time.
+  int dispatch_fd_ { -1 };
+  GSource* dispatch_source_ { nullptr };
+  mutable std::atomic<uint64_t> dispatched_items_ { 0 };
+  mutable std::atomic<uint64_t> dispatch_latency_total_ { 0 };
+  mutable std::atomic<int64_t> dispatch_latency_max_ { 0 };
+  mutable std::atomic<uint64_t> dispatch_depth_hwm_ { 0 };
+  mutable std::atomic<uint64_t> dispatch_overflows_ { 0 };
+  int playback_state_source_id_ { -1 };
+  // Read by GetInfo() without taking |mutex_|.
+  PlaybackStateSnapshot playback_state_;
+  ::starboard::Mutex playback_state_mutex_;
+  // Guarded by |mutex_|.
+  uint64_t seek_epoch_ { 0 };
+  std::atomic<double> volume_ { 1. };
   HangMonitor hang_monitor_ { "Player" };
   GstCaps* audio_caps_ { nullptr };
   GstCaps* video_caps_ { nullptr };
+  // Guarded by |mutex_|, |buf_target_min_ts_| is set while rebuffering.
   SbTime buf_target_min_ts_ { kSbTimeMax };
+  BufferingController buffering_;
+  std::unique_ptr<SampleTracer> sample_tracer_;
   bool need_instant_rate_change_ { false };
   int need_first_segment_ack_ { static_cast<int>(MediaType::kBoth) };
+
+  std::atomic<uint64_t> bytes_wrapped_ { 0 };
+  std::atomic<uint64_t> bytes_copied_ { 0 };
+  std::atomic<uint64_t> samples_replayed_ { 0 };
+  std::atomic<uint64_t> bytes_replayed_ { 0 };
+  bool pooled_ { false };
+  SbTime created_at_ { 0 };
+  // Seek engine state, guarded by |mutex_|. Key frame timestamps survive
+  // flushes, they describe the stream rather than what is queued.
+  std::set<GstClockTime> video_key_frames_;
+  GstClockTime video_key_frames_end_ { 0 };
+  SeekMode seek_mode_ { SeekMode::kAccurate };
+  SbTimeMonotonic seek_started_at_ { -1 };
+  bool skip_seek_pending_ { false };
+  // Sinks which did not report STEP_DONE yet for the pending skip.
+  int skip_steps_pending_ { 0 };
+  int skip_seek_timeout_id_ { -1 };
+  GstClockTime skip_drop_until_[kMediaNumber] { GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE };
+  LatencyStats seek_latency_[static_cast<int>(SeekMode::kCount)];
+  uint64_t skip_seeks_rejected_ { 0 };
+  uint64_t skip_seek_timeouts_ { 0 };
+  uint64_t skip_seek_dropped_samples_ { 0 };
+  // Key frame only playback at high rates, guarded by |mutex_|. Discarded
+  // delta frames are never written, so they count neither as total nor as
+  // dropped frames in GetInfo().
+  bool trick_play_ { false };
+  bool trick_play_wait_key_frame_ { false };
+  GstClockTime trick_play_last_key_frame_ { GST_CLOCK_TIME_NONE };
+  uint64_t trick_play_sessions_ { 0 };
+  uint64_t trick_play_discarded_frames_ { 0 };
+  uint64_t trick_play_thinned_frames_ { 0 };
+  // Mute state to restore when leaving trick play.
+  gboolean trick_play_restore_mute_ { FALSE };
+  // Guarded by |mutex_|.
+  SbTime first_frame_latency_ { -1 };
+  uint64_t last_bytes_wrapped_ { 0 };
+  uint64_t last_bytes_copied_ { 0 };
 };
 
 struct PlayerRegistry
@@ -1351,9 +1788,298 @@ struct PlayerRegistry
       gst_object_unref(pipeline);
     }
   }
+
+  void WriteStats(media::StatsWriter& writer) {
+    ::starboard::ScopedLock lock(mutex_);
+    writer.BeginArray("players");
+    for(const auto& p: players_)
+      p->WriteStats(writer);
+    writer.EndArray();
+  }
 };
 SB_ONCE_INITIALIZE_FUNCTION(PlayerRegistry, GetPlayerRegistry);
 
+GstElement* CreatePlaybin() {
+  GstElementFactory* src_factory = gst_element_factory_find("cobaltsrc");
+  if (!src_factory) {
+    gst_element_register(0, "cobaltsrc", GST_RANK_PRIMARY + 100,
+                         GST_COBALT_TYPE_SRC);
+  } else {
+    gst_object_unref(src_factory);
+  }
+
+  GstElement* pipeline = gst_element_factory_make("playbin", "media_pipeline");
+  if (!pipeline)
+    return nullptr;
+
+  unsigned flagAudio = getGstPlayFlag("audio");
+  unsigned flagVideo = getGstPlayFlag("video");
+  unsigned flagNativeVideo = getGstPlayFlag("native-video");
+  unsigned flagNativeAudio = enableNativeAudio() ? getGstPlayFlag("native-audio") : 0;
+
+  g_object_set(pipeline, "flags",
+               flagAudio | flagVideo | flagNativeVideo | flagNativeAudio,
+               nullptr);
+  g_object_set(pipeline, "uri", "cobalt://", nullptr);
+  return pipeline;
+}
+
+// Keeps COBALT_PIPELINE_POOL_SIZE playbins in READY, each with its own main
+// context and a playback thread already running the loop, so SbPlayerCreate
+// only has to connect the player to them. Pipelines are never returned to
+// the pool, vendor sinks and decoders keep per-stream state we can't reset
+// reliably, a fresh entry is built in the background instead.
+class PipelinePool {
+ public:
+  struct Entry {
+    GMainContext* context { nullptr };
+    GMainLoop* loop { nullptr };
+    GstElement* pipeline { nullptr };
+    SbThread thread { kSbThreadInvalid };
+  };
+
+  PipelinePool() {
+    capacity_ = static_cast<int>(
+        ReadEnvInt("COBALT_PIPELINE_POOL_SIZE", 0, 0, kMaxCapacity));
+  }
+
+  bool IsEnabled() const { return capacity_ > 0; }
+
+  void Prepare() {
+    ::starboard::ScopedLock lock(mutex_);
+    closed_ = false;
+    ScheduleRefillLocked();
+  }
+
+  // Hands out a pooled entry, if one is ready. The codecs are remembered so
+  // that refills preload the decoders the application is most likely to ask
+  // for next.
+  bool Acquire(SbMediaVideoCodec video_codec,
+               SbMediaAudioCodec audio_codec,
+               Entry* entry) {
+    if (!IsEnabled())
+      return false;
+    ::starboard::ScopedLock lock(mutex_);
+    video_codec_ = video_codec;
+    audio_codec_ = audio_codec;
+    bool acquired = !closed_ && !entries_.empty();
+    if (acquired) {
+      *entry = entries_.front();
+      entries_.erase(entries_.begin());
+      ++hits_;
+    } else {
+      ++misses_;
+    }
+    ScheduleRefillLocked();
+    return acquired;
+  }
+
+  void Release() {
+    std::vector<Entry> entries;
+    SbThread refill_thread = kSbThreadInvalid;
+    {
+      ::starboard::ScopedLock lock(mutex_);
+      closed_ = true;
+      while (refilling_)
+        refill_done_.Wait();
+      entries.swap(entries_);
+      std::swap(refill_thread, refill_thread_);
+    }
+    // Builds pipelines, must be gone before GStreamer gets deinitialized.
+    if (SbThreadIsValid(refill_thread))
+      SbThreadJoin(refill_thread, nullptr);
+    for (Entry& entry : entries)
+      DestroyEntry(entry);
+  }
+
+  void RecordSetup(bool pooled, SbTime duration) {
+    ::starboard::ScopedLock lock(mutex_);
+    setup_[pooled ? kPooled : kCold].Add(duration);
+  }
+
+  void RecordFirstFrame(bool pooled, SbTime duration) {
+    ::starboard::ScopedLock lock(mutex_);
+    first_frame_[pooled ? kPooled : kCold].Add(duration);
+  }
+
+  void WriteStats(media::StatsWriter& writer) {
+    ::starboard::ScopedLock lock(mutex_);
+    writer.BeginObject("pipelinepool");
+    writer.Add("capacity", capacity_);
+    writer.Add("available", static_cast<uint64_t>(entries_.size()));
+    writer.Add("hits", hits_);
+    writer.Add("misses", misses_);
+    writer.Add("created", created_);
+    writer.Add("failed", failed_);
+    build_.Write(writer, "build");
+    writer.BeginObject("setup");
+    setup_[kPooled].Write(writer, "pooled");
+    setup_[kCold].Write(writer, "cold");
+    writer.EndObject();
+    writer.BeginObject("ttff");
+    first_frame_[kPooled].Write(writer, "pooled");
+    first_frame_[kCold].Write(writer, "cold");
+    writer.EndObject();
+    writer.EndObject();
+  }
+
+ private:
+  static constexpr int kMaxCapacity = 4;
+  enum { kPooled, kCold, kKinds };
+
+  void ScheduleRefillLocked() {
+    if (closed_ || refilling_ || static_cast<int>(entries_.size()) >= capacity_)
+      return;
+    // The previous refill is done with the pool, only its exit is pending.
+    if (SbThreadIsValid(refill_thread_))
+      SbThreadJoin(refill_thread_, nullptr);
+    refilling_ = true;
+    refill_thread_ =
+        SbThreadCreate(0, kSbThreadPriorityLow, kSbThreadNoAffinity, true,
+                       "pipeline_pool", &PipelinePool::RefillThreadEntryPoint, this);
+    if (!SbThreadIsValid(refill_thread_)) {
+      GST_WARNING("Failed to start pipeline pool refill");
+      refilling_ = false;
+    }
+  }
+
+  static void* RefillThreadEntryPoint(void* context) {
+    PipelinePool* self = static_cast<PipelinePool*>(context);
+    for (;;) {
+      SbMediaVideoCodec video_codec;
+      SbMediaAudioCodec audio_codec;
+      bool warm = false;
+      {
+        ::starboard::ScopedLock lock(self->mutex_);
+        if (self->closed_ || static_cast<int>(self->entries_.size()) >= self->capacity_)
+          break;
+        video_codec = self->video_codec_;
+        audio_codec = self->audio_codec_;
+        if (video_codec != self->warm_video_codec_ || audio_codec != self->warm_audio_codec_) {
+          self->warm_video_codec_ = video_codec;
+          self->warm_audio_codec_ = audio_codec;
+          warm = true;
+        }
+      }
+      if (warm) {
+        LoadDecoders(video_codec);
+        LoadDecoders(audio_codec);
+      }
+      Entry entry;
+      SbTime start = SbTimeGetMonotonicNow();
+      bool created = CreateEntry(&entry);
+      ::starboard::ScopedLock lock(self->mutex_);
+      if (!created) {
+        ++self->failed_;
+        break;
+      }
+      self->build_.Add(SbTimeGetMonotonicNow() - start);
+      ++self->created_;
+      self->entries_.push_back(entry);
+    }
+    ::starboard::ScopedLock lock(self->mutex_);
+    self->refilling_ = false;
+    self->refill_done_.Broadcast();
+    return nullptr;
+  }
+
+  static void* LoopThreadEntryPoint(void* context) {
+    GMainLoop* loop = static_cast<GMainLoop*>(context);
+    g_main_context_push_thread_default(g_main_loop_get_context(loop));
+    g_main_loop_run(loop);
+    return nullptr;
+  }
+
+  // Makes sure the plugins decoding |codec| are loaded, so the first
+  // READY->PAUSED transition doesn't have to dlopen them.
+  template <typename C>
+  static void LoadDecoders(C codec) {
+    auto type = std::is_same<C, SbMediaVideoCodec>::value
+                    ? GST_ELEMENT_FACTORY_TYPE_MEDIA_VIDEO
+                    : GST_ELEMENT_FACTORY_TYPE_MEDIA_AUDIO;
+    std::vector<std::string> caps = CodecToGstCaps(codec);
+    if (caps.empty())
+      return;
+    GList* factories = gst_element_factory_list_get_elements(
+        GST_ELEMENT_FACTORY_TYPE_DECODER | type, GST_RANK_MARGINAL);
+    for (const auto& single_caps : caps) {
+      GstCaps* gst_caps = gst_caps_from_string(single_caps.c_str());
+      if (!gst_caps)
+        continue;
+      GList* decoders = gst_element_factory_list_filter(factories, gst_caps, GST_PAD_SINK, FALSE);
+      for (GList* iter = decoders; iter; iter = iter->next) {
+        GstPluginFeature* loaded = gst_plugin_feature_load(GST_PLUGIN_FEATURE(iter->data));
+        if (loaded) {
+          GST_DEBUG("Preloaded %s for %s", GST_OBJECT_NAME(loaded), single_caps.c_str());
+          gst_object_unref(loaded);
+        }
+      }
+      gst_plugin_feature_list_free(decoders);
+      gst_caps_unref(gst_caps);
+    }
+    gst_plugin_feature_list_free(factories);
+  }
+
+  static bool CreateEntry(Entry* entry) {
+    entry->context = g_main_context_new();
+    g_main_context_push_thread_default(entry->context);
+    entry->loop = g_main_loop_new(entry->context, FALSE);
+    entry->pipeline = CreatePlaybin();
+    bool ready = entry->pipeline &&
+        gst_element_set_state(entry->pipeline, GST_STATE_READY) != GST_STATE_CHANGE_FAILURE;
+    g_main_context_pop_thread_default(entry->context);
+
+    if (ready) {
+      entry->thread =
+          SbThreadCreate(0, kSbThreadPriorityRealTime, kSbThreadNoAffinity, true,
+                         "playback_thread", &PipelinePool::LoopThreadEntryPoint, entry->loop);
+    }
+    if (!SbThreadIsValid(entry->thread)) {
+      GST_WARNING("Failed to prepare pooled pipeline");
+      DestroyEntry(*entry);
+      return false;
+    }
+    while (!g_main_loop_is_running(entry->loop))
+      g_usleep(1);
+    GST_DEBUG_OBJECT(entry->pipeline, "Pooled pipeline ready");
+    return true;
+  }
+
+  static void DestroyEntry(Entry& entry) {
+    if (SbThreadIsValid(entry.thread)) {
+      g_main_loop_quit(entry.loop);
+      SbThreadJoin(entry.thread, nullptr);
+    }
+    if (entry.pipeline) {
+      gst_element_set_state(entry.pipeline, GST_STATE_NULL);
+      gst_object_unref(entry.pipeline);
+    }
+    g_main_loop_unref(entry.loop);
+    g_main_context_unref(entry.context);
+    entry = Entry();
+  }
+
+  ::starboard::Mutex mutex_;
+  ::starboard::ConditionVariable refill_done_ { mutex_ };
+  int capacity_ { 0 };
+  bool closed_ { false };
+  bool refilling_ { false };
+  SbThread refill_thread_ { kSbThreadInvalid };
+  std::vector<Entry> entries_;
+  SbMediaVideoCodec video_codec_ { kSbMediaVideoCodecNone };
+  SbMediaAudioCodec audio_codec_ { kSbMediaAudioCodecNone };
+  SbMediaVideoCodec warm_video_codec_ { kSbMediaVideoCodecNone };
+  SbMediaAudioCodec warm_audio_codec_ { kSbMediaAudioCodecNone };
+  uint64_t hits_ { 0 };
+  uint64_t misses_ { 0 };
+  uint64_t created_ { 0 };
+  uint64_t failed_ { 0 };
+  LatencyStats build_;
+  LatencyStats setup_[kKinds];
+  LatencyStats first_frame_[kKinds];
+};
+SB_ONCE_INITIALIZE_FUNCTION(PipelinePool, GetPipelinePool);
+
 PlayerImpl::PlayerImpl(SbPlayer player,
                        SbWindow window,
                        SbMediaVideoCodec video_codec,
@@ -1387,53 +2113,46 @@ PlayerImpl::PlayerImpl(SbPlayer player,
   if (disable_audio)
     audio_codec_ = kSbMediaAudioCodecNone;
 
-  main_loop_context_ = g_main_context_new ();
-  g_main_context_push_thread_default(main_loop_context_);
-  main_loop_ = g_main_loop_new(main_loop_context_, FALSE);
-
-  GSource* src = g_timeout_source_new(hang_monitor_.GetResetInterval() / kSbTimeMillisecond);
-  g_source_set_callback(src, [] (gpointer data) ->gboolean {
-    PlayerImpl& player = *static_cast<PlayerImpl*>(data);
-    GstState state, pending;
-    GstStateChangeReturn result = gst_element_get_state(player.pipeline_, &state, &pending, 0);
-    gint64 position = player.GetPosition();
-    GST_INFO("Player state: %s (pending: %s, result: %s), position: %" GST_TIME_FORMAT "",
-             gst_element_state_get_name(state),
-             gst_element_state_get_name(pending),
-             gst_element_state_change_return_get_name(result),
-             GST_TIME_ARGS(position));
-    player.hang_monitor_.Reset();
-    return G_SOURCE_CONTINUE;
-  }, this, nullptr);
-  hang_monitor_source_id_ = g_source_attach(src, main_loop_context_);
-  g_source_unref(src);
-
-  GST_INFO("Creating player with max capabilities: %s",
-           max_video_capabilities);
+  if (SampleTracer::IsEnabled())
+    sample_tracer_.reset(new SampleTracer());
+
+  created_at_ = SbTimeGetMonotonicNow();
+  PipelinePool::Entry pooled;
+  bool limited_video = max_video_capabilities && *max_video_capabilities;
+  if (!limited_video && GetPipelinePool()->Acquire(video_codec_, audio_codec_, &pooled)) {
+    // The pooled playback thread already owns the context, everything below
+    // attaches its sources explicitly.
+    pooled_ = true;
+    main_loop_context_ = pooled.context;
+    main_loop_ = pooled.loop;
+    pipeline_ = pooled.pipeline;
+    playback_thread_ = pooled.thread;
+  } else {
+    main_loop_context_ = g_main_context_new ();
+    g_main_context_push_thread_default(main_loop_context_);
+    main_loop_ = g_main_loop_new(main_loop_context_, FALSE);
+  }
 
-  GstElementFactory* src_factory = gst_element_factory_find("cobaltsrc");
-  if (!src_factory) {
-    gst_element_register(0, "cobaltsrc", GST_RANK_PRIMARY + 100,
-                         GST_COBALT_TYPE_SRC);
+  dispatch_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  dispatch_source_ = g_source_new(&FdSourceFunctions, sizeof(GSource));
+  if (dispatch_fd_ >= 0) {
+    g_source_add_unix_fd(dispatch_source_, dispatch_fd_, G_IO_IN);
   } else {
-    gst_object_unref(src_factory);
+    GST_WARNING("Failed to create eventfd, error: %d (%s), falling back to source ready time",
+                errno, strerror(errno));
   }
+  g_source_set_callback(dispatch_source_, &PlayerImpl::DispatchQueuedItems, this, nullptr);
 
-  pipeline_ = gst_element_factory_make("playbin", "media_pipeline");
+  GST_INFO("Creating player with max capabilities: %s",
+           max_video_capabilities);
 
-  unsigned flagAudio = getGstPlayFlag("audio");
-  unsigned flagVideo = getGstPlayFlag("video");
-  unsigned flagNativeVideo = getGstPlayFlag("native-video");
-  unsigned flagNativeAudio = enableNativeAudio() ? getGstPlayFlag("native-audio") : 0;
+  if (!pipeline_)
+    pipeline_ = CreatePlaybin();
 
-  g_object_set(pipeline_, "flags",
-               flagAudio | flagVideo | flagNativeVideo | flagNativeAudio,
-               nullptr);
   g_signal_connect(pipeline_, "source-setup",
                    G_CALLBACK(&PlayerImpl::SetupSource), this);
   g_signal_connect(pipeline_, "element-setup",
                    G_CALLBACK(&PlayerImpl::SetupElement), this);
-  g_object_set(pipeline_, "uri", "cobalt://", nullptr);
 
   if (max_video_capabilities && *max_video_capabilities) {
     max_video_capabilities_ = max_video_capabilities;
@@ -1459,10 +2178,6 @@ PlayerImpl::PlayerImpl(SbPlayer player,
     }
   }
 
-  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
-  bus_watch_id_ = gst_bus_add_watch(bus, &PlayerImpl::BusMessageCallback, this);
-  gst_object_unref(bus);
-
   video_appsrc_ = gst_element_factory_make("appsrc", "vidsrc");
   audio_appsrc_ = gst_element_factory_make("appsrc", "audsrc");
 
@@ -1482,16 +2197,99 @@ PlayerImpl::PlayerImpl(SbPlayer player,
     gst_context_unref(context);
   }
 
+  if (pooled_) {
+    // The pooled playback thread runs the sources attached below right away,
+    // they must see a fully initialized player.
+    {
+      ::starboard::ScopedLock lock(mutex_);
+      state_ = State::kInitial;
+    }
+    hang_monitor_.Reset();
+  }
+
+  // Attached last, the pooled playback thread would run them right away.
+  g_source_attach(dispatch_source_, main_loop_context_);
+
+  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+  if (pooled_) {
+    // Drop the state changes the pool went through.
+    gst_bus_set_flushing(bus, TRUE);
+    gst_bus_set_flushing(bus, FALSE);
+  }
+  GSource* src = gst_bus_create_watch(bus);
+  g_source_set_callback(src, reinterpret_cast<GSourceFunc>(&PlayerImpl::BusMessageCallback), this, nullptr);
+  bus_watch_id_ = g_source_attach(src, main_loop_context_);
+  g_source_unref(src);
+  gst_object_unref(bus);
+
+  src = g_timeout_source_new(hang_monitor_.GetResetInterval() / kSbTimeMillisecond);
+  g_source_set_callback(src, [] (gpointer data) ->gboolean {
+    PlayerImpl& player = *static_cast<PlayerImpl*>(data);
+    GstState state, pending;
+    GstStateChangeReturn result = gst_element_get_state(player.pipeline_, &state, &pending, 0);
+    gint64 position = player.GetPosition();
+    GST_INFO("Player state: %s (pending: %s, result: %s), position: %" GST_TIME_FORMAT "",
+             gst_element_state_get_name(state),
+             gst_element_state_get_name(pending),
+             gst_element_state_change_return_get_name(result),
+             GST_TIME_ARGS(position));
+    uint64_t wrapped = player.bytes_wrapped_.load(std::memory_order_relaxed);
+    uint64_t copied = player.bytes_copied_.load(std::memory_order_relaxed);
+    double interval_sec = static_cast<double>(player.hang_monitor_.GetResetInterval()) / kSbTimeSecond;
+    GST_INFO("Sample ingest: %.1f KiB/s zero-copy, %.1f KiB/s copied (total: %" G_GUINT64_FORMAT
+             " wrapped, %" G_GUINT64_FORMAT " copied bytes)",
+             (wrapped - player.last_bytes_wrapped_) / 1024. / interval_sec,
+             (copied - player.last_bytes_copied_) / 1024. / interval_sec,
+             wrapped, copied);
+    player.last_bytes_wrapped_ = wrapped;
+    player.last_bytes_copied_ = copied;
+    {
+      ::starboard::ScopedLock lock(player.mutex_);
+      if (!player.pending_samples_.IsEmpty()) {
+        GST_INFO("Pending samples: %zu (%zu bytes, hwm %zu bytes), replayed: %" G_GUINT64_FORMAT
+                 " samples, %" G_GUINT64_FORMAT " bytes",
+                 player.pending_samples_.Size(),
+                 player.pending_samples_.Bytes(),
+                 player.pending_samples_.BytesHighWaterMark(),
+                 player.samples_replayed_.load(std::memory_order_relaxed),
+                 player.bytes_replayed_.load(std::memory_order_relaxed));
+      }
+    }
+    player.hang_monitor_.Reset();
+    return G_SOURCE_CONTINUE;
+  }, this, nullptr);
+  hang_monitor_source_id_ = g_source_attach(src, main_loop_context_);
+  g_source_unref(src);
+
+  src = g_timeout_source_new(kPlaybackStateInterval / kSbTimeMillisecond);
+  g_source_set_callback(src, [] (gpointer data) ->gboolean {
+    PlayerImpl& player = *static_cast<PlayerImpl*>(data);
+    gint64 position = player.PublishPlaybackState();
+    player.CheckBuffering(position);
+    return G_SOURCE_CONTINUE;
+  }, this, nullptr);
+  playback_state_source_id_ = g_source_attach(src, main_loop_context_);
+  g_source_unref(src);
+
   ChangePipelineState(GST_STATE_READY);
-  g_main_context_pop_thread_default(main_loop_context_);
 
-  playback_thread_ =
-      SbThreadCreate(0, kSbThreadPriorityRealTime, kSbThreadNoAffinity, true,
-                     "playback_thread", &PlayerImpl::ThreadEntryPoint, this);
-  if (SbThreadIsValid(playback_thread_)) {
-    while(!g_main_loop_is_running(main_loop_))
-      g_usleep(1);
+  if (pooled_) {
+    DispatchPlayerStatus(ticket_, kSbPlayerStateInitialized);
+  } else {
+    g_main_context_pop_thread_default(main_loop_context_);
+
+    playback_thread_ =
+        SbThreadCreate(0, kSbThreadPriorityRealTime, kSbThreadNoAffinity, true,
+                       "playback_thread", &PlayerImpl::ThreadEntryPoint, this);
+    if (SbThreadIsValid(playback_thread_)) {
+      while(!g_main_loop_is_running(main_loop_))
+        g_usleep(1);
+    }
   }
+  SbTime setup = SbTimeGetMonotonicNow() - created_at_;
+  GST_INFO_OBJECT(pipeline_, "Player created in %" PRId64 " us (%s)",
+                  setup, pooled_ ? "pooled" : "cold");
+  GetPipelinePool()->RecordSetup(pooled_, setup);
   GetPlayerRegistry()->Add(this);
 }
 
@@ -1515,21 +2313,39 @@ PlayerImpl::~PlayerImpl() {
     g_source_destroy(src);
     hang_monitor_.Reset();
   }
-  ChangePipelineState(GST_STATE_NULL);
-  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
-  gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
-  gst_object_unref(bus);
+  if (playback_state_source_id_ > -1) {
+    GSource* src = g_main_context_find_source_by_id(main_loop_context_, playback_state_source_id_);
+    g_source_destroy(src);
+  }
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    CancelSkipSeekLocked();
+  }
+  ChangePipelineState(GST_STATE_NULL);
+  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+  gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
+  gst_object_unref(bus);
   if (SbThreadIsValid(playback_thread_)) {
-    DispatchOnWorkerThread(new PlayerDestroyedTask(
-      player_status_func_, player_, ticket_, context_, main_loop_));
+    DispatchItem item {};
+    item.type = DispatchItem::Type::kPlayerDestroyed;
+    item.ticket = ticket_;
+    item.player_state = kSbPlayerStateDestroyed;
+    DispatchOnWorkerThread(item);
     SbThreadJoin(playback_thread_, nullptr);
   }
+  g_source_destroy(dispatch_source_);
+  g_source_unref(dispatch_source_);
+  if (dispatch_fd_ >= 0)
+    close(dispatch_fd_);
   if (audio_caps_) {
     gst_caps_unref(audio_caps_);
   }
   if (video_caps_) {
     gst_caps_unref(video_caps_);
   }
+  // Stored samples may still wrap Cobalt's memory, release it while the
+  // deallocate callback is still valid.
+  pending_samples_.Clear();
   g_main_loop_unref(main_loop_);
   g_main_context_unref(main_loop_context_);
   g_object_unref(pipeline_);
@@ -1554,9 +2370,7 @@ gboolean PlayerImpl::BusMessageCallback(GstBus* bus,
     case GST_MESSAGE_EOS:
       if (GST_MESSAGE_SRC(message) == GST_OBJECT(self->pipeline_)) {
         GST_INFO("EOS");
-        self->DispatchOnWorkerThread(new PlayerStatusTask(
-            self->player_status_func_, self->player_, self->ticket_,
-            self->context_, kSbPlayerStateEndOfStream));
+        self->DispatchPlayerStatus(self->ticket_, kSbPlayerStateEndOfStream);
       }
       break;
 
@@ -1578,14 +2392,10 @@ gboolean PlayerImpl::BusMessageCallback(GstBus* bus,
       if (err->domain == GST_STREAM_ERROR && is_eos) {
         GST_WARNING("Got stream error. But all streams are ended, so reporting EOS. Error code %d: %s (%s).",
           err->code, err->message, debug);
-        self->DispatchOnWorkerThread(new PlayerStatusTask(
-          self->player_status_func_, self->player_, self->ticket_,
-          self->context_, kSbPlayerStateEndOfStream));
+        self->DispatchPlayerStatus(self->ticket_, kSbPlayerStateEndOfStream);
       } else {
         GST_ERROR("Error %d: %s (%s)", err->code, err->message, debug);
-        self->DispatchOnWorkerThread(new PlayerErrorTask(
-          self->player_error_func_, self->player_, self->context_,
-          kSbPlayerErrorDecode, err->message));
+        self->DispatchPlayerError(kSbPlayerErrorDecode, err->message);
       }
       g_free(debug);
       g_error_free(err);
@@ -1602,6 +2412,7 @@ gboolean PlayerImpl::BusMessageCallback(GstBus* bus,
                         gst_element_state_get_name(old_state),
                         gst_element_state_get_name(new_state),
                         gst_element_state_get_name(pending));
+        self->PublishPlaybackState();
         std::string file_name = "cobalt_";
         file_name += (GST_OBJECT_NAME(self->pipeline_));
         file_name += "_";
@@ -1668,7 +2479,7 @@ gboolean PlayerImpl::BusMessageCallback(GstBus* bus,
             self->state_ == State::kInitialPreroll) {
 
           bool is_seek_pending = self->is_seek_pending_;
-          bool has_pending_samples = (self->pending_samples_.empty() == false) || self->has_oob_write_pending_;
+          bool has_pending_samples = (self->pending_samples_.IsEmpty() == false) || self->has_oob_write_pending_;
 
           if (!is_seek_pending && has_pending_samples) {
 
@@ -1690,14 +2501,21 @@ gboolean PlayerImpl::BusMessageCallback(GstBus* bus,
           // The below code is good but on BRCM the decoder reports old
           // position for some time which makes some YTLB 2020 test failing.
           // self->seek_position_ = kSbTimeMax;
-          self->DispatchOnWorkerThread(new PlayerStatusTask(
-              self->player_status_func_, self->player_, self->ticket_,
-              self->context_, kSbPlayerStatePresenting));
+          self->DispatchPlayerStatus(self->ticket_, kSbPlayerStatePresenting);
+          if (self->state_ == State::kInitialPreroll)
+            self->RecordFirstFrame();
+          else
+            self->RecordSeekDoneLocked();
           self->state_ = State::kPresenting;
         }
       }
     } break;
 
+    case GST_MESSAGE_STEP_DONE:
+      GST_DEBUG("Step done from %s", GST_MESSAGE_SRC_NAME(message));
+      self->CompleteSkipSeek(false);
+      break;
+
     case GST_MESSAGE_CLOCK_LOST:
       self->ChangePipelineState(GST_STATE_PAUSED);
       self->ChangePipelineState(GST_STATE_PLAYING);
@@ -1746,38 +2564,170 @@ void* PlayerImpl::ThreadEntryPoint(void* context) {
   GST_TRACE("%d", SbThreadGetId());
 
   PlayerImpl* self = reinterpret_cast<PlayerImpl*>(context);
-  self->state_ = State::kInitial;
+  {
+    ::starboard::ScopedLock lock(self->mutex_);
+    self->state_ = State::kInitial;
+  }
 
   g_main_context_push_thread_default(self->main_loop_context_);
 
   self->hang_monitor_.Reset();
 
-  self->DispatchOnWorkerThread(new PlayerStatusTask(
-      self->player_status_func_, self->player_, self->ticket_, self->context_,
-      kSbPlayerStateInitialized));
+  self->DispatchPlayerStatus(self->ticket_, kSbPlayerStateInitialized);
   g_main_loop_run(self->main_loop_);
 
   return nullptr;
 }
 
-void PlayerImpl::DispatchOnWorkerThread(Task* task) const {
-  GSource* src = g_source_new(&SourceFunctions, sizeof(GSource));
-  g_source_set_ready_time(src, 0);
-  DispatchData* data = new DispatchData(task, src);
-  g_source_set_callback(src,
-                        [](gpointer userData) -> gboolean {
-                          DispatchData* data =
-                              static_cast<DispatchData*>(userData);
-                          GST_TRACE("%d", SbThreadGetId());
-                          data->task()->PrintInfo();
-                          data->task()->Do();
-                          return G_SOURCE_REMOVE;
-                        },
-                        data,
-                        [](gpointer userData) {
-                          delete static_cast<DispatchData*>(userData);
-                        });
-  g_source_attach(src, main_loop_context_);
+void PlayerImpl::RecordFirstFrame() {
+  first_frame_latency_ = SbTimeGetMonotonicNow() - created_at_;
+  GST_INFO_OBJECT(pipeline_, "First frame after %" PRId64 " us (%s)",
+                  first_frame_latency_, pooled_ ? "pooled" : "cold");
+  GetPipelinePool()->RecordFirstFrame(pooled_, first_frame_latency_);
+}
+
+void PlayerImpl::DispatchOnWorkerThread(const DispatchItem& item) const {
+  DispatchItem queued = item;
+  queued.queued_at = SbTimeGetMonotonicNow();
+
+  if (dispatch_overflowing_.load(std::memory_order_acquire) ||
+      !dispatch_queue_.TryPush(queued)) {
+    // Callers may hold |mutex_| which the player thread needs to make
+    // progress, never wait for room here.
+    ::starboard::ScopedLock lock(dispatch_overflow_mutex_);
+    if (dispatch_overflow_.empty())
+      GST_WARNING("Dispatch queue full, overflowing");
+    dispatch_overflow_.push_back(queued);
+    dispatch_overflowing_.store(true, std::memory_order_release);
+    ++dispatch_overflows_;
+  }
+
+  uint64_t depth = dispatch_queue_.Size();
+  uint64_t hwm = dispatch_depth_hwm_.load(std::memory_order_relaxed);
+  while (hwm < depth &&
+         !dispatch_depth_hwm_.compare_exchange_weak(hwm, depth, std::memory_order_relaxed)) {
+  }
+
+  SignalDispatch();
+}
+
+void PlayerImpl::SignalDispatch() const {
+  if (dispatch_fd_ < 0) {
+    g_source_set_ready_time(dispatch_source_, 0);
+    return;
+  }
+  uint64_t value = 1;
+  if (write(dispatch_fd_, &value, sizeof(value)) < 0 && errno != EAGAIN)
+    GST_ERROR("Failed to signal dispatch, error: %d (%s)", errno, strerror(errno));
+}
+
+void PlayerImpl::DispatchPlayerStatus(int ticket, SbPlayerState state) const {
+  DispatchItem item {};
+  item.type = DispatchItem::Type::kPlayerStatus;
+  item.ticket = ticket;
+  item.player_state = state;
+  DispatchOnWorkerThread(item);
+}
+
+void PlayerImpl::DispatchDecoderStatus(int ticket,
+                                       SbPlayerDecoderState state,
+                                       MediaType media) const {
+  DispatchItem item {};
+  item.type = DispatchItem::Type::kDecoderStatus;
+  item.ticket = ticket;
+  item.decoder_state = state;
+  item.media = media;
+  DispatchOnWorkerThread(item);
+}
+
+void PlayerImpl::DispatchPlayerError(SbPlayerError error, const char* message) const {
+  DispatchItem item {};
+  item.type = DispatchItem::Type::kPlayerError;
+  item.error = error;
+  g_strlcpy(item.message, message ? message : "", sizeof(item.message));
+  DispatchOnWorkerThread(item);
+}
+
+// Returns false once the player got destroyed, no more callbacks may run then.
+bool PlayerImpl::RunDispatchItem(const DispatchItem& item) const {
+  SbTime latency = SbTimeGetMonotonicNow() - item.queued_at;
+  ++dispatched_items_;
+  dispatch_latency_total_.fetch_add(latency, std::memory_order_relaxed);
+  int64_t max_latency = dispatch_latency_max_.load(std::memory_order_relaxed);
+  while (max_latency < latency &&
+         !dispatch_latency_max_.compare_exchange_weak(max_latency, latency, std::memory_order_relaxed)) {
+  }
+
+  GST_TRACE("%d", SbThreadGetId());
+  switch (item.type) {
+    case DispatchItem::Type::kPlayerStatus:
+      GST_TRACE("PlayerStatus state:%d (%s), ticket:%d", item.player_state,
+                PlayerStateToStr(item.player_state), item.ticket);
+      player_status_func_(player_, context_, item.player_state, item.ticket);
+      break;
+    case DispatchItem::Type::kPlayerDestroyed:
+      GST_TRACE("PlayerDestroyed ticket:%d", item.ticket);
+      player_status_func_(player_, context_, kSbPlayerStateDestroyed, item.ticket);
+      g_main_loop_quit(main_loop_);
+      return false;
+    case DispatchItem::Type::kDecoderStatus:
+      GST_TRACE("DecoderStatus state:%d (%s), ticket:%d, media:%d", item.decoder_state,
+                DecoderStateToStr(item.decoder_state), item.ticket, static_cast<int>(item.media));
+      if ((static_cast<int>(item.media) & static_cast<int>(MediaType::kAudio)) != 0)
+        decoder_status_func_(player_, context_, kSbMediaTypeAudio, item.decoder_state, item.ticket);
+      if ((static_cast<int>(item.media) & static_cast<int>(MediaType::kVideo)) != 0)
+        decoder_status_func_(player_, context_, kSbMediaTypeVideo, item.decoder_state, item.ticket);
+      break;
+    case DispatchItem::Type::kPlayerError:
+      GST_TRACE("PlayerError %d: %s", item.error, item.message);
+      player_error_func_(player_, context_, item.error, item.message);
+      break;
+  }
+  return true;
+}
+
+// static
+gboolean PlayerImpl::DispatchQueuedItems(gpointer user_data) {
+  PlayerImpl* self = static_cast<PlayerImpl*>(user_data);
+  uint64_t value = 0;
+  if (self->dispatch_fd_ < 0)
+    g_source_set_ready_time(self->dispatch_source_, -1);
+  else if (read(self->dispatch_fd_, &value, sizeof(value)) < 0 && errno != EAGAIN)
+    GST_ERROR("Failed to read dispatch fd, error: %d (%s)", errno, strerror(errno));
+
+  while (self->DrainDispatchQueue()) {
+    if (!self->dispatch_overflowing_.load(std::memory_order_acquire))
+      break;
+    std::vector<DispatchItem> overflow;
+    {
+      ::starboard::ScopedLock lock(self->dispatch_overflow_mutex_);
+      if (self->dispatch_overflow_.empty()) {
+        self->dispatch_overflowing_.store(false, std::memory_order_release);
+        continue;
+      }
+      overflow.swap(self->dispatch_overflow_);
+    }
+    // Whatever made it into the queue before the overflow goes first.
+    if (!self->DrainDispatchQueue())
+      break;
+    for (const DispatchItem& item : overflow) {
+      if (!self->RunDispatchItem(item)) {
+        self->dispatch_destroyed_ = true;
+        break;
+      }
+    }
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+// Returns false once the player got destroyed.
+bool PlayerImpl::DrainDispatchQueue() {
+  DispatchItem item;
+  while (!dispatch_destroyed_ && dispatch_queue_.TryPop(item)) {
+    if (!RunDispatchItem(item))
+      dispatch_destroyed_ = true;
+  }
+  return !dispatch_destroyed_;
 }
 
 // static
@@ -1794,11 +2744,15 @@ gboolean PlayerImpl::FinishSourceSetup(gpointer user_data) {
     gst_cobalt_src_setup_and_add_app_src(kSbMediaTypeAudio,
         source, self->audio_appsrc_, self->audio_caps_,
         &callbacks, self, has_drm_system);
+    if (self->sample_tracer_)
+      self->sample_tracer_->TraceSource(kSbMediaTypeAudio, self->audio_appsrc_);
   }
   if (self->video_codec_ != kSbMediaVideoCodecNone) {
     gst_cobalt_src_setup_and_add_app_src(kSbMediaTypeVideo,
         source, self->video_appsrc_, self->video_caps_,
         &callbacks, self, has_drm_system);
+    if (self->sample_tracer_)
+      self->sample_tracer_->TraceSource(kSbMediaTypeVideo, self->video_appsrc_);
   }
   gst_cobalt_src_all_app_srcs_added(self->source_);
   self->source_setup_id_ = -1;
@@ -1892,6 +2846,9 @@ void PlayerImpl::SetupSource(GstElement* pipeline,
 void PlayerImpl::SetupElement(GstElement* pipeline,
                               GstElement* element,
                               PlayerImpl* self) {
+  if (GST_IS_BASE_SINK(element) && self->sample_tracer_)
+    self->sample_tracer_->TraceSink(element);
+
   if (GST_IS_BASE_SINK(element)) {
     static bool disable_wait_video = !!getenv("COBALT_AML_DISABLE_WAIT_VIDEO");
     bool has_video = (self->video_codec_ != kSbMediaVideoCodecNone);
@@ -1963,12 +2920,67 @@ bool PlayerImpl::WriteSample(SbMediaType sample_type, GstBuffer* buffer, uint64_
     "SampleType:%d %" GST_TIME_FORMAT " id:%llu b:%p",
     sample_type, GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buffer)), serial_id, buffer);
 
+  if (sample_tracer_)
+    sample_tracer_->OnSampleWritten(sample_type, serial_id, GST_BUFFER_PTS(buffer));
+
   gst_app_src_push_buffer(GST_APP_SRC(src), buffer);
 
+  OnSamplesWritten(sample_type);
+  return true;
+}
+
+bool PlayerImpl::WriteSamples(SbMediaType sample_type, GstBufferList* buffers, uint64_t first_serial_id) {
+  GstElement* src = nullptr;
+  if (sample_type == kSbMediaTypeVideo) {
+    src = video_appsrc_;
+  } else {
+    src = audio_appsrc_;
+  }
+
+  GstDebugLevel log_level = GST_LEVEL_TRACE;
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    if (sample_type == kSbMediaTypeVideo)
+      decoder_state_data_ &= ~static_cast<int>(MediaType::kVideo);
+    else
+      decoder_state_data_ &= ~static_cast<int>(MediaType::kAudio);
+
+    if (state_ < State::kPresenting)
+      log_level = GST_LEVEL_DEBUG;
+  }
+
+  guint length = gst_buffer_list_length(buffers);
+  for (guint i = 0; i < length; ++i) {
+    GstBuffer* buffer = gst_buffer_list_get(buffers, i);
+    GST_CAT_LEVEL_LOG (
+      GST_CAT_DEFAULT, log_level, src,
+      "SampleType:%d %" GST_TIME_FORMAT " id:%llu b:%p",
+      sample_type, GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buffer)), first_serial_id + i, buffer);
+    if (sample_tracer_)
+      sample_tracer_->OnSampleWritten(sample_type, first_serial_id + i, GST_BUFFER_PTS(buffer));
+  }
+
+#if GST_CHECK_VERSION(1,14,0)
+  gst_app_src_push_buffer_list(GST_APP_SRC(src), buffers);
+#else
+  for (guint i = 0; i < length; ++i) {
+    gst_app_src_push_buffer(GST_APP_SRC(src),
+                            gst_buffer_ref(gst_buffer_list_get(buffers, i)));
+  }
+  gst_buffer_list_unref(buffers);
+#endif
+
+  OnSamplesWritten(sample_type);
+  return true;
+}
+
+void PlayerImpl::OnSamplesWritten(SbMediaType sample_type) {
   ::starboard::ScopedLock lock(mutex_);
+  GstElement* src = (sample_type == kSbMediaTypeVideo) ? video_appsrc_ : audio_appsrc_;
+
   // Wait for need-data to trigger instead.
   if (state_ == State::kInitial || state_ == State::kInitialPreroll)
-    return true;
+    return;
 
   MediaType media = sample_type == kSbMediaTypeVideo
     ? MediaType::kVideo
@@ -1990,37 +3002,25 @@ bool PlayerImpl::WriteSample(SbMediaType sample_type, GstBuffer* buffer, uint64_
   } else {
     GST_LOG_OBJECT(src, "Has enough data");
   }
-
-  return true;
 }
 
-void PlayerImpl::WriteSample(SbMediaType sample_type,
-                             const SbPlayerSampleInfo* sample_infos,
-                             int number_of_sample_infos) {
-  static_assert(kMaxNumberOfSamplesPerWrite == 1,
-                "Adjust impl. to handle more samples after changing samples"
-                "count");
-  SB_DCHECK(number_of_sample_infos == kMaxNumberOfSamplesPerWrite);
-  // For debuggin purposes it could be usefull to disable audio or video
-  // in this case just drop the sample
-  if (audio_codec_ == kSbMediaAudioCodecNone && sample_type == kSbMediaTypeAudio) {
-      sample_deallocate_func_(player_, context_, sample_infos[0].buffer);
-      return;
-  }
-  if (video_codec_ == kSbMediaVideoCodecNone && sample_type == kSbMediaTypeVideo) {
-      sample_deallocate_func_(player_, context_, sample_infos[0].buffer);
-      return;
+GstBuffer* PlayerImpl::CreateSampleBuffer(SbMediaType sample_type,
+                                          const SbPlayerSampleInfo& sample_info) {
+  static const bool kDisableZeroCopyWrite = !!getenv("COBALT_DISABLE_ZERO_COPY_WRITE");
+  GstClockTime timestamp = sample_info.timestamp * kSbTimeNanosecondsPerMicrosecond;
+  GstBuffer* buffer = nullptr;
+  if (!kDisableZeroCopyWrite && sample_info.buffer_size > 0) {
+    buffer = WrapSampleBuffer(sample_info.buffer, sample_info.buffer_size);
+  } else {
+    buffer = SamplePool::Get(sample_type)->AllocateAndFill(
+        sample_info.buffer, sample_info.buffer_size);
+    sample_deallocate_func_(player_, context_, sample_info.buffer);
+    bytes_copied_.fetch_add(sample_info.buffer_size, std::memory_order_relaxed);
   }
-  GstClockTime timestamp = sample_infos[0].timestamp * kSbTimeNanosecondsPerMicrosecond;
-  GstBuffer* buffer =
-      gst_buffer_new_allocate(nullptr, sample_infos[0].buffer_size, nullptr);
-  gsize sz = gst_buffer_fill(buffer, 0, sample_infos[0].buffer, sample_infos[0].buffer_size);
-  SB_DCHECK(sz == sample_infos[0].buffer_size);
   GST_BUFFER_TIMESTAMP(buffer) = timestamp;
-  sample_deallocate_func_(player_, context_, sample_infos[0].buffer);
 
-  if (sample_infos[0].type == kSbMediaTypeVideo) {
-    const auto& info = sample_infos[0].video_sample_info;
+  if (sample_type == kSbMediaTypeVideo) {
+    const auto& info = sample_info.video_sample_info;
     if (frame_width_ != info.frame_width ||
         frame_height_ != info.frame_height ||
         CompareColorMetadata(color_metadata_, info.color_metadata) != 0) {
@@ -2042,128 +3042,138 @@ void PlayerImpl::WriteSample(SbMediaType sample_type,
     }
   }
 
-  RecordTimestamp(sample_type, timestamp);
+  if (sample_info.drm_info) {
+    GST_LOG("Encounterd encrypted %s sample",
+            sample_type == kSbMediaTypeVideo ? "video" : "audio");
+    SB_DCHECK(drm_system_);
 
-  if (MinTimestamp(nullptr) == GST_BUFFER_TIMESTAMP(buffer) &&
-      GST_STATE(pipeline_) <= GST_STATE_PAUSED &&
-      (GST_STATE_PENDING(pipeline_) == GST_STATE_VOID_PENDING ||
-       GST_STATE_PENDING(pipeline_) == GST_STATE_PAUSED) &&
-      rate_ > .0) {
+    GST_LOG("Encryption scheme %s, pattern %u:%u",
+            sample_info.drm_info->encryption_scheme == kSbDrmEncryptionSchemeAesCtr ? "Ctr" :
+            (sample_info.drm_info->encryption_scheme == kSbDrmEncryptionSchemeAesCbc ? "Cbc" : "Unknown"),
+            sample_info.drm_info->encryption_pattern.crypt_byte_block,
+            sample_info.drm_info->encryption_pattern.skip_byte_block);
 
-    gint64 seek_pos_ns = GST_CLOCK_TIME_NONE;
-    {
-      ::starboard::ScopedLock lock(mutex_);
-      if (seek_position_ != kSbTimeMax)
-        seek_pos_ns =  seek_position_ * kSbTimeNanosecondsPerMicrosecond;
-    }
+    if (!AddDrmMeta(buffer, *sample_info.drm_info))
+      GST_ERROR("Failed to add DRM meta");
+  } else {
+    GST_LOG("Encounterd clear %s sample",
+            sample_type == kSbMediaTypeVideo ? "video" : "audio");
+  }
 
-    if (!GST_CLOCK_TIME_IS_VALID(seek_pos_ns) || GST_BUFFER_TIMESTAMP(buffer) >= seek_pos_ns) {
-      GST_TRACE("Moving to playing for %" GST_TIME_FORMAT,
-                GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buffer)));
-      ChangePipelineState(GST_STATE_PLAYING);
-    }
+  return buffer;
+}
+
+void PlayerImpl::WriteSample(SbMediaType sample_type,
+                             const SbPlayerSampleInfo* sample_infos,
+                             int number_of_sample_infos) {
+  SB_DCHECK(number_of_sample_infos > 0 &&
+            number_of_sample_infos <= MaxNumberOfSamplesPerWrite(sample_type));
+  // For debuggin purposes it could be usefull to disable audio or video
+  // in this case just drop the sample
+  if ((audio_codec_ == kSbMediaAudioCodecNone && sample_type == kSbMediaTypeAudio) ||
+      (video_codec_ == kSbMediaVideoCodecNone && sample_type == kSbMediaTypeVideo)) {
+    for (int i = 0; i < number_of_sample_infos; ++i)
+      sample_deallocate_func_(player_, context_, sample_infos[i].buffer);
+    return;
   }
 
-  if (sample_infos[0].drm_info) {
-    GST_LOG("Encounterd encrypted %s sample",
-            sample_type == kSbMediaTypeVideo ? "video" : "audio");
-    SB_DCHECK(drm_system_);
+  GstBufferList* buffers = gst_buffer_list_new_sized(number_of_sample_infos);
+  GstClockTime last_timestamp = GST_CLOCK_TIME_NONE;
+  for (int i = 0; i < number_of_sample_infos; ++i) {
+    GstBuffer* buffer = CreateSampleBuffer(sample_type, sample_infos[i]);
+    last_timestamp = GST_BUFFER_TIMESTAMP(buffer);
+    gst_buffer_list_add(buffers, buffer);
+  }
 
-    GST_LOG("Encryption scheme %s",
-            sample_infos[0].drm_info->encryption_scheme == kSbDrmEncryptionSchemeAesCtr ? "Ctr" :
-            (sample_infos[0].drm_info->encryption_scheme == kSbDrmEncryptionSchemeAesCbc ? "Cbc" : "Unknown") );
-
-    GstBuffer* subsamples = nullptr;
-    GstBuffer* iv = nullptr;
-    GstBuffer* key = nullptr;
-    uint32_t subsamples_count = 0u;
-    uint32_t iv_size = 0u;
-    const int8_t kEmptyArray[kMaxIvSize / 2] = {0};
-
-    key = gst_buffer_new_allocate(
-        nullptr, sample_infos[0].drm_info->identifier_size, nullptr);
-    gst_buffer_fill(key, 0, sample_infos[0].drm_info->identifier,
-                    sample_infos[0].drm_info->identifier_size);
-
-    iv_size = sample_infos[0].drm_info->initialization_vector_size;
-    if (iv_size == kMaxIvSize &&
-        memcmp(sample_infos[0].drm_info->initialization_vector + kMaxIvSize / 2,
-               kEmptyArray, kMaxIvSize / 2) == 0) {
-      iv_size /= 2;
-    }
-    iv = gst_buffer_new_allocate(nullptr, iv_size, nullptr);
-    gst_buffer_fill(iv, 0, sample_infos[0].drm_info->initialization_vector, iv_size);
-
-    subsamples_count = sample_infos[0].drm_info->subsample_count;
-    if (subsamples_count) {
-      auto subsamples_raw_size =
-        subsamples_count * (sizeof(guint16) + sizeof(guint32));
-      guint8* subsamples_raw =
-        static_cast<guint8*>(g_malloc(subsamples_raw_size));
-      GstByteWriter writer;
-      gst_byte_writer_init_with_data(&writer, subsamples_raw, subsamples_raw_size, FALSE);
-      for (uint32_t i = 0; i < subsamples_count; ++i) {
-        if (!gst_byte_writer_put_uint16_be(
-              &writer,
-              sample_infos[0].drm_info->subsample_mapping[i].clear_byte_count))
-          GST_ERROR("Failed writing clear subsample info at %d", i);
-        if (!gst_byte_writer_put_uint32_be(&writer,
-                                           sample_infos[0]
-                                           .drm_info->subsample_mapping[i]
-                                           .encrypted_byte_count))
-          GST_ERROR("Failed writing encrypted subsample info at %d", i);
+  {
+    // After a skip seek Cobalt resends samples that are still queued.
+    ::starboard::ScopedLock lock(mutex_);
+    GstClockTime& drop_until = skip_drop_until_[ (sample_type == kSbMediaTypeVideo ? kVideoIndex : kAudioIndex) ];
+    while (GST_CLOCK_TIME_IS_VALID(drop_until) && gst_buffer_list_length(buffers) > 0) {
+      if (GST_BUFFER_TIMESTAMP(gst_buffer_list_get(buffers, 0)) > drop_until) {
+        drop_until = GST_CLOCK_TIME_NONE;
+        break;
       }
-      subsamples = gst_buffer_new_wrapped(subsamples_raw, subsamples_raw_size);
+      gst_buffer_list_remove(buffers, 0, 1);
+      ++skip_seek_dropped_samples_;
     }
-
-    GstStructure* info = gst_structure_new (
-      "application/x-cenc",
-      "encrypted", G_TYPE_BOOLEAN, TRUE,
-      "kid", GST_TYPE_BUFFER, key,
-      "iv_size", G_TYPE_UINT, iv_size,
-      "iv", GST_TYPE_BUFFER, iv,
-      "subsample_count", G_TYPE_UINT, subsamples_count,
-      "subsamples", GST_TYPE_BUFFER, subsamples,
-      "encryption_scheme", G_TYPE_UINT, sample_infos[0].drm_info->encryption_scheme,
-      NULL);
-
-    gst_buffer_add_protection_meta(buffer, info);
-
-    gst_buffer_unref(iv);
-    gst_buffer_unref(key);
-    gst_buffer_unref(subsamples);
-  } else {
-    GST_LOG("Encounterd clear %s sample",
+    if (sample_type == kSbMediaTypeVideo && (trick_play_ || trick_play_wait_key_frame_))
+      DropTrickPlayFramesLocked(buffers);
+  }
+  number_of_sample_infos = gst_buffer_list_length(buffers);
+  if (number_of_sample_infos == 0) {
+    GST_LOG("Dropped all %s samples (skip or trick play)",
             sample_type == kSbMediaTypeVideo ? "video" : "audio");
+    gst_buffer_list_unref(buffers);
+    OnSamplesWritten(sample_type);
+    return;
   }
 
+  // Serials, frame counters and timestamp bookkeeping are updated for the whole
+  // batch under a single lock.
   gint64 seek_pos_ns = GST_CLOCK_TIME_NONE;
   uint64_t serial = 0;
   bool keep_samples = false;
+  SbTime min_ts = kSbTimeMax;
+  double rate = .0;
+  bool rebuffering = false;
   {
     ::starboard::ScopedLock lock(mutex_);
     keep_samples = is_seek_pending_;
-    serial = samples_serial_[ (sample_type == kSbMediaTypeVideo ? kVideoIndex : kAudioIndex) ]++;
+    auto& samples_serial = samples_serial_[ (sample_type == kSbMediaTypeVideo ? kVideoIndex : kAudioIndex) ];
+    serial = samples_serial;
+    samples_serial += number_of_sample_infos;
     if (sample_type == kSbMediaTypeVideo)
-      ++total_video_frames_;
+      total_video_frames_ += number_of_sample_infos;
     if (seek_position_ != kSbTimeMax)
         seek_pos_ns =  seek_position_ * kSbTimeNanosecondsPerMicrosecond;
+    for (int i = 0; i < number_of_sample_infos; ++i) {
+      GstBuffer* buffer = gst_buffer_list_get(buffers, i);
+      RecordTimestamp(sample_type, GST_BUFFER_TIMESTAMP(buffer));
+      if (sample_type == kSbMediaTypeVideo) {
+        if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+          RecordKeyFrameLocked(GST_BUFFER_TIMESTAMP(buffer));
+        video_key_frames_end_ = std::max(video_key_frames_end_, GST_BUFFER_TIMESTAMP(buffer));
+      }
+    }
+    min_ts = MinTimestamp(nullptr);
+    rate = rate_;
+    rebuffering = buf_target_min_ts_ != kSbTimeMax;
+  }
+
+  // While rebuffering CheckBuffering() decides when to resume.
+  if (min_ts == last_timestamp && !rebuffering &&
+      GST_STATE(pipeline_) <= GST_STATE_PAUSED &&
+      (GST_STATE_PENDING(pipeline_) == GST_STATE_VOID_PENDING ||
+       GST_STATE_PENDING(pipeline_) == GST_STATE_PAUSED) &&
+      rate > .0) {
+    if (!GST_CLOCK_TIME_IS_VALID(seek_pos_ns) || last_timestamp >= seek_pos_ns) {
+      GST_TRACE("Moving to playing for %" GST_TIME_FORMAT,
+                GST_TIME_ARGS(last_timestamp));
+      ChangePipelineState(GST_STATE_PLAYING);
+    }
   }
 
-  if (GST_CLOCK_TIME_IS_VALID(seek_pos_ns) && seek_pos_ns > GST_BUFFER_TIMESTAMP(buffer)) {
-    // Set dummy duration to let sink drop out-of-segment samples
-    GST_BUFFER_DURATION (buffer) = GST_SECOND / 60;
-    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DECODE_ONLY);
+  if (GST_CLOCK_TIME_IS_VALID(seek_pos_ns)) {
+    for (int i = 0; i < number_of_sample_infos; ++i) {
+      GstBuffer* buffer = gst_buffer_list_get(buffers, i);
+      if (seek_pos_ns > GST_BUFFER_TIMESTAMP(buffer)) {
+        // Set dummy duration to let sink drop out-of-segment samples
+        GST_BUFFER_DURATION (buffer) = GST_SECOND / 60;
+        GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DECODE_ONLY);
+      }
+    }
   }
 
   if (keep_samples) {
-    GST_INFO("Pending flushing operation. Storing sample");
-    GST_INFO("SampleType:%d %" GST_TIME_FORMAT " id:%llu b:%" GST_PTR_FORMAT,
-             sample_type, GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buffer)), serial, buffer);
-    PendingSample sample(sample_type, buffer, serial);
-    buffer= nullptr;
+    GST_INFO("Pending flushing operation. Storing %d sample(s)", number_of_sample_infos);
     ::starboard::ScopedLock lock(mutex_);
-    pending_samples_.emplace_back(std::move(sample));
+    for (int i = 0; i < number_of_sample_infos; ++i) {
+      GstBuffer* buffer = gst_buffer_list_get(buffers, i);
+      GST_INFO("SampleType:%d %" GST_TIME_FORMAT " id:%llu b:%" GST_PTR_FORMAT,
+               sample_type, GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buffer)), serial + i, buffer);
+      pending_samples_.Add(sample_type, serial + i, buffer);
+    }
   }
 
   {
@@ -2179,50 +3189,18 @@ void PlayerImpl::WriteSample(SbMediaType sample_type,
     }
   }
 
-  if (keep_samples) {
-    PendingSamples local_samples;
-    {
-      ::starboard::ScopedLock lock(mutex_);
-      local_samples.swap(pending_samples_);
-    }
-
-    if(local_samples.empty()) {
-      GST_WARNING("No pending samples");
-      return;
-    }
-
-    auto& sample = local_samples.back();
-
-    SB_CHECK(sample.Type() == sample_type);
-
-    if (serial != sample.SerialID()) {
-      GST_WARNING("Detected out-of-order sample. Expected serial: %llu, sample serial: %llu",
-                  serial, sample.SerialID());
-    }
-
-    GstBuffer* buffer_copy = sample.CopyBuffer();
-    if (!WriteSample(sample.Type(), buffer_copy, sample.SerialID())) {
-      gst_buffer_unref(buffer_copy);
-    }
-
-    {
-      ::starboard::ScopedLock lock(mutex_);
-      std::move(local_samples.begin(), local_samples.end(),
-                std::back_inserter(pending_samples_));
-    }
-  } else {
-    if (!WriteSample(sample_type, buffer, serial)) {
-      gst_buffer_unref(buffer);
-    }
+  if (!WriteSamples(sample_type, buffers, serial)) {
+    gst_buffer_list_unref(buffers);
   }
 
-  GST_TRACE("Wrote sample.");
+  GST_TRACE("Wrote %d sample(s).", number_of_sample_infos);
 }
 
 void PlayerImpl::SetVolume(double volume) {
   GST_DEBUG_OBJECT(pipeline_, "volume %lf, TID %d", volume, SbThreadGetId());
   gst_stream_volume_set_volume(GST_STREAM_VOLUME(pipeline_),
                                GST_STREAM_VOLUME_FORMAT_LINEAR, volume);
+  volume_.store(volume, std::memory_order_relaxed);
 }
 
 void PlayerImpl::Seek(SbTime seek_to_timestamp, int ticket) {
@@ -2235,7 +3213,12 @@ void PlayerImpl::Seek(SbTime seek_to_timestamp, int ticket) {
                    SbThreadGetId(),
                    static_cast<int>(state_),
                    ticket);
+  if (TrySkipSeek(seek_to_timestamp, ticket, current_pos_ns))
+    return;
+
   double rate = 1.;
+  SeekMode mode = SeekMode::kAccurate;
+  SbTime pipeline_seek_to = seek_to_timestamp;
   {
     ::starboard::ScopedLock lock(mutex_);
     if (ticket_ > ticket) {
@@ -2244,13 +3227,23 @@ void PlayerImpl::Seek(SbTime seek_to_timestamp, int ticket) {
     }
 
     if (ticket_ != ticket) {
-      pending_samples_.clear();
+      CancelSkipSeekLocked();
+      if (state_ != State::kInitial) {
+        if (KeyUnitSeekTargetLocked(seek_to_timestamp) != seek_to_timestamp)
+          mode = SeekMode::kKeyUnit;
+        seek_started_at_ = SbTimeGetMonotonicNow();
+      }
+      seek_mode_ = mode;
+      pending_samples_.Reset(ticket);
+      if (sample_tracer_)
+        sample_tracer_->Reset();
       max_sample_timestamps_[kVideoIndex] = 0;
       max_sample_timestamps_[kAudioIndex] = 0;
       min_sample_timestamp_ = kSbTimeMax;
       samples_serial_[kVideoIndex] = 0;
       samples_serial_[kAudioIndex] = 0;
       buf_target_min_ts_ = kSbTimeMax;
+      buffering_.OnSeek();
       dropped_video_frames_ = 0;
       total_video_frames_ = 0;
     }
@@ -2259,14 +3252,13 @@ void PlayerImpl::Seek(SbTime seek_to_timestamp, int ticket) {
     seek_position_ = seek_to_timestamp;
     decoder_state_data_ = 0;
     eos_data_ = 0;
+    PublishSeekPositionLocked(seek_to_timestamp);
 
     if (state_ == State::kInitial) {
       SB_DCHECK(seek_position_ == .0);
       // This is the initial seek to 0 which will trigger data pumping.
       state_ = State::kInitialPreroll;
-      DispatchOnWorkerThread(new PlayerStatusTask(player_status_func_, player_,
-                                                  ticket_, context_,
-                                                  kSbPlayerStatePrerolling));
+      DispatchPlayerStatus(ticket_, kSbPlayerStatePrerolling);
       seek_position_ = kSbTimeMax;
       if (GST_STATE(pipeline_) < GST_STATE_PAUSED &&
           GST_STATE_PENDING(pipeline_) < GST_STATE_PAUSED) {
@@ -2294,30 +3286,239 @@ void PlayerImpl::Seek(SbTime seek_to_timestamp, int ticket) {
 
     is_seek_pending_ = false;
     rate = rate_;
+    mode = seek_mode_;
     state_ = State::kPrerollAfterSeek;
+    // Only the pipeline starts at the key frame, the reported position and
+    // the decode-only cutoff stay at the requested target.
+    if (mode == SeekMode::kKeyUnit) {
+      pipeline_seek_to = KeyUnitSeekTargetLocked(seek_to_timestamp);
+      GST_INFO_OBJECT(pipeline_, "Seeking pipeline to key frame at %" PRId64, pipeline_seek_to);
+    }
   }
 
   GST_DEBUG("Calling seek");
-  DispatchOnWorkerThread(new PlayerStatusTask(player_status_func_, player_,
-                                              ticket_, context_,
-                                              kSbPlayerStatePrerolling));
-  if (!gst_element_seek(pipeline_, !rate ? 1.0 : rate, GST_FORMAT_TIME,
-                        static_cast<GstSeekFlags>(GST_SEEK_FLAG_FLUSH |
-                                                  GST_SEEK_FLAG_ACCURATE),
+  DispatchPlayerStatus(ticket_, kSbPlayerStatePrerolling);
+  GstSeekFlags flags = mode == SeekMode::kKeyUnit
+      ? static_cast<GstSeekFlags>(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT |
+                                  GST_SEEK_FLAG_SNAP_BEFORE)
+      : static_cast<GstSeekFlags>(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE);
+  if (!gst_element_seek(pipeline_, !rate ? 1.0 : rate, GST_FORMAT_TIME, flags,
                         GST_SEEK_TYPE_SET,
-                        seek_to_timestamp * kSbTimeNanosecondsPerMicrosecond,
+                        pipeline_seek_to * kSbTimeNanosecondsPerMicrosecond,
                         GST_SEEK_TYPE_NONE, 0)) {
     GST_ERROR_OBJECT(pipeline_, "Seek failed");
     ::starboard::ScopedLock lock(mutex_);
-    DispatchOnWorkerThread(new PlayerStatusTask(player_status_func_, player_,
-                                                ticket_, context_,
-                                                kSbPlayerStatePresenting));
+    DispatchPlayerStatus(ticket_, kSbPlayerStatePresenting);
     state_ = State::kPresenting;
+    seek_started_at_ = -1;
   } else {
     GST_DEBUG("Seek called with success");
   }
 }
 
+bool PlayerImpl::TrySkipSeek(SbTime seek_to_timestamp, int ticket, gint64 position_ns) {
+  static const bool kEnableSkipSeek = !!getenv("COBALT_ENABLE_SKIP_SEEK");
+  // Data ahead of the target that must be queued for the skip to be worth it.
+  static constexpr GstClockTime kSkipSeekMargin = 500 * GST_MSECOND;
+  static constexpr SbTime kSkipSeekTimeout = 500 * kSbTimeMillisecond;
+
+  if (!kEnableSkipSeek || position_ns < 0)
+    return false;
+
+  GstClockTime target_ns = seek_to_timestamp * kSbTimeNanosecondsPerMicrosecond;
+  int previous_ticket;
+  SbTime previous_seek_position;
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    if (ticket_ >= ticket || state_ != State::kPresenting || is_seek_pending_ ||
+        skip_seek_pending_ || force_stop_ || rate_ != 1. || eos_data_ != 0)
+      return false;
+    if (GST_STATE(pipeline_) != GST_STATE_PLAYING ||
+        GST_STATE_PENDING(pipeline_) != GST_STATE_VOID_PENDING)
+      return false;
+    if (target_ns < static_cast<GstClockTime>(position_ns))
+      return false;
+    if (video_codec_ != kSbMediaVideoCodecNone &&
+        static_cast<GstClockTime>(max_sample_timestamps_[kVideoIndex]) < target_ns + kSkipSeekMargin)
+      return false;
+    if (audio_codec_ != kSbMediaAudioCodecNone &&
+        static_cast<GstClockTime>(max_sample_timestamps_[kAudioIndex]) < target_ns + kSkipSeekMargin)
+      return false;
+
+    // The samples Cobalt writes again after the seek are queued already,
+    // drop them until the streams move past what was written.
+    previous_ticket = ticket_;
+    previous_seek_position = seek_position_;
+    ticket_ = ticket;
+    pending_samples_.Reset(ticket);
+    decoder_state_data_ = 0;
+    buffering_.OnSeek();
+    skip_drop_until_[kVideoIndex] = max_sample_timestamps_[kVideoIndex];
+    skip_drop_until_[kAudioIndex] = max_sample_timestamps_[kAudioIndex];
+    skip_seek_pending_ = true;
+    skip_steps_pending_ = (video_codec_ != kSbMediaVideoCodecNone) +
+                          (audio_codec_ != kSbMediaAudioCodecNone);
+    seek_position_ = seek_to_timestamp;
+    seek_mode_ = SeekMode::kSkip;
+    seek_started_at_ = SbTimeGetMonotonicNow();
+    PublishSeekPositionLocked(seek_to_timestamp);
+  }
+
+  GST_INFO_OBJECT(pipeline_, "Skipping %" GST_TIME_FORMAT " of queued data",
+                  GST_TIME_ARGS(target_ns - position_ns));
+  DispatchPlayerStatus(ticket, kSbPlayerStatePrerolling);
+  GstEvent* step = gst_event_new_step(GST_FORMAT_TIME, target_ns - position_ns, 1.0, TRUE, FALSE);
+  bool stepped = gst_element_send_event(pipeline_, step);
+
+  ::starboard::ScopedLock lock(mutex_);
+  if (!stepped) {
+    GST_WARNING_OBJECT(pipeline_, "Step not handled, falling back to flushing seek");
+    ++skip_seeks_rejected_;
+    skip_seek_pending_ = false;
+    seek_position_ = previous_seek_position;
+    skip_drop_until_[kVideoIndex] = GST_CLOCK_TIME_NONE;
+    skip_drop_until_[kAudioIndex] = GST_CLOCK_TIME_NONE;
+    // Let Seek() see a new ticket and reset the sample bookkeeping.
+    ticket_ = previous_ticket;
+    return false;
+  }
+
+  if (skip_seek_pending_) {
+    // Vendor sinks may accept the step but never report it done, don't keep
+    // Cobalt waiting for the Presenting state in that case.
+    GSource* src = g_timeout_source_new(kSkipSeekTimeout / kSbTimeMillisecond);
+    g_source_set_callback(src, [] (gpointer data) ->gboolean {
+      static_cast<PlayerImpl*>(data)->CompleteSkipSeek(true);
+      return G_SOURCE_REMOVE;
+    }, this, nullptr);
+    skip_seek_timeout_id_ = g_source_attach(src, main_loop_context_);
+    g_source_unref(src);
+  }
+  DecoderNeedsData(lock, GetBothMediaTypeTakingCodecsIntoAccount());
+  return true;
+}
+
+void PlayerImpl::CompleteSkipSeek(bool timed_out) {
+  ::starboard::ScopedLock lock(mutex_);
+  if (!skip_seek_pending_)
+    return;
+  // Every sink steps on its own, presenting after the first one would leave
+  // the other stream behind.
+  if (!timed_out && --skip_steps_pending_ > 0)
+    return;
+  if (timed_out) {
+    GST_WARNING_OBJECT(pipeline_, "No step done in time, assuming the skip is complete");
+    ++skip_seek_timeouts_;
+    skip_seek_timeout_id_ = -1;
+  }
+  CancelSkipSeekLocked();
+  RecordSeekDoneLocked();
+  DispatchPlayerStatus(ticket_, kSbPlayerStatePresenting);
+}
+
+void PlayerImpl::CancelSkipSeekLocked() {
+  skip_seek_pending_ = false;
+  if (skip_seek_timeout_id_ > -1) {
+    GSource* src = g_main_context_find_source_by_id(main_loop_context_, skip_seek_timeout_id_);
+    if (src)
+      g_source_destroy(src);
+    skip_seek_timeout_id_ = -1;
+  }
+}
+
+SbTime PlayerImpl::KeyUnitSeekTargetLocked(SbTime seek_to_timestamp) const {
+  static const bool kAllowInexactSeek = !!getenv("COBALT_ALLOW_INEXACT_SEEK");
+  // Never start further than this before the requested position.
+  static constexpr GstClockTime kMaxKeyUnitSnap = 5 * GST_SECOND;
+
+  if (!kAllowInexactSeek || video_codec_ == kSbMediaVideoCodecNone)
+    return seek_to_timestamp;
+
+  // Only the range written so far tells where the preceding key frame is.
+  GstClockTime target_ns = seek_to_timestamp * kSbTimeNanosecondsPerMicrosecond;
+  if (target_ns > video_key_frames_end_)
+    return seek_to_timestamp;
+  auto it = video_key_frames_.upper_bound(target_ns);
+  if (it == video_key_frames_.begin())
+    return seek_to_timestamp;
+  --it;
+  if (target_ns - *it > kMaxKeyUnitSnap)
+    return seek_to_timestamp;
+  return *it / kSbTimeNanosecondsPerMicrosecond;
+}
+
+void PlayerImpl::RecordKeyFrameLocked(GstClockTime timestamp) {
+  static constexpr size_t kMaxKeyFrames = 512;
+  video_key_frames_.insert(timestamp);
+  if (video_key_frames_.size() > kMaxKeyFrames)
+    video_key_frames_.erase(video_key_frames_.begin());
+}
+
+bool PlayerImpl::UpdateTrickPlayLocked(double rate) {
+  static const double kTrickPlayRate = ReadEnvPositive("COBALT_TRICK_PLAY_RATE", 4.);
+
+  // Pausing keeps the current mode.
+  if (rate == .0 || video_codec_ == kSbMediaVideoCodecNone)
+    return false;
+  bool trick_play = rate >= kTrickPlayRate;
+  if (trick_play == trick_play_)
+    return false;
+
+  GST_INFO_OBJECT(pipeline_, "%s key frame only playback (rate %lf)",
+                  trick_play ? "Entering" : "Leaving", rate);
+  trick_play_ = trick_play;
+  trick_play_last_key_frame_ = GST_CLOCK_TIME_NONE;
+  // Delta frames written from now on would reference dropped ones.
+  trick_play_wait_key_frame_ = !trick_play;
+  if (trick_play)
+    ++trick_play_sessions_;
+  return true;
+}
+
+void PlayerImpl::DropTrickPlayFramesLocked(GstBufferList* buffers) {
+  // Upper bound for the key frames decoded per second of wall time.
+  static const double kTrickPlayMaxFps = ReadEnvPositive("COBALT_TRICK_PLAY_FPS", 8.);
+
+  GstClockTime min_interval = GST_CLOCK_TIME_NONE;
+  if (trick_play_)
+    min_interval = static_cast<GstClockTime>(rate_ / kTrickPlayMaxFps * GST_SECOND);
+
+  guint i = 0;
+  while (i < gst_buffer_list_length(buffers)) {
+    GstBuffer* buffer = gst_buffer_list_get(buffers, i);
+    GstClockTime timestamp = GST_BUFFER_TIMESTAMP(buffer);
+    if (!trick_play_ && !trick_play_wait_key_frame_)
+      break;
+    if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+      gst_buffer_list_remove(buffers, i, 1);
+      ++trick_play_discarded_frames_;
+      continue;
+    }
+    if (trick_play_ && GST_CLOCK_TIME_IS_VALID(min_interval) &&
+        GST_CLOCK_TIME_IS_VALID(trick_play_last_key_frame_) &&
+        timestamp >= trick_play_last_key_frame_ &&
+        timestamp - trick_play_last_key_frame_ < min_interval) {
+      gst_buffer_list_remove(buffers, i, 1);
+      ++trick_play_thinned_frames_;
+      continue;
+    }
+    trick_play_last_key_frame_ = timestamp;
+    trick_play_wait_key_frame_ = false;
+    ++i;
+  }
+}
+
+void PlayerImpl::RecordSeekDoneLocked() {
+  if (seek_started_at_ < 0)
+    return;
+  SbTime latency = SbTimeGetMonotonicNow() - seek_started_at_;
+  static const char* kModeNames[] = { "skip", "keyunit", "accurate" };
+  GST_INFO_OBJECT(pipeline_, "Seek (%s) presenting after %" PRId64 " us",
+                  kModeNames[static_cast<int>(seek_mode_)], latency);
+  seek_latency_[static_cast<int>(seek_mode_)].Add(latency);
+  seek_started_at_ = -1;
+}
+
 bool PlayerImpl::SetRate(double rate) {
   GST_DEBUG_OBJECT(pipeline_, "===> rate %lf (rate_ %lf), TID: %d", rate, rate_,
                    SbThreadGetId());
@@ -2327,6 +3528,19 @@ bool PlayerImpl::SetRate(double rate) {
     ::starboard::ScopedLock lock(mutex_);
     decoder_state_data_ = 0;
     eos_data_ = 0;
+    // The audio keeps the clock running, only silence it. Whatever mute
+    // state was there before comes back afterwards. The player thread
+    // calls SetRate() too, so the save and the restore stay under the lock.
+    if (UpdateTrickPlayLocked(rate)) {
+      if (trick_play_) {
+        gboolean muted = FALSE;
+        g_object_get(pipeline_, "mute", &muted, nullptr);
+        trick_play_restore_mute_ = muted;
+        g_object_set(pipeline_, "mute", TRUE, nullptr);
+      } else {
+        g_object_set(pipeline_, "mute", trick_play_restore_mute_, nullptr);
+      }
+    }
   }
 
   if (rate == .0) {
@@ -2365,9 +3579,14 @@ bool PlayerImpl::SetRate(double rate) {
       return false;
     })();
     if (kEnableInstantRateChangeSeek) {
+      // The trick mode flags travel with the instant rate change, so
+      // decoders and sinks that honour them can skip work as well.
+      int trick_mode_flags = trick_play
+          ? (GST_SEEK_FLAG_TRICKMODE | GST_SEEK_FLAG_TRICKMODE_KEY_UNITS | GST_SEEK_FLAG_TRICKMODE_NO_AUDIO)
+          : 0;
       success = gst_element_seek(
         pipeline_, rate, GST_FORMAT_TIME,
-        static_cast<GstSeekFlags>(GST_SEEK_FLAG_INSTANT_RATE_CHANGE),
+        static_cast<GstSeekFlags>(GST_SEEK_FLAG_INSTANT_RATE_CHANGE | trick_mode_flags),
         GST_SEEK_TYPE_NONE, 0,
         GST_SEEK_TYPE_NONE, 0);
     }
@@ -2384,8 +3603,11 @@ bool PlayerImpl::SetRate(double rate) {
   }
 
   if (success) {
-    ::starboard::ScopedLock lock(mutex_);
-    rate_ = rate;
+    {
+      ::starboard::ScopedLock lock(mutex_);
+      rate_ = rate;
+    }
+    PublishPlaybackState();
   } else {
     GST_ERROR_OBJECT(pipeline_, "Set rate failed");
   }
@@ -2394,46 +3616,95 @@ bool PlayerImpl::SetRate(double rate) {
 }
 
 void PlayerImpl::GetInfo(SbPlayerInfo2* out_player_info) {
-  gint64 duration = 0;
-  if (gst_element_query_duration(pipeline_, GST_FORMAT_TIME, &duration) &&
-      GST_CLOCK_TIME_IS_VALID(duration)) {
-    out_player_info->duration = duration;
-  } else {
-    out_player_info->duration = SB_PLAYER_NO_DURATION;
+  // Cobalt polls this often, so no pipeline queries or locks here. The state
+  // is published by the player thread (see PublishPlaybackState()).
+  PlaybackState state = playback_state_.Load();
+
+  gint64 position = state.position_ns;
+  if (!state.is_paused && !state.is_seeking && state.rate != .0) {
+    SbTime elapsed = std::min(SbTimeGetMonotonicNow() - state.updated_at,
+                              kMaxPositionExtrapolation);
+    position += static_cast<gint64>(
+        elapsed * kSbTimeNanosecondsPerMicrosecond * state.rate);
+    if (GST_CLOCK_TIME_IS_VALID(state.duration_ns))
+      position = std::min(position, state.duration_ns);
+    position = std::max<gint64>(position, 0);
   }
 
-  gint64 position = GetPosition();
-
-  CheckBuffering(position);
-
-  GST_TRACE("Position: %" GST_TIME_FORMAT " (Seek to: %" GST_TIME_FORMAT
+  GST_TRACE("Position: %" GST_TIME_FORMAT " (published: %" GST_TIME_FORMAT
             ") Duration: %" GST_TIME_FORMAT,
             GST_TIME_ARGS(position),
-            GST_TIME_ARGS(seek_position_ * kSbTimeNanosecondsPerMicrosecond),
-            GST_TIME_ARGS(duration));
+            GST_TIME_ARGS(state.position_ns),
+            GST_TIME_ARGS(state.duration_ns));
 
+  out_player_info->duration = GST_CLOCK_TIME_IS_VALID(state.duration_ns)
+                                  ? state.duration_ns
+                                  : SB_PLAYER_NO_DURATION;
   out_player_info->current_media_timestamp =
-      GST_CLOCK_TIME_IS_VALID(position)
-          ? position / kSbTimeNanosecondsPerMicrosecond
-          : 0;
-
+      position / kSbTimeNanosecondsPerMicrosecond;
   out_player_info->frame_width = frame_width_;
   out_player_info->frame_height = frame_height_;
-  out_player_info->is_paused = GST_STATE(pipeline_) != GST_STATE_PLAYING;
-  out_player_info->volume = gst_stream_volume_get_volume(
-      GST_STREAM_VOLUME(pipeline_), GST_STREAM_VOLUME_FORMAT_LINEAR);
-  out_player_info->total_video_frames = total_video_frames_;
+  out_player_info->is_paused = state.is_paused;
+  out_player_info->volume = volume_.load(std::memory_order_relaxed);
+  out_player_info->total_video_frames = state.total_video_frames;
+  out_player_info->dropped_video_frames = state.dropped_video_frames;
   out_player_info->corrupted_video_frames = 0;
 
+  GST_LOG("Frames dropped: %d, Frames corrupted: %d",
+          out_player_info->dropped_video_frames,
+          out_player_info->corrupted_video_frames);
+  out_player_info->playback_rate = state.rate;
+}
+
+gint64 PlayerImpl::PublishPlaybackState() {
+  PlaybackState state;
   {
+    // Read the epoch before querying, a seek which happens meanwhile
+    // publishes a newer one and this update gets dropped.
     ::starboard::ScopedLock lock(mutex_);
-    out_player_info->dropped_video_frames = dropped_video_frames_;
+    state.epoch = seek_epoch_;
   }
 
-  GST_LOG("Frames dropped: %d, Frames corrupted: %d",
-          out_player_info->dropped_video_frames,
-          out_player_info->corrupted_video_frames);
-  out_player_info->playback_rate = rate_;
+  gint64 duration = 0;
+  if (gst_element_query_duration(pipeline_, GST_FORMAT_TIME, &duration) &&
+      GST_CLOCK_TIME_IS_VALID(duration)) {
+    state.duration_ns = duration;
+  }
+
+  gint64 position = GetPosition();
+  state.position_ns = GST_CLOCK_TIME_IS_VALID(position) ? position : 0;
+  state.updated_at = SbTimeGetMonotonicNow();
+  state.is_paused = GST_STATE(pipeline_) != GST_STATE_PLAYING;
+
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    state.rate = rate_;
+    state.is_seeking = seek_position_ != kSbTimeMax;
+    state.dropped_video_frames = dropped_video_frames_;
+    state.total_video_frames = total_video_frames_;
+  }
+
+  StorePlaybackState(state);
+  return position;
+}
+
+void PlayerImpl::PublishSeekPositionLocked(SbTime seek_to_timestamp) {
+  PlaybackState state = playback_state_.Load();
+  state.epoch = ++seek_epoch_;
+  state.position_ns = seek_to_timestamp * kSbTimeNanosecondsPerMicrosecond;
+  state.updated_at = SbTimeGetMonotonicNow();
+  state.is_seeking = true;
+  state.rate = rate_;
+  state.dropped_video_frames = dropped_video_frames_;
+  state.total_video_frames = total_video_frames_;
+  StorePlaybackState(state);
+}
+
+void PlayerImpl::StorePlaybackState(const PlaybackState& state) {
+  ::starboard::ScopedLock lock(playback_state_mutex_);
+  if (state.epoch < playback_state_.Epoch())
+    return;
+  playback_state_.Store(state);
 }
 
 void PlayerImpl::SetBounds(int zindex, int x, int y, int w, int h) {
@@ -2505,43 +3776,60 @@ void PlayerImpl::CheckBuffering(gint64 position) {
   if (!GST_CLOCK_TIME_IS_VALID(position))
     return;
 
-  constexpr SbTime kMarginNs =
-      350 * kSbTimeMillisecond * kSbTimeNanosecondsPerMicrosecond;
-
   MediaType origin = MediaType::kNone;
   SbTime min_ts = MinTimestamp(&origin);
 
   if (min_ts == kSbTimeMax)
     return;
 
-  if (min_ts + kMarginNs <= position &&
-      GST_STATE(pipeline_) == GST_STATE_PLAYING &&
-      GST_STATE_PENDING(pipeline_) != GST_STATE_PAUSED) {
-    {
-      ::starboard::ScopedLock lock(mutex_);
-      DecoderNeedsData(lock, origin);
-      buf_target_min_ts_ = min_ts + kMarginNs;
+  bool playing = GST_STATE(pipeline_) == GST_STATE_PLAYING &&
+                 GST_STATE_PENDING(pipeline_) != GST_STATE_PAUSED;
+  uint64_t ingested = bytes_wrapped_.load(std::memory_order_relaxed) +
+                      bytes_copied_.load(std::memory_order_relaxed);
+  gint64 ahead = min_ts - position;
+  bool should_pause = false;
+  bool should_resume = false;
+  gint64 low = 0, high = 0;
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    bool starved = (has_enough_data_ & static_cast<int>(origin)) == 0;
+    buffering_.Update(SbTimeGetMonotonicNow(), position, min_ts, playing, starved, ingested);
+    if (buf_target_min_ts_ == kSbTimeMax) {
+      should_pause = playing && buffering_.ShouldPause(ahead);
+      if (should_pause) {
+        DecoderNeedsData(lock, origin);
+        buf_target_min_ts_ = position + buffering_.HighWatermark();
+        buffering_.OnRebufferStart(SbTimeGetMonotonicNow(), ahead);
+        low = buffering_.LowWatermark();
+        high = buffering_.HighWatermark();
+      }
+    } else if (min_ts >= buf_target_min_ts_) {
+      should_resume = true;
+      buf_target_min_ts_ = kSbTimeMax;
+      buffering_.OnRebufferEnd(SbTimeGetMonotonicNow());
     }
+  }
 
+  if (should_pause) {
     PrintPositionPerSink(pipeline_);
     GST_WARNING("Force setting to PAUSED. Pos: %" GST_TIME_FORMAT
-                " sample:%" GST_TIME_FORMAT,
-                GST_TIME_ARGS(position), GST_TIME_ARGS(min_ts + kMarginNs));
+                " sample:%" GST_TIME_FORMAT " (watermarks low: %" G_GINT64_FORMAT
+                " ms, high: %" G_GINT64_FORMAT " ms)",
+                GST_TIME_ARGS(position), GST_TIME_ARGS(min_ts),
+                low / GST_MSECOND, high / GST_MSECOND);
 
     ChangePipelineState(GST_STATE_PAUSED);
-  } else if (buf_target_min_ts_ != kSbTimeMax && min_ts > buf_target_min_ts_) {
+  } else if (should_resume) {
     double rate;
-    SbTime buf_target_min_ts = buf_target_min_ts_;
     {
       ::starboard::ScopedLock lock(mutex_);
-      buf_target_min_ts_ = kSbTimeMax;
       rate = rate_;
     }
     GstState state, pending;
     gst_element_get_state(pipeline_, &state, &pending, 0);
     if (rate > .0 && state != GST_STATE_PLAYING && pending != GST_STATE_PLAYING) {
-      GST_TRACE("Moving to playing, min_ts = %" GST_TIME_FORMAT " need %" GST_TIME_FORMAT,
-                GST_TIME_ARGS(min_ts), GST_TIME_ARGS(buf_target_min_ts));
+      GST_TRACE("Moving to playing, min_ts = %" GST_TIME_FORMAT " position %" GST_TIME_FORMAT,
+                GST_TIME_ARGS(min_ts), GST_TIME_ARGS(position));
       ChangePipelineState(GST_STATE_PLAYING);
     }
   }
@@ -2596,59 +3884,77 @@ gint64 PlayerImpl::GetPosition() const {
 }
 
 void PlayerImpl::WritePendingSamples() {
-  PendingSamples local_samples;
+  std::vector<PendingSampleStore::Sample> local_samples;
   bool keep_samples = false;
-  int ticket = -1;
   {
     ::starboard::ScopedLock lock(mutex_);
     keep_samples = is_seek_pending_;
-    ticket = ticket_;
-    local_samples.swap(pending_samples_);
+    // While another flush is pending the samples stay in the store and get
+    // replayed by reference again after it, no copies are made either way.
+    if (keep_samples)
+      pending_samples_.Snapshot(local_samples);
+    else
+      pending_samples_.Take(local_samples);
   }
 
-  if (!local_samples.empty()) {
-    std::sort(
-      local_samples.begin(), local_samples.end(),
-      [](const PendingSample& lhs, const PendingSample& rhs) -> bool {
-        return lhs.SerialID() < rhs.SerialID();
-      });
-    GstClockTime prev_timestamps[kMediaNumber] = {GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE};
-    for (auto& sample : local_samples) {
-      auto &prev_ts = prev_timestamps[sample.Type() == kSbMediaTypeVideo ? kVideoIndex : kAudioIndex];
+  if (local_samples.empty())
+    return;
 
-      if (prev_ts == sample.Timestamp()) {
-        GST_WARNING("Skipping %" GST_TIME_FORMAT ". Already written.",
-                    GST_TIME_ARGS(prev_ts));
-        continue;
-      }
+  GstClockTime prev_timestamps[kMediaNumber] = {GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE};
+  size_t replayed_bytes = 0;
+  size_t replayed_samples = 0;
+  for (auto& sample : local_samples) {
+    auto &prev_ts = prev_timestamps[sample.type == kSbMediaTypeVideo ? kVideoIndex : kAudioIndex];
+    GstBuffer* buffer = sample.buffer;
 
-      GstBuffer* buffer = keep_samples ? sample.CopyBuffer() : sample.TakeBuffer();
-      GST_INFO("Writing pending: SampleType:%d id:%llu b:%" GST_PTR_FORMAT, sample.Type(), sample.SerialID(), buffer);
-      prev_ts = GST_BUFFER_TIMESTAMP(buffer);
-      if (WriteSample(sample.Type(), buffer, sample.SerialID())) {
-        GST_INFO("Pending sample was written.");
-      } else {
-        gst_buffer_unref(buffer);
-      }
+    if (prev_ts == GST_BUFFER_TIMESTAMP(buffer)) {
+      GST_WARNING("Skipping %" GST_TIME_FORMAT ". Already written.",
+                  GST_TIME_ARGS(prev_ts));
+      gst_buffer_unref(buffer);
+      continue;
     }
 
-    if (keep_samples) {
-      {
-        ::starboard::ScopedLock lock(mutex_);
-        if (ticket_ == ticket) {
-          std::move(local_samples.begin(), local_samples.end(),
-                    std::back_inserter(pending_samples_));
-        } else {
-          keep_samples = false;
-        }
-      }
-      if (keep_samples) {
-        GST_INFO("Stored samples again.");
-      } else {
-        GST_INFO("Seek ticket changed (%d -> %d), dropped local samples.", ticket, ticket_);
-      }
+    GST_INFO("Writing pending: SampleType:%d id:%llu b:%" GST_PTR_FORMAT, sample.type, sample.serial, buffer);
+    prev_ts = GST_BUFFER_TIMESTAMP(buffer);
+    replayed_bytes += gst_buffer_get_size(buffer);
+    ++replayed_samples;
+    if (WriteSample(sample.type, buffer, sample.serial)) {
+      GST_INFO("Pending sample was written.");
+    } else {
+      gst_buffer_unref(buffer);
     }
   }
+
+  samples_replayed_.fetch_add(replayed_samples, std::memory_order_relaxed);
+  bytes_replayed_.fetch_add(replayed_bytes, std::memory_order_relaxed);
+  GST_INFO("Replayed %zu pending sample(s), %zu bytes (%s)",
+           replayed_samples, replayed_bytes, keep_samples ? "kept" : "released");
+}
+
+GstBuffer* PlayerImpl::WrapSampleBuffer(const void* sample_buffer, int size) {
+  // Cobalt keeps the sample alive until the deallocate callback is called, so
+  // hand its memory to GStreamer directly and give it back once the last
+  // reference (appsrc queue, decryptor, decoder or a stored pending sample) is
+  // dropped. The memory is read-only, so an in-place element (e.g. the
+  // decryptor) gets a private copy instead of modifying Cobalt's data.
+  struct SampleReleaseData {
+    SbPlayerDeallocateSampleFunc func;
+    SbPlayer player;
+    void* context;
+    const void* sample_buffer;
+  };
+
+  SampleReleaseData* data =
+      new SampleReleaseData{sample_deallocate_func_, player_, context_, sample_buffer};
+  GstBuffer* buffer = gst_buffer_new_wrapped_full(
+      GST_MEMORY_FLAG_READONLY, const_cast<void*>(sample_buffer), size, 0, size,
+      data, [](gpointer user_data) {
+        SampleReleaseData* data = static_cast<SampleReleaseData*>(user_data);
+        data->func(data->player, data->context, data->sample_buffer);
+        delete data;
+      });
+  bytes_wrapped_.fetch_add(size, std::memory_order_relaxed);
+  return buffer;
 }
 
 MediaType PlayerImpl::GetBothMediaTypeTakingCodecsIntoAccount() const {
@@ -2731,6 +4037,64 @@ void PlayerImpl::HandleApplicationMessage(GstBus* bus, GstMessage* message) {
   }
 }
 
+void PlayerImpl::WriteStats(media::StatsWriter& writer) {
+  ::starboard::ScopedLock lock(mutex_);
+  writer.BeginObject();
+  writer.Add("ticket", ticket_);
+  writer.AddBool("pooled", pooled_);
+  writer.Add("ttffus", static_cast<int64_t>(first_frame_latency_));
+
+  writer.BeginObject("ingest");
+  writer.Add("wrappedbytes", bytes_wrapped_.load(std::memory_order_relaxed));
+  writer.Add("copiedbytes", bytes_copied_.load(std::memory_order_relaxed));
+  writer.EndObject();
+
+  writer.BeginObject("dispatch");
+  uint64_t dispatched = dispatched_items_.load(std::memory_order_relaxed);
+  writer.Add("dispatched", dispatched);
+  writer.Add("depth", static_cast<uint64_t>(dispatch_queue_.Size()));
+  writer.Add("depthhwm", dispatch_depth_hwm_.load(std::memory_order_relaxed));
+  writer.Add("overflows", dispatch_overflows_.load(std::memory_order_relaxed));
+  writer.Add("avglatencyus", dispatched
+      ? static_cast<double>(dispatch_latency_total_.load(std::memory_order_relaxed)) / dispatched
+      : .0);
+  writer.Add("maxlatencyus", dispatch_latency_max_.load(std::memory_order_relaxed));
+  writer.EndObject();
+
+  if (sample_tracer_)
+    sample_tracer_->WriteStats(writer);
+
+  buffering_.WriteStats(writer);
+
+  writer.BeginObject("trickplay");
+  writer.AddBool("active", trick_play_);
+  writer.Add("sessions", trick_play_sessions_);
+  writer.Add("discardedframes", trick_play_discarded_frames_);
+  writer.Add("thinnedkeyframes", trick_play_thinned_frames_);
+  writer.EndObject();
+
+  writer.BeginObject("seek");
+  seek_latency_[static_cast<int>(SeekMode::kSkip)].Write(writer, "skip");
+  seek_latency_[static_cast<int>(SeekMode::kKeyUnit)].Write(writer, "keyunit");
+  seek_latency_[static_cast<int>(SeekMode::kAccurate)].Write(writer, "accurate");
+  writer.Add("skiprejected", skip_seeks_rejected_);
+  writer.Add("skiptimeouts", skip_seek_timeouts_);
+  writer.Add("skipdroppedsamples", skip_seek_dropped_samples_);
+  writer.EndObject();
+
+  writer.BeginObject("pendingsamples");
+  writer.Add("generation", pending_samples_.Generation());
+  writer.Add("generations", pending_samples_.Generations());
+  writer.Add("stored", static_cast<uint64_t>(pending_samples_.Size()));
+  writer.Add("storedbytes", static_cast<uint64_t>(pending_samples_.Bytes()));
+  writer.Add("storedbyteshwm", static_cast<uint64_t>(pending_samples_.BytesHighWaterMark()));
+  writer.Add("replayedsamples", samples_replayed_.load(std::memory_order_relaxed));
+  writer.Add("replayedbytes", bytes_replayed_.load(std::memory_order_relaxed));
+  writer.EndObject();
+
+  writer.EndObject();
+}
+
 void PlayerImpl::ConfigureLimitedVideo() {
   GstElementFactory* factory = gst_element_factory_find("westerossink");
   if (factory) {
@@ -2761,6 +4125,24 @@ void ForceStop() {
   GetPlayerRegistry()->ForceStop();
 }
 
+void WriteStats(media::StatsWriter& writer) {
+  using third_party::starboard::rdk::shared::player::GetPlayerRegistry;
+  using third_party::starboard::rdk::shared::player::GetPipelinePool;
+  GetPlayerRegistry()->WriteStats(writer);
+  GetPipelinePool()->WriteStats(writer);
+}
+
+void PreparePipelinePool() {
+  using third_party::starboard::rdk::shared::player::GetPipelinePool;
+  if (GetPipelinePool()->IsEnabled())
+    GetPipelinePool()->Prepare();
+}
+
+void ReleasePipelinePool() {
+  using third_party::starboard::rdk::shared::player::GetPipelinePool;
+  GetPipelinePool()->Release();
+}
+
 }  // namespace player
 }  // namespace shared
 }  // namespace rdk
@@ -29,7 +29,7 @@ namespace player {
 
 struct SB_EXPORT Player {
   virtual ~Player() {}
-  static int MaxNumberOfSamplesPerWrite();
+  static int MaxNumberOfSamplesPerWrite(SbMediaType sample_type);
   virtual void MarkEOS(SbMediaType stream_type) = 0;
   virtual void WriteSample(SbMediaType sample_type,
                            const SbPlayerSampleInfo* sample_infos,
@@ -63,9 +63,9 @@ struct SbPlayerPrivate {
                   SbDecodeTargetGraphicsContextProvider* provider);
   ~SbPlayerPrivate() {}
 
-  int MaxNumberOfSamplesPerWrite() const {
+  int MaxNumberOfSamplesPerWrite(SbMediaType sample_type) const {
     using third_party::starboard::rdk::shared::player::Player;
-    return Player::MaxNumberOfSamplesPerWrite();
+    return Player::MaxNumberOfSamplesPerWrite(sample_type);
   }
   std::unique_ptr<third_party::starboard::rdk::shared::player::Player> player_;
 };